@@ -83,7 +83,7 @@
 	SLiMSim *sim = controller->sim;
 	Population &pop = sim->population_;
 	
-	pop.TallyMutationReferences(nullptr, false);	// update tallies; usually this will just use the cache set up by Population::MaintainRegistry()
+	pop.TallyMutationReferences(false);	// update tallies; usually this will just use the cache set up by Population::MaintainRegistry()
 	
 	Mutation *mut_block_ptr = gSLiM_Mutation_Block;
 	slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
@@ -4653,7 +4653,7 @@
 			population.gui_all_selected_ = all_selected;
 			
 			// If the selection has changed, that means that the mutation tallies need to be recomputed
-			population.TallyMutationReferences(nullptr, true);
+			population.TallyMutationReferences(true);
 			
 			// It's a bit hard to tell for sure whether we need to update or not, since a selected subpop might have been removed from the tableview;
 			// selection changes should not happen often, so we can just always update, I think.
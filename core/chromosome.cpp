@@ -509,6 +509,10 @@ void Chromosome::_InitializeOneMutationMap(gsl_ran_discrete_t *&p_lookup, std::v
 	
 	std::sort(sorted_ge_vec.begin(), sorted_ge_vec.end(), [](GenomicElement *ge1, GenomicElement *ge2) {return ge1->start_position_ < ge2->start_position_;});
 	
+	// In nucleotide-based models, the rate map gives the model-wide maximum sequence-based rate; each genomic element
+	// scales that down to the maximum rate for its own genomic element type, so that fewer draws get rejected by
+	// DrawNewMutationExtended().  See SLiMSim::CacheNucleotideMatrices() and SLiMSim::CreateNucleotideMutationRateMap().
+	bool nucleotide_based = sim_->IsNucleotideBased();
 	std::vector<double> B;
 	unsigned int mutrange_index = 0;
 	slim_position_t end_of_previous_mutrange = -1;
@@ -538,6 +542,9 @@ void Chromosome::_InitializeOneMutationMap(gsl_ran_discrete_t *&p_lookup, std::v
 				slim_position_t subrange_length = subrange_end - subrange_start + 1;
 				double subrange_weight = p_rates[mutrange_index] * subrange_length;
 				
+				if (nucleotide_based)
+					subrange_weight *= ge.genomic_element_type_ptr_->mm_max_rate_fraction_;
+				
 				B.emplace_back(subrange_weight);
 				p_subranges.emplace_back(&ge, subrange_start, subrange_end);
 				
@@ -44,6 +44,74 @@ int64_t Genome::s_bulk_operation_id_ = 0;
 slim_mutrun_index_t Genome::s_bulk_operation_mutrun_index_ = -1;
 std::unordered_map<MutationRun*, MutationRun*> Genome::s_bulk_operation_runs_;
 
+// Static class variables in support of shared arrays of runs; see GenomeRunArrayHeader
+std::vector<MutationRun_SP *> Genome::s_free_run_arrays_;
+
+MutationRun_SP *Genome::NewRunArray(int32_t p_mutrun_count)
+{
+	// Reuse a pooled array if we have one of the right size; pooled arrays are already filled with nullptr
+	if (s_free_run_arrays_.size())
+	{
+		MutationRun_SP *run_array = s_free_run_arrays_.back();
+		GenomeRunArrayHeader *header = RunArrayHeader(run_array);
+		
+		if (header->mutrun_count_ == p_mutrun_count)
+		{
+			s_free_run_arrays_.pop_back();
+			header->share_count_ = 1;
+			return run_array;
+		}
+	}
+	
+	GenomeRunArrayHeader *header = (GenomeRunArrayHeader *)malloc(sizeof(GenomeRunArrayHeader) + p_mutrun_count * sizeof(MutationRun_SP));
+	MutationRun_SP *run_array = reinterpret_cast<MutationRun_SP *>(header + 1);
+	
+	header->share_count_ = 1;
+	header->mutrun_count_ = p_mutrun_count;
+	
+	for (int32_t run_index = 0; run_index < p_mutrun_count; ++run_index)
+		new (run_array + run_index) MutationRun_SP();
+	
+	return run_array;
+}
+
+void Genome::FreeRunArray(MutationRun_SP *p_run_array)
+{
+	GenomeRunArrayHeader *header = RunArrayHeader(p_run_array);
+	
+#ifdef DEBUG
+	if (header->share_count_ != 1)
+		EIDOS_TERMINATION << "ERROR (Genome::FreeRunArray): (internal error) freeing a shared array of runs." << EidosTerminate();
+	for (int32_t run_index = 0; run_index < header->mutrun_count_; ++run_index)
+		if (p_run_array[run_index])
+			EIDOS_TERMINATION << "ERROR (Genome::FreeRunArray): (internal error) freeing an array of runs that is not cleared to nullptr." << EidosTerminate();
+#endif
+	
+	// The pool holds arrays of only one size; when the number of mutation runs changes, the old arrays are freed
+	if (s_free_run_arrays_.size() && (RunArrayHeader(s_free_run_arrays_.back())->mutrun_count_ != header->mutrun_count_))
+	{
+		for (MutationRun_SP *free_array : s_free_run_arrays_)
+			free(RunArrayHeader(free_array));
+		
+		s_free_run_arrays_.clear();
+	}
+	
+	s_free_run_arrays_.emplace_back(p_run_array);
+}
+
+void Genome::_UnshareRunArray(void)
+{
+	// Make our own copy of the array of runs, and let go of the shared array; the other genomes continue sharing it
+	MutationRun_SP *shared_array = mutruns_;
+	
+	mutruns_ = NewRunArray(mutrun_count_);
+	
+	for (int run_index = 0; run_index < mutrun_count_; ++run_index)
+		mutruns_[run_index] = shared_array[run_index];
+	
+	RunArrayHeader(shared_array)->share_count_--;
+}
+
 
 Genome::Genome(Subpopulation *p_subpop, int p_mutrun_count, slim_position_t p_mutrun_length, enum GenomeType p_genome_type_, bool p_is_null) : genome_type_(p_genome_type_), subpop_(p_subpop), individual_(nullptr), genome_id_(-1)
 {
@@ -62,17 +130,16 @@ Genome::Genome(Subpopulation *p_subpop, int p_mutrun_count, slim_position_t p_mu
 		if (mutrun_count_ <= SLIM_GENOME_MUTRUN_BUFSIZE)
 			mutruns_ = run_buffer_;
 		else
-			mutruns_ = new MutationRun_SP[mutrun_count_];
+			mutruns_ = NewRunArray(mutrun_count_);
 	}
 }
 
 Genome::~Genome(void)
 {
-	for (int run_index = 0; run_index < mutrun_count_; ++run_index)
-		mutruns_[run_index].reset();
+	clear_to_nullptr();
 	
-	if (mutruns_ != run_buffer_)
-		delete[] mutruns_;
+	if (mutruns_ && (mutruns_ != run_buffer_))
+		FreeRunArray(mutruns_);
 	mutruns_ = nullptr;
 	
 	mutrun_count_ = 0;
@@ -91,6 +158,8 @@ void Genome::WillModifyRun(slim_mutrun_index_t p_run_index)
 		EIDOS_TERMINATION << "ERROR (Genome::WillModifyRun): (internal error) attempt to modify an out-of-index run." << EidosTerminate();
 #endif
 	
+	UnshareRunArray();
+	
 	MutationRun *original_run = mutruns_[p_run_index].get();
 	
 	if (original_run->UseCount() > 1)
@@ -142,6 +211,8 @@ bool Genome::WillModifyRunForBulkOperation(int64_t p_operation_id, slim_mutrun_i
 #else
 	// The interesting version remembers the operation in progress, using the ID, and
 	// tracks original/final MutationRun pointers, returning F if an original is matched.
+	UnshareRunArray();
+	
 	MutationRun *original_run = mutruns_[p_mutrun_index].get();
 	
 	if (p_operation_id != s_bulk_operation_id_)
@@ -281,11 +352,10 @@ void Genome::MakeNull(void)
 {
 	if (mutrun_count_)
 	{
-		for (int run_index = 0; run_index < mutrun_count_; ++run_index)
-			mutruns_[run_index].reset();
+		clear_to_nullptr();
 		
 		if (mutruns_ != run_buffer_)
-			delete[] mutruns_;
+			FreeRunArray(mutruns_);
 		mutruns_ = nullptr;
 		
 		mutrun_count_ = 0;
@@ -297,6 +367,9 @@ void Genome::ReinitializeGenomeToMutrun(GenomeType p_genome_type, int32_t p_mutr
 {
 	genome_type_ = p_genome_type;
 	
+	if (RunArrayIsShared())
+		clear_to_nullptr();
+	
 	if (p_mutrun_count)
 	{
 		if (mutrun_count_ == 0)
@@ -308,7 +381,7 @@ void Genome::ReinitializeGenomeToMutrun(GenomeType p_genome_type, int32_t p_mutr
 			if (mutrun_count_ <= SLIM_GENOME_MUTRUN_BUFSIZE)
 				mutruns_ = run_buffer_;
 			else
-				mutruns_ = new MutationRun_SP[mutrun_count_];
+				mutruns_ = NewRunArray(mutrun_count_);
 		}
 		else if (mutrun_count_ != p_mutrun_count)
 		{
@@ -317,7 +390,7 @@ void Genome::ReinitializeGenomeToMutrun(GenomeType p_genome_type, int32_t p_mutr
 				mutruns_[run_index].reset();
 			
 			if (mutruns_ != run_buffer_)
-				delete[] mutruns_;
+				FreeRunArray(mutruns_);
 			
 			mutrun_count_ = p_mutrun_count;
 			mutrun_length_ = p_mutrun_length;
@@ -325,7 +398,7 @@ void Genome::ReinitializeGenomeToMutrun(GenomeType p_genome_type, int32_t p_mutr
 			if (mutrun_count_ <= SLIM_GENOME_MUTRUN_BUFSIZE)
 				mutruns_ = run_buffer_;
 			else
-				mutruns_ = new MutationRun_SP[mutrun_count_];
+				mutruns_ = NewRunArray(mutrun_count_);
 		}
 		
 		for (int run_index = 0; run_index < mutrun_count_; ++run_index)
@@ -340,7 +413,7 @@ void Genome::ReinitializeGenomeToMutrun(GenomeType p_genome_type, int32_t p_mutr
 				mutruns_[run_index].reset();
 			
 			if (mutruns_ != run_buffer_)
-				delete[] mutruns_;
+				FreeRunArray(mutruns_);
 			mutruns_ = nullptr;
 			
 			mutrun_count_ = 0;
@@ -371,13 +444,13 @@ void Genome::ReinitializeGenomeNullptr(GenomeType p_genome_type, int32_t p_mutru
 			if (mutrun_count_ <= SLIM_GENOME_MUTRUN_BUFSIZE)
 				mutruns_ = run_buffer_;
 			else
-				mutruns_ = new MutationRun_SP[mutrun_count_];
+				mutruns_ = NewRunArray(mutrun_count_);
 		}
 		else if (mutrun_count_ != p_mutrun_count)
 		{
 			// the number of mutruns has changed; need to reallocate
 			if (mutruns_ != run_buffer_)
-				delete[] mutruns_;
+				FreeRunArray(mutruns_);
 			
 			mutrun_count_ = p_mutrun_count;
 			mutrun_length_ = p_mutrun_length;
@@ -385,7 +458,7 @@ void Genome::ReinitializeGenomeNullptr(GenomeType p_genome_type, int32_t p_mutru
 			if (mutrun_count_ <= SLIM_GENOME_MUTRUN_BUFSIZE)
 				mutruns_ = run_buffer_;
 			else
-				mutruns_ = new MutationRun_SP[mutrun_count_];
+				mutruns_ = NewRunArray(mutrun_count_);
 		}
 		
 		// we leave the new mutruns_ buffer filled with nullptr
@@ -396,7 +469,7 @@ void Genome::ReinitializeGenomeNullptr(GenomeType p_genome_type, int32_t p_mutru
 		{
 			// was a non-null genome, needs to become null
 			if (mutruns_ != run_buffer_)
-				delete[] mutruns_;
+				FreeRunArray(mutruns_);
 			mutruns_ = nullptr;
 			
 			mutrun_count_ = 0;
@@ -712,7 +785,7 @@ EidosValue_SP Genome::ExecuteInstanceMethod(EidosGlobalStringID p_method_id, con
 	{
 		case gID_containsMarkerMutation:		return ExecuteMethod_containsMarkerMutation(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		//case gID_containsMutations:			return ExecuteMethod_Accelerated_containsMutations(p_method_id, p_arguments, p_argument_count, p_interpreter);
-		case gID_countOfMutationsOfType:		return ExecuteMethod_countOfMutationsOfType(p_method_id, p_arguments, p_argument_count, p_interpreter);
+		//case gID_countOfMutationsOfType:		return ExecuteMethod_Accelerated_countOfMutationsOfType(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_mutationsOfType:				return ExecuteMethod_mutationsOfType(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_nucleotides:					return ExecuteMethod_nucleotides(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_positionsOfMutationsOfType:	return ExecuteMethod_positionsOfMutationsOfType(p_method_id, p_arguments, p_argument_count, p_interpreter);
@@ -800,13 +873,81 @@ EidosValue_SP Genome::ExecuteMethod_Accelerated_containsMutations(EidosObjectEle
 				return result;
 			}
 		}
+		else if (p_elements_size == 1)
+		{
+			EidosValue_Logical *logical_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Logical())->resize_no_initialize(mutations_count);
+			EidosValue_SP result(logical_result);
+			
+			EidosObjectElement * const *mutations_data = mutations_value->ObjectElementVector()->data();
+			Genome *element = (Genome *)(p_elements[0]);
+			
+			if (element->IsNull())
+				EIDOS_TERMINATION << "ERROR (Genome::ExecuteMethod_Accelerated_containsMutations): containsMutations() cannot be called on a null genome." << EidosTerminate();
+			
+			for (int value_index = 0; value_index < mutations_count; ++value_index)
+			{
+				Mutation *mut = (Mutation *)mutations_data[value_index];
+				MutationIndex mut_block_index = mut->BlockIndex();
+				bool contained = element->contains_mutation(mut_block_index);
+				
+				logical_result->set_logical_no_check(contained, value_index);
+			}
+			
+			return result;
+		}
 		else
 		{
+			// Many genomes and many mutations.  Genomes usually share most of their mutation runs, so rather than searching every
+			// genome for every mutation, we search each distinct run once for the mutations that fall within it, and then fill in
+			// the result for each genome from the results for its runs.  Runs are marked as they are searched, with operation IDs
+			// that index into run_cache below, starting from base_operation_id; we advance gSLiM_MutationRun_OperationID as we go.
+			// Note that one run can occur at more than one run index (the shared empty run used by removeMutations(), at least),
+			// so each cache entry remembers the run index it was searched for; a mismatch is handled by a direct search.
 			EidosValue_Logical *logical_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Logical())->resize_no_initialize(p_elements_size * mutations_count);
 			EidosValue_SP result(logical_result);
 			int64_t result_index = 0;
 			
 			EidosObjectElement * const *mutations_data = mutations_value->ObjectElementVector()->data();
+			slim_position_t mutrun_length = 0;
+			
+			for (size_t element_index = 0; element_index < p_elements_size; ++element_index)
+			{
+				// assume all non-null Genome objects have the same mutrun_length_; better be true...
+				Genome *element = (Genome *)(p_elements[element_index]);
+				
+				if (element->IsNull())
+					EIDOS_TERMINATION << "ERROR (Genome::ExecuteMethod_Accelerated_containsMutations): containsMutations() cannot be called on a null genome." << EidosTerminate();
+				
+				mutrun_length = element->mutrun_length_;
+				break;
+			}
+			
+			// Group the query mutations by run index; each mutation gets a slot within the group for its run index
+			std::vector<MutationIndex> mut_block_indices(mutations_count);
+			std::vector<slim_mutrun_index_t> mut_run_indices(mutations_count);
+			std::vector<int> mut_slots(mutations_count);
+			std::unordered_map<slim_mutrun_index_t, std::vector<MutationIndex>> run_index_groups;
+			
+			for (int value_index = 0; value_index < mutations_count; ++value_index)
+			{
+				Mutation *mut = (Mutation *)mutations_data[value_index];
+				slim_mutrun_index_t mutrun_index = (slim_mutrun_index_t)(mut->position_ / mutrun_length);
+				std::vector<MutationIndex> &group = run_index_groups[mutrun_index];
+				
+				mut_block_indices[value_index] = mut->BlockIndex();
+				mut_run_indices[value_index] = mutrun_index;
+				mut_slots[value_index] = (int)group.size();
+				group.emplace_back(mut->BlockIndex());
+			}
+			
+			// The search results for each distinct run, one entry per slot in the group for the run index it was searched for
+			struct RunCacheEntry {
+				slim_mutrun_index_t mutrun_index_;
+				size_t results_start_;
+			};
+			std::vector<RunCacheEntry> run_cache;
+			std::vector<uint8_t> run_results;
+			int64_t base_operation_id = gSLiM_MutationRun_OperationID + 1;
 			
 			for (size_t element_index = 0; element_index < p_elements_size; ++element_index)
 			{
@@ -817,9 +958,31 @@ EidosValue_SP Genome::ExecuteMethod_Accelerated_containsMutations(EidosObjectEle
 				
 				for (int value_index = 0; value_index < mutations_count; ++value_index)
 				{
-					Mutation *mut = (Mutation *)mutations_data[value_index];
-					MutationIndex mut_block_index = mut->BlockIndex();
-					bool contained = element->contains_mutation(mut_block_index);
+					slim_mutrun_index_t mutrun_index = mut_run_indices[value_index];
+					MutationRun *mutrun = element->mutruns_[mutrun_index].get();
+					int64_t cache_index = mutrun->operation_id_ - base_operation_id;
+					bool contained;
+					
+					if (cache_index < 0)
+					{
+						// A run we have not seen yet; search it for all of the query mutations in its run index, and cache that
+						std::vector<MutationIndex> &group = run_index_groups[mutrun_index];
+						
+						mutrun->operation_id_ = ++gSLiM_MutationRun_OperationID;
+						run_cache.emplace_back(RunCacheEntry{mutrun_index, run_results.size()});
+						
+						for (MutationIndex group_mut_index : group)
+							run_results.emplace_back(mutrun->contains_mutation(group_mut_index));
+						
+						cache_index = (int64_t)run_cache.size() - 1;
+					}
+					
+					RunCacheEntry &cache_entry = run_cache[cache_index];
+					
+					if (cache_entry.mutrun_index_ == mutrun_index)
+						contained = run_results[cache_entry.results_start_ + mut_slots[value_index]];
+					else
+						contained = mutrun->contains_mutation(mut_block_indices[value_index]);
 					
 					logical_result->set_logical_no_check(contained, result_index++);
 				}
@@ -836,33 +999,60 @@ EidosValue_SP Genome::ExecuteMethod_Accelerated_containsMutations(EidosObjectEle
 
 //	*********************	- (integer$)countOfMutationsOfType(io<MutationType>$ mutType)
 //
-EidosValue_SP Genome::ExecuteMethod_countOfMutationsOfType(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter)
+EidosValue_SP Genome::ExecuteMethod_Accelerated_countOfMutationsOfType(EidosObjectElement **p_elements, size_t p_elements_size, EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter)
 {
 #pragma unused (p_method_id, p_arguments, p_argument_count, p_interpreter)
 	EidosValue *mutType_value = p_arguments[0].get();
-	
-	if (IsNull())
-		EIDOS_TERMINATION << "ERROR (Genome::ExecuteMethod_countOfMutationsOfType): countOfMutationsOfType() cannot be called on a null genome." << EidosTerminate();
-	
-	SLiMSim &sim = subpop_->population_.sim_;
+	SLiMSim &sim = SLiM_GetSimFromInterpreter(p_interpreter);
 	MutationType *mutation_type_ptr = SLiM_ExtractMutationTypeFromEidosValue_io(mutType_value, 0, sim, "countOfMutationsOfType()");
 	
-	// Count the number of mutations of the given type
-	int match_count = 0;
+	// Count the number of mutations of the given type.  Genomes usually share most of their mutation runs, so we count within
+	// each distinct run only once; runs are marked as they are counted, with operation IDs that index into run_counts, starting
+	// from base_operation_id.  Unlike containsMutations(), the count for a run does not depend on the run index it occurs at.
 	Mutation *mut_block_ptr = gSLiM_Mutation_Block;
+	EidosValue_Int_vector *integer_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Int_vector())->resize_no_initialize(p_elements_size);
+	std::vector<int32_t> run_counts;
+	int64_t base_operation_id = gSLiM_MutationRun_OperationID + 1;
 	
-	for (int run_index = 0; run_index < mutrun_count_; ++run_index)
+	for (size_t element_index = 0; element_index < p_elements_size; ++element_index)
 	{
-		MutationRun *mutrun = mutruns_[run_index].get();
-		int mut_count = mutrun->size();
-		const MutationIndex *mut_ptr = mutrun->begin_pointer_const();
+		Genome *element = (Genome *)(p_elements[element_index]);
 		
-		for (int mut_index = 0; mut_index < mut_count; ++mut_index)
-			if ((mut_block_ptr + mut_ptr[mut_index])->mutation_type_ptr_ == mutation_type_ptr)
-				++match_count;
+		if (element->IsNull())
+			EIDOS_TERMINATION << "ERROR (Genome::ExecuteMethod_Accelerated_countOfMutationsOfType): countOfMutationsOfType() cannot be called on a null genome." << EidosTerminate();
+		
+		int mutrun_count = element->mutrun_count_;
+		int64_t match_count = 0;
+		
+		for (int run_index = 0; run_index < mutrun_count; ++run_index)
+		{
+			MutationRun *mutrun = element->mutruns_[run_index].get();
+			int64_t cache_index = mutrun->operation_id_ - base_operation_id;
+			
+			if (cache_index < 0)
+			{
+				int mut_count = mutrun->size();
+				const MutationIndex *mut_ptr = mutrun->begin_pointer_const();
+				int32_t run_match_count = 0;
+				
+				for (int mut_index = 0; mut_index < mut_count; ++mut_index)
+					if ((mut_block_ptr + mut_ptr[mut_index])->mutation_type_ptr_ == mutation_type_ptr)
+						++run_match_count;
+				
+				mutrun->operation_id_ = ++gSLiM_MutationRun_OperationID;
+				run_counts.emplace_back(run_match_count);
+				match_count += run_match_count;
+			}
+			else
+			{
+				match_count += run_counts[cache_index];
+			}
+		}
+		
+		integer_result->set_int_no_check(match_count, element_index);
 	}
 	
-	return EidosValue_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_Int_singleton(match_count));
+	return EidosValue_SP(integer_result);
 }
 
 //	*********************	- (object<Mutation>)mutationsOfType(io<MutationType>$ mutType)
@@ -2060,7 +2250,7 @@ const std::vector<EidosMethodSignature_CSP> *Genome_Class::Methods(void) const
 		methods->emplace_back((EidosClassMethodSignature *)(new EidosClassMethodSignature(gStr_addNewMutation, kEidosValueMaskObject, gSLiM_Mutation_Class))->AddIntObject("mutationType", gSLiM_MutationType_Class)->AddNumeric("selectionCoeff")->AddInt("position")->AddInt_ON("originGeneration", gStaticEidosValueNULL)->AddIntObject_ON("originSubpop", gSLiM_Subpopulation_Class, gStaticEidosValueNULL)->AddIntString_ON("nucleotide", gStaticEidosValueNULL));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_containsMarkerMutation, kEidosValueMaskLogical | kEidosValueMaskSingleton | kEidosValueMaskNULL | kEidosValueMaskObject, gSLiM_Mutation_Class))->AddIntObject_S("mutType", gSLiM_MutationType_Class)->AddInt_S("position")->AddLogical_OS("returnMutation", gStaticEidosValue_LogicalF));
 		methods->emplace_back(((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_containsMutations, kEidosValueMaskLogical))->AddObject("mutations", gSLiM_Mutation_Class))->DeclareAcceleratedImp(Genome::ExecuteMethod_Accelerated_containsMutations));
-		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_countOfMutationsOfType, kEidosValueMaskInt | kEidosValueMaskSingleton))->AddIntObject_S("mutType", gSLiM_MutationType_Class));
+		methods->emplace_back(((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_countOfMutationsOfType, kEidosValueMaskInt | kEidosValueMaskSingleton))->AddIntObject_S("mutType", gSLiM_MutationType_Class))->DeclareAcceleratedImp(Genome::ExecuteMethod_Accelerated_countOfMutationsOfType));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_positionsOfMutationsOfType, kEidosValueMaskInt))->AddIntObject_S("mutType", gSLiM_MutationType_Class));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_mutationsOfType, kEidosValueMaskObject, gSLiM_Mutation_Class))->AddIntObject_S("mutType", gSLiM_MutationType_Class));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_nucleotides, kEidosValueMaskInt | kEidosValueMaskString))->AddInt_OSN(gEidosStr_start, gStaticEidosValueNULL)->AddInt_OSN(gEidosStr_end, gStaticEidosValueNULL)->AddString_OS("format", EidosValue_String_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_String_singleton("string"))));
@@ -2288,7 +2478,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_addMutations(EidosGlobalStringID p_met
 		last_handled_mutrun_index = mutrun_index;
 		
 		// invalidate cached mutation refcounts; refcounts have changed
-		pop.cached_tally_genome_count_ = 0;
+		pop.InvalidateMutationReferencesCache();
 	}
 	
 	// TREE SEQUENCE RECORDING
@@ -2629,11 +2819,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_addNewMutation(EidosGlobalStringID p_m
 				mutations_to_add.emplace_back(new_mut_index);
 				
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-				if (pop.keeping_muttype_registries_ && mutation_type_ptr->keeping_muttype_registry_)
-				{
-					// This mutation type is also keeping its own private registry, so we need to add to that as well
-					mutation_type_ptr->muttype_registry_.emplace_back(new_mut_index);
-				}
+				mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 			}
 		}
@@ -2692,7 +2878,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_addNewMutation(EidosGlobalStringID p_m
 		MutationRun::FreeMutationRun(&mutations_to_add);
 		
 		// invalidate cached mutation refcounts; refcounts have changed
-		pop.cached_tally_genome_count_ = 0;
+		pop.InvalidateMutationReferencesCache();
 	}
 	
 	return retval;
@@ -2971,11 +3157,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_readFromMS(EidosGlobalStringID p_metho
 		mutation_indices.emplace_back(new_mut_index);
 		
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-		if (pop.keeping_muttype_registries_ && mutation_type_ptr->keeping_muttype_registry_)
-		{
-			// This mutation type is also keeping its own private registry, so we need to add to that as well
-			mutation_type_ptr->muttype_registry_.emplace_back(new_mut_index);
-		}
+		mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 	}
 	
@@ -3537,11 +3719,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_readFromVCF(EidosGlobalStringID p_meth
 			mutation_indices.push_back(new_mut_index);
 			
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-			if (pop.keeping_muttype_registries_ && mutation_type_ptr->keeping_muttype_registry_)
-			{
-				// This mutation type is also keeping its own private registry, so we need to add to that as well
-				mutation_type_ptr->muttype_registry_.emplace_back(new_mut_index);
-			}
+			mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 		}
 		
@@ -3681,12 +3859,14 @@ EidosValue_SP Genome_Class::ExecuteMethod_removeMutations(EidosGlobalStringID p_
 		{
 			Genome *target_genome = (Genome *)p_target->ObjectElementAtIndex(genome_index, nullptr);
 			
+			target_genome->UnshareRunArray();
+			
 			for (int run_index = 0; run_index < mutrun_count; ++run_index)
 					target_genome->mutruns_[run_index].reset(shared_empty_run);
 		}
 		
 		// invalidate cached mutation refcounts; refcounts have changed
-		pop.cached_tally_genome_count_ = 0;
+		pop.InvalidateMutationReferencesCache();
 		
 		// in this code path we just assume that nonneutral mutations might have been removed
 		any_nonneutral_removed = true;
@@ -3917,7 +4097,7 @@ EidosValue_SP Genome_Class::ExecuteMethod_removeMutations(EidosGlobalStringID p_
 			last_handled_mutrun_index = mutrun_index;
 			
 			// invalidate cached mutation refcounts; refcounts have changed
-			pop.cached_tally_genome_count_ = 0;
+			pop.InvalidateMutationReferencesCache();
 		}
 		
 		// TREE SEQUENCE RECORDING
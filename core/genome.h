@@ -72,6 +72,21 @@ extern EidosObjectClass *gSLiM_Genome_Class;
 // Using a size of 1 for now, since larger sizes increase memory usage substantially for some models, and also slow us down somehow.
 #define SLIM_GENOME_MUTRUN_BUFSIZE 1
 
+// Arrays of runs larger than the internal buffer are now preceded by a small header that counts the genomes using the
+// array.  This allows a genome-level copy-on-write: in WF models, a clonal gamete with no new mutations can simply share its
+// parent's entire array, making it O(1) instead of O(mutrun_count_).  This is not done for selfed or other non-recombining
+// gametes; sharing moves arrays between genomes, which costs locality in the mutation tally, and for those it was a net loss.
+// Any change to the runs in a shared array must be preceded by UnshareRunArray() (the Genome methods that modify mutruns_
+// do this).  An array is shared by a parent with at most one child, so when Population::ClearParentalGenomes() clears the
+// parents at the end of offspring generation all sharing is resolved, and MutationRun use counts again equal genome usage
+// counts by the time they are tallied.  Arrays are allocated and freed through NewRunArray() / FreeRunArray(), which keep freed
+// arrays for reuse.
+typedef struct
+{
+	uint32_t share_count_;			// the number of genomes using this array of runs
+	int32_t mutrun_count_;			// the number of runs in this array
+} GenomeRunArrayHeader;
+
 
 class Genome : public EidosObjectElement
 {
@@ -114,8 +129,20 @@ private:
 	static slim_mutrun_index_t s_bulk_operation_mutrun_index_;
 	static std::unordered_map<MutationRun*, MutationRun*> s_bulk_operation_runs_;
 	
+	// Pool of unshared run arrays, all containing nullptr, for reuse by NewRunArray(); see GenomeRunArrayHeader above
+	static std::vector<MutationRun_SP *> s_free_run_arrays_;
+	
+	static inline __attribute__((always_inline)) GenomeRunArrayHeader *RunArrayHeader(MutationRun_SP *p_run_array) { return reinterpret_cast<GenomeRunArrayHeader *>(p_run_array) - 1; }
+	
+	void _UnshareRunArray(void);
+	
 public:
 	
+	// Allocation of arrays of runs larger than SLIM_GENOME_MUTRUN_BUFSIZE; the array returned is filled with nullptr, and
+	// arrays passed to FreeRunArray() must be unshared and filled with nullptr as well
+	static MutationRun_SP *NewRunArray(int32_t p_mutrun_count);
+	static void FreeRunArray(MutationRun_SP *p_run_array);
+	
 	Genome(const Genome &p_original) = delete;
 	Genome& operator= (const Genome &p_original) = delete;
 	Genome(Subpopulation *p_subpop, int p_mutrun_count, slim_position_t p_mutrun_length, GenomeType p_genome_type_, bool p_is_null);
@@ -149,12 +176,28 @@ public:
 			EIDOS_TERMINATION << "ERROR (Genome::WillCreateRun): (internal error) attempt to create an out-of-index run." << EidosTerminate();
 #endif
 		
+		UnshareRunArray();
+		
 		MutationRun *new_run = MutationRun::NewMutationRun();	// take from shared pool of used objects
 		
 		mutruns_[p_run_index].reset(new_run);
 		return new_run;
 	}
 	
+	// Returns true if this genome's array of runs is presently shared with other genomes; see GenomeRunArrayHeader above
+	inline __attribute__((always_inline)) bool RunArrayIsShared(void) const
+	{
+		return ((mutruns_ != run_buffer_) && mutruns_ && (RunArrayHeader(mutruns_)->share_count_ > 1));
+	}
+	
+	// This should be called before replacing any run pointer in mutruns_.  If the array of runs is shared with other genomes,
+	// it gives this genome its own copy of the array; the runs themselves remain shared, of course.
+	inline __attribute__((always_inline)) void UnshareRunArray(void)
+	{
+		if (RunArrayIsShared())
+			_UnshareRunArray();
+	}
+	
 	// This should be called before modifying the run at a given index.  It will replicate the run to produce a single-referenced copy
 	// if necessary, thus guaranteeting that the run can be modified legally.  If the run is already single-referenced, it is a no-op.
 	void WillModifyRun(slim_mutrun_index_t p_run_index);
@@ -212,6 +255,9 @@ public:
 		if (mutrun_count_ == 0)
 			NullGenomeAccessError();
 #endif
+		if (RunArrayIsShared())
+			clear_to_nullptr();
+		
 		for (int run_index = 0; run_index < mutrun_count_; ++run_index)
 		{
 			MutationRun_SP *mutrun_sp = mutruns_ + run_index;
@@ -236,6 +282,14 @@ public:
 	inline __attribute__((always_inline)) void clear_to_nullptr(void)
 	{
 		// It is legal to call this method on null genomes, for speed/simplicity; it does no harm
+		if (RunArrayIsShared())
+		{
+			// We are sharing our array of runs, so we just let go of it and take a fresh array of nullptr
+			RunArrayHeader(mutruns_)->share_count_--;
+			mutruns_ = NewRunArray(mutrun_count_);
+			return;
+		}
+		
 		for (int run_index = 0; run_index < mutrun_count_; ++run_index)
 			mutruns_[run_index].reset();
 	}
@@ -322,6 +376,9 @@ public:
 				EIDOS_TERMINATION << "ERROR (Genome::copy_from_genome): (internal error) assignment from genome with different count/length." << EidosTerminate();
 #endif
 			
+			if (RunArrayIsShared())
+				clear_to_nullptr();
+			
 			if (mutrun_count_ == 1)
 			{
 				// This does seem to make a significant difference, interestingly.  Not sure if it is
@@ -343,6 +400,33 @@ public:
 		// subpop_ = p_source_genome.subpop_;
 	}
 	
+	// Like copy_from_genome(), but shares the source genome's array of runs instead of copying the run pointers; see
+	// GenomeRunArrayHeader above.  This genome must already be cleared to nullptr.  This is for use only during offspring
+	// generation in WF models, since clearing the source genome in Population::ClearParentalGenomes() resolves the sharing.
+	inline void share_from_genome(Genome &p_source_genome)
+	{
+		// A single run is already O(1) to copy, and null genomes have nothing to share.  We also share each array with only one
+		// child; further children copy the run pointers, since siblings would have to unshare at the end of the generation anyway.
+		if ((mutruns_ == run_buffer_) || p_source_genome.IsNull() || p_source_genome.RunArrayIsShared())
+		{
+			copy_from_genome(p_source_genome);
+			return;
+		}
+		
+#ifdef DEBUG
+		if ((mutrun_count_ != p_source_genome.mutrun_count_) || (mutrun_length_ != p_source_genome.mutrun_length_))
+			EIDOS_TERMINATION << "ERROR (Genome::share_from_genome): (internal error) sharing from genome with different count/length." << EidosTerminate();
+		check_cleared_to_nullptr();
+#endif
+		
+		FreeRunArray(mutruns_);
+		
+		mutruns_ = p_source_genome.mutruns_;
+		RunArrayHeader(mutruns_)->share_count_++;
+		
+		genome_type_ = p_source_genome.genome_type_;
+	}
+	
 	inline const std::vector<Mutation *> *derived_mutation_ids_at_position(slim_position_t p_position) const
 	{
 		slim_mutrun_index_t run_index = (slim_mutrun_index_t)(p_position / mutrun_length_);
@@ -382,7 +466,7 @@ public:
 	virtual EidosValue_SP ExecuteInstanceMethod(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_containsMarkerMutation(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	static EidosValue_SP ExecuteMethod_Accelerated_containsMutations(EidosObjectElement **p_values, size_t p_values_size, EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
-	EidosValue_SP ExecuteMethod_countOfMutationsOfType(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
+	static EidosValue_SP ExecuteMethod_Accelerated_countOfMutationsOfType(EidosObjectElement **p_values, size_t p_values_size, EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_mutationsOfType(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_nucleotides(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_positionsOfMutationsOfType(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
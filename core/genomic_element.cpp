@@ -195,6 +195,11 @@ EidosValue_SP GenomicElement::ExecuteMethod_setGenomicElementType(EidosGlobalStr
 	
 	genomic_element_type_ptr_ = getype_ptr;
 	
+	// in nucleotide-based models the mutation rate within an element depends upon its type; see SLiMSim::CacheNucleotideMatrices()
+	// during initialize() callbacks, that happens at the end of initialization anyway
+	if (sim.IsNucleotideBased() && (sim.executing_block_type_ != SLiMEidosBlockType::SLiMEidosInitializeCallback))
+		sim.TheChromosome().InitializeDraws();
+	
 	return gStaticEidosValueVOID;
 }
 
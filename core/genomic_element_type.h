@@ -71,6 +71,7 @@ public:
 	
 	EidosValue_Float_vector_SP mutation_matrix_;						// in nucleotide-based models only, the 4x4 or 64x4 float mutation matrix
 	double *mm_thresholds = nullptr;									// mutation matrix threshold values for determining derived nucleotides; cached in CacheNucleotideMatrices()
+	double mm_max_rate_fraction_ = 1.0;									// this type's maximum mutation rate on any background, as a fraction of the model-wide maximum; cached in CacheNucleotideMatrices()
 	
 	GenomicElementType(const GenomicElementType&) = delete;				// no copying
 	GenomicElementType& operator=(const GenomicElementType&) = delete;	// no copying
@@ -28,6 +28,14 @@
 #include <utility>
 #include <algorithm>
 
+#ifdef _OPENMP
+#include <omp.h>
+
+// Interaction work is split across threads only for subpopulations at least this large; below this, the overhead of
+// starting threads and merging their results outweighs the gain
+static const slim_popsize_t SLIM_INTERACTION_PARALLEL_MIN_ROWS = 5000;
+#endif
+
 
 // stream output for enumerations
 std::ostream& operator<<(std::ostream& p_out, IFType p_if_type)
@@ -70,6 +78,11 @@ InteractionType::InteractionType(SLiMSim &p_sim, slim_objectid_t p_interaction_t
 
 InteractionType::~InteractionType(void)
 {
+#ifdef _OPENMP
+	for (SparseArray *chunk : sa_chunks_)
+		delete chunk;
+	sa_chunks_.clear();
+#endif
 }
 
 void InteractionType::EvaluateSubpopulation(Subpopulation *p_subpop, bool p_immediate)
@@ -92,6 +105,9 @@ void InteractionType::EvaluateSubpopulation(Subpopulation *p_subpop, bool p_imme
 		// There is an existing entry, so we need to rehabilitate that entry by recycling its elements safely
 		subpop_data = &(data_iter->second);
 		
+		// If it is still evaluated, keep what we need from that evaluation for an incremental rebuild of the sparse array
+		RetainPreviousEvaluation(*subpop_data);
+		
 		subpop_data->individual_count_ = subpop_size;
 		subpop_data->first_male_index_ = p_subpop->parent_first_male_index_;
 		subpop_data->kd_node_count_ = 0;
@@ -116,6 +132,7 @@ void InteractionType::EvaluateSubpopulation(Subpopulation *p_subpop, bool p_imme
 		}
 		
 		subpop_data->kd_root_ = nullptr;
+		subpop_data->grid_.present_ = false;	// the grid's buffers are kept, to be reused
 		
 		subpop_data->evaluation_interaction_callbacks_.clear();
 	}
@@ -457,6 +474,10 @@ void InteractionType::Invalidate(void)
 	for (auto &data_iter : data_)
 	{
 		InteractionsData &data = data_iter.second;
+		
+		// keep what we need from the expiring evaluation for an incremental rebuild of the sparse array next time
+		RetainPreviousEvaluation(data);
+		
 		data.evaluated_ = false;
 		data.distances_calculated_ = false;
 		data.strengths_calculated_ = false;
@@ -477,11 +498,49 @@ void InteractionType::Invalidate(void)
 		}
 		
 		data.kd_root_ = nullptr;
+		data.grid_.present_ = false;	// the grid's buffers are kept, to be reused
 		
 		data.evaluation_interaction_callbacks_.clear();
 	}
 }
 
+// Called when an evaluation is about to be discarded, either by re-evaluation or by Invalidate(); if the evaluation is spatial, its
+// positions are kept, as is its sparse array if that was fully built with the grid and the last comparison of positions suggested
+// that an incremental rebuild would be worthwhile (see BuildSA_Grid_Incremental()).  Otherwise any previous sparse array is freed,
+// so that models in which most individuals move between evaluations don't pay for a second sparse array.
+void InteractionType::RetainPreviousEvaluation(InteractionsData &p_subpop_data)
+{
+	if (!p_subpop_data.evaluated_ || !p_subpop_data.positions_)
+		return;
+	
+	std::swap(p_subpop_data.positions_, p_subpop_data.previous_positions_);
+	p_subpop_data.previous_individual_count_ = p_subpop_data.individual_count_;
+	p_subpop_data.previous_first_male_index_ = p_subpop_data.first_male_index_;
+	p_subpop_data.previous_max_distance_ = max_distance_;
+	p_subpop_data.previous_bounds_[0] = p_subpop_data.bounds_x1_;
+	p_subpop_data.previous_bounds_[1] = p_subpop_data.bounds_y1_;
+	p_subpop_data.previous_bounds_[2] = p_subpop_data.bounds_z1_;
+	
+	if (p_subpop_data.retain_previous_dist_str_ && p_subpop_data.distances_calculated_ && p_subpop_data.grid_.present_)
+	{
+		std::swap(p_subpop_data.dist_str_, p_subpop_data.previous_dist_str_);
+		p_subpop_data.previous_dist_str_valid_ = true;
+		
+		for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+			p_subpop_data.previous_grid_scale_[dim] = p_subpop_data.grid_.scale_[dim];
+	}
+	else
+	{
+		if (p_subpop_data.previous_dist_str_)
+		{
+			delete p_subpop_data.previous_dist_str_;
+			p_subpop_data.previous_dist_str_ = nullptr;
+		}
+		
+		p_subpop_data.previous_dist_str_valid_ = false;
+	}
+}
+
 void InteractionType::CalculateAllDistances(Subpopulation *p_subpop)
 {
 	slim_objectid_t subpop_id = p_subpop->subpopulation_id_;
@@ -494,16 +553,27 @@ void InteractionType::CalculateAllDistances(Subpopulation *p_subpop)
 		
 		if (spatiality_ > 0)
 		{
-			// Here we use the k-d tree to find all interacting pairs, and calculate their distances.
-			// This does not use reciprocality at all, but I don't think there's a good way to do so, so that's OK.
-			EnsureKDTreePresent(subpop_data);
+			// Here we use the uniform grid if possible, or the k-d tree otherwise, to find all interacting pairs, and calculate
+			// their distances.  This does not use reciprocality at all, but I don't think there's a good way to do so, so that's OK.
+			bool use_grid = EnsureGridPresent(subpop_data);
+			
+			if (!use_grid)
+				EnsureKDTreePresent(subpop_data);
 			
 			slim_popsize_t subpop_size = p_subpop->parent_subpop_size_;
 			
 			if (subpop_data.dist_str_)
+			{
 				subpop_data.dist_str_->Reset(subpop_size, subpop_size);
+			}
 			else
+			{
 				subpop_data.dist_str_ = new SparseArray(subpop_size, subpop_size);
+				
+				// a new sparse array that will be rebuilt alongside a previous one will need about as many entries as it has
+				if (subpop_data.previous_dist_str_)
+					subpop_data.dist_str_->ReserveNNZ(subpop_data.previous_dist_str_->NonZeroCount());
+			}
 			
 			double *position_data = subpop_data.positions_;
 			int start_row = 0, after_end_row = subpop_size, row;
@@ -517,7 +587,27 @@ void InteractionType::CalculateAllDistances(Subpopulation *p_subpop)
 			else
 				EIDOS_TERMINATION << "ERROR (InteractionType::CalculateAllDistances): (internal error) unrecognized value for receiver_sex_." << EidosTerminate();
 			
-			if (exerter_sex_ == IndividualSex::kUnspecified)
+			if (use_grid)
+			{
+				// The grid scan tests exerters against an index range, which handles a specified exerter sex
+				int start_exerter = 0, after_end_exerter = subpop_size;
+				
+				if (exerter_sex_ == IndividualSex::kMale)
+					start_exerter = subpop_data.first_male_index_;
+				else if (exerter_sex_ == IndividualSex::kFemale)
+					after_end_exerter = subpop_data.first_male_index_;
+				
+				if (BuildSA_Grid_Incremental(subpop_data, subpop_data.dist_str_, start_row, after_end_row, start_exerter, after_end_exerter))
+					;
+#ifdef _OPENMP
+				else if ((omp_get_max_threads() > 1) && (after_end_row - start_row >= SLIM_INTERACTION_PARALLEL_MIN_ROWS))
+					BuildSA_Grid_Parallel(subpop_data, subpop_data.dist_str_, start_row, after_end_row, start_exerter, after_end_exerter);
+#endif
+				else
+					for (row = start_row; row < after_end_row; row++)
+						BuildSA_Grid(subpop_data, row, subpop_data.dist_str_, 0, start_exerter, after_end_exerter);
+			}
+			else if (exerter_sex_ == IndividualSex::kUnspecified)
 			{
 				// Without a specified exerter sex, we can add each exerter with no sex test
 				switch (spatiality_)
@@ -601,76 +691,95 @@ void InteractionType::CalculateAllStrengths(Subpopulation *p_subpop)
 			{
 				// No callbacks; strength calculations come from the interaction function only
 				// We do not use reciprocity here, as searching for the mirrored entry would probably take longer than just calculating twice
-				for (uint32_t row = 0; row < (uint32_t)subpop_size; ++row)
+				// The sparse array keeps all rows contiguously, so rather than visiting it row by row we run a kernel specialized for
+				// the interaction function over the whole flat buffer of distances; these loops have no calls or branches except
+				// for exp(), so they can be vectorized, and with OpenMP they are divided among threads
+				uint32_t nnz;
+				sa_distance_t *distances;
+				sa_strength_t *strengths;
+				double param1 = if_param1_;
+				
+				dist_str.AllInteractions(&nnz, &distances, &strengths);
+				
+				// CalculateStrengthNoCallbacks() is basically inlined here, moved outside the loop; see that function for comments
+				// MAINTAIN IN PARALLEL: the expressions here match CalculateStrengthNoCallbacks() operation for operation
+				switch (if_type_)
 				{
-					uint32_t row_nnz, *row_columns;
-					sa_distance_t *row_distances;
-					sa_strength_t *row_strengths;
-					
-					dist_str.InteractionsForRow(row, &row_nnz, &row_columns, &row_distances, &row_strengths);
-					
-					// CalculateStrengthNoCallbacks() is basically inlined here, moved outside the loop; see that function for comments
-					switch (if_type_)
+					case IFType::kFixed:
 					{
-						case IFType::kFixed:
-						{
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-								row_strengths[col_iter] = (sa_strength_t)if_param1_;
-							break;
-						}
-						case IFType::kLinear:
-						{
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-							{
-								sa_distance_t distance = row_distances[col_iter];
-								
-								row_strengths[col_iter] = (sa_strength_t)(if_param1_ * (1.0 - distance / max_distance_));
-							}
-							break;
-						}
-						case IFType::kExponential:
+						sa_strength_t strength = (sa_strength_t)param1;
+						
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) if(subpop_size >= SLIM_INTERACTION_PARALLEL_MIN_ROWS)
+#endif
+						for (uint32_t index = 0; index < nnz; ++index)
+							strengths[index] = strength;
+						break;
+					}
+					case IFType::kLinear:
+					{
+						double max_distance = max_distance_;
+						
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) if(subpop_size >= SLIM_INTERACTION_PARALLEL_MIN_ROWS)
+#endif
+						for (uint32_t index = 0; index < nnz; ++index)
 						{
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-							{
-								sa_distance_t distance = row_distances[col_iter];
-								
-								row_strengths[col_iter] = (sa_strength_t)(if_param1_ * exp(-if_param2_ * distance));
-							}
-							break;
+							sa_distance_t distance = distances[index];
+							
+							strengths[index] = (sa_strength_t)(param1 * (1.0 - distance / max_distance));
 						}
-						case IFType::kNormal:
+						break;
+					}
+					case IFType::kExponential:
+					{
+						double neg_lambda = -if_param2_;
+						
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) if(subpop_size >= SLIM_INTERACTION_PARALLEL_MIN_ROWS)
+#endif
+						for (uint32_t index = 0; index < nnz; ++index)
 						{
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-							{
-								sa_distance_t distance = row_distances[col_iter];
-								
-								row_strengths[col_iter] = (sa_strength_t)(if_param1_ * exp(-(distance * distance) / (2.0 * if_param2_ * if_param2_)));
-							}
-							break;
+							sa_distance_t distance = distances[index];
+							
+							strengths[index] = (sa_strength_t)(param1 * exp(neg_lambda * distance));
 						}
-						case IFType::kCauchy:
+						break;
+					}
+					case IFType::kNormal:
+					{
+						double two_sigma_sq = 2.0 * if_param2_ * if_param2_;
+						
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) if(subpop_size >= SLIM_INTERACTION_PARALLEL_MIN_ROWS)
+#endif
+						for (uint32_t index = 0; index < nnz; ++index)
 						{
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-							{
-								sa_distance_t distance = row_distances[col_iter];
-								double temp = distance / if_param2_;
-								
-								row_strengths[col_iter] = (sa_strength_t)(if_param1_ / (1.0 + temp * temp));
-							}
-							break;
+							sa_distance_t distance = distances[index];
+							
+							strengths[index] = (sa_strength_t)(param1 * exp(-(distance * distance) / two_sigma_sq));
 						}
-						default:
+						break;
+					}
+					case IFType::kCauchy:
+					{
+						double lambda = if_param2_;
+						
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) if(subpop_size >= SLIM_INTERACTION_PARALLEL_MIN_ROWS)
+#endif
+						for (uint32_t index = 0; index < nnz; ++index)
 						{
-							// should never be hit, but this is the base case
-							for (uint32_t col_iter = 0; col_iter < row_nnz; ++col_iter)
-							{
-								sa_distance_t distance = row_distances[col_iter];
-								
-								row_strengths[col_iter] = (sa_strength_t)CalculateStrengthNoCallbacks(distance);
-							}
+							sa_distance_t distance = distances[index];
+							double temp = distance / lambda;
 							
-							EIDOS_TERMINATION << "ERROR (InteractionType::CalculateAllStrengths): (internal error) unimplemented IFType case." << EidosTerminate();
+							strengths[index] = (sa_strength_t)(param1 / (1.0 + temp * temp));
 						}
+						break;
+					}
+					default:
+					{
+						EIDOS_TERMINATION << "ERROR (InteractionType::CalculateAllStrengths): (internal error) unimplemented IFType case." << EidosTerminate();
 					}
 				}
 			}
@@ -1096,6 +1205,11 @@ size_t InteractionType::MemoryUsageForKDTrees(void)
 	{
 		const InteractionsData &data = iter.second;
 		usage += sizeof(SLiM_kdNode) * data.individual_count_;
+		
+		// the uniform grid, if any, is an alternative to the k-d tree so we count it here too
+		const SLiM_Grid &grid = data.grid_;
+		usage += sizeof(uint32_t) * (grid.cells_capacity_ + (grid.cell_starts_ ? 1 : 0));
+		usage += (sizeof(slim_popsize_t) + sizeof(double) * SLIM_MAX_DIMENSIONALITY + sizeof(uint32_t)) * grid.individuals_capacity_;
 	}
 	
 	return usage;
@@ -1109,6 +1223,10 @@ size_t InteractionType::MemoryUsageForPositions(void)
 	{
 		const InteractionsData &data = iter.second;
 		usage += sizeof(double) * data.individual_count_;
+		
+		// positions kept from the previous evaluation, for incremental rebuilding of the sparse array
+		if (data.previous_positions_)
+			usage += sizeof(double) * SLIM_MAX_DIMENSIONALITY * data.previous_individual_count_;
 	}
 	
 	return usage;
@@ -1124,8 +1242,18 @@ size_t InteractionType::MemoryUsageForSparseArrays(void)
 		
 		if (array)
 			usage += iter.second.dist_str_->MemoryUsage();
+		
+		SparseArray *previous_array = iter.second.previous_dist_str_;
+		
+		if (previous_array)
+			usage += previous_array->MemoryUsage();
 	}
 	
+#ifdef _OPENMP
+	for (SparseArray *chunk : sa_chunks_)
+		usage += chunk->MemoryUsage();
+#endif
+	
 	return usage;
 }
 
@@ -2075,6 +2203,539 @@ void InteractionType::BuildSA_SS_3(SLiM_kdNode *root, double *nd, slim_popsize_t
 }
 
 
+#pragma mark -
+#pragma mark uniform grid construction and sparse array building
+#pragma mark -
+
+// Returns the lattice coordinate of a position along one dimension of the grid, relative to the grid's first cell and clamped to
+// the grid; this is used both for placing individuals in the grid and for locating arbitrary points, so they always agree
+static inline __attribute__((always_inline)) int32_t GridCellForCoordinate(const SLiM_Grid &p_grid, int p_dim, double p_coord)
+{
+	int64_t dim_cell = (int64_t)std::floor(p_coord * p_grid.scale_[p_dim]) - p_grid.origin_cell_[p_dim];
+	
+	if (dim_cell < 0) return 0;
+	if (dim_cell >= p_grid.cell_count_[p_dim]) return p_grid.cell_count_[p_dim] - 1;
+	return (int32_t)dim_cell;
+}
+
+// Builds the uniform grid for p_subpop_data if it is not already present, and returns true; returns false if the grid
+// cannot be used, in which case the caller should fall back to the k-d tree.  The cells are at least max_distance_ wide
+// in every dimension; if that would produce a great many more cells than individuals (a sparse population, or a small
+// max_distance_), the cells are enlarged to keep the cell count proportional to the individual count, which preserves
+// correctness since every interacting pair still lies in the same or adjacent cells.  Periodic dimensions are divided
+// into a whole number of cells spanning the full periodic extent, so that adjacency wraps around correctly; non-periodic
+// dimensions use cells of exactly the chosen size on a lattice anchored at zero, covering the range of the individuals.
+bool InteractionType::EnsureGridPresent(InteractionsData &p_subpop_data)
+{
+	if (!p_subpop_data.evaluated_)
+		EIDOS_TERMINATION << "ERROR (InteractionType::EnsureGridPresent): (internal error) the interaction has not been evaluated." << EidosTerminate();
+	
+	if (spatiality_ == 0)
+		EIDOS_TERMINATION << "ERROR (InteractionType::EnsureGridPresent): (internal error) grid cannot be constructed for non-spatial interactions." << EidosTerminate();
+	
+	SLiM_Grid &grid = p_subpop_data.grid_;
+	
+	if (grid.present_)
+		return true;
+	
+	// An infinite (or zero) maximum distance gives no useful cell size; the k-d tree handles those cases
+	if (!std::isfinite(max_distance_) || (max_distance_ <= 0.0))
+		return false;
+	
+	slim_popsize_t individual_count = p_subpop_data.individual_count_;
+	double *positions = p_subpop_data.positions_;
+	bool periodic[SLIM_MAX_DIMENSIONALITY] = {periodic_x_, periodic_y_, periodic_z_};
+	double bounds[SLIM_MAX_DIMENSIONALITY] = {p_subpop_data.bounds_x1_, p_subpop_data.bounds_y1_, p_subpop_data.bounds_z1_};
+	double coord_min[SLIM_MAX_DIMENSIONALITY], coord_max[SLIM_MAX_DIMENSIONALITY];
+	
+	for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+	{
+		coord_min[dim] = 0.0;
+		coord_max[dim] = 0.0;
+		
+		if (dim >= spatiality_)
+			continue;
+		
+		if (periodic[dim])
+		{
+			coord_max[dim] = bounds[dim];
+		}
+		else if (individual_count > 0)
+		{
+			coord_min[dim] = positions[dim];
+			coord_max[dim] = positions[dim];
+			
+			for (slim_popsize_t i = 1; i < individual_count; ++i)
+			{
+				double coord = positions[i * SLIM_MAX_DIMENSIONALITY + dim];
+				
+				if (coord < coord_min[dim]) coord_min[dim] = coord;
+				if (coord > coord_max[dim]) coord_max[dim] = coord;
+			}
+		}
+		
+		if (!std::isfinite(coord_max[dim] - coord_min[dim]))
+			return false;
+	}
+	
+	// Choose the cell size, enlarging it from max_distance_ if necessary to keep the number of cells reasonable; we start a
+	// hair above max_distance_ so that rounding in GridCellForCoordinate() can never separate an interacting pair by two cells
+	double max_cell_count = std::max(64.0, 2.0 * individual_count);
+	double cell_size = max_distance_ * 1.000001;
+	double cell_count;
+	
+	while (true)
+	{
+		cell_count = 1.0;
+		
+		for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+		{
+			double dim_cell_count = 1.0;
+			
+			grid.origin_cell_[dim] = 0;
+			grid.scale_[dim] = 0.0;
+			
+			if (dim < spatiality_)
+			{
+				if (periodic[dim])
+				{
+					dim_cell_count = std::max(1.0, std::floor(bounds[dim] / cell_size));
+					grid.scale_[dim] = dim_cell_count / bounds[dim];
+				}
+				else
+				{
+					double first_cell = std::floor(coord_min[dim] / cell_size);
+					
+					dim_cell_count = std::floor(coord_max[dim] / cell_size) - first_cell + 1.0;
+					grid.origin_cell_[dim] = (int64_t)first_cell;
+					grid.scale_[dim] = 1.0 / cell_size;
+				}
+			}
+			
+			grid.cell_count_[dim] = (int32_t)std::min(dim_cell_count, max_cell_count);
+			cell_count *= grid.cell_count_[dim];
+		}
+		
+		if (cell_count <= max_cell_count)
+			break;
+		
+		cell_size *= std::pow(cell_count / max_cell_count, 1.0 / spatiality_) * 1.0001;
+	}
+	
+	// Now that the cells are chosen, recompute each non-periodic origin with the same arithmetic as GridCellForCoordinate(), so that
+	// rounding can never put an individual outside the grid; the cell counts above were computed from the same extreme coordinates
+	for (int dim = 0; dim < spatiality_; ++dim)
+	{
+		if (!periodic[dim])
+		{
+			int64_t first_cell = (int64_t)std::floor(coord_min[dim] * grid.scale_[dim]);
+			int64_t last_cell = (int64_t)std::floor(coord_max[dim] * grid.scale_[dim]);
+			
+			grid.origin_cell_[dim] = first_cell;
+			
+			if (last_cell - first_cell + 1 != grid.cell_count_[dim])
+			{
+				cell_count = (cell_count / grid.cell_count_[dim]) * (double)(last_cell - first_cell + 1);
+				grid.cell_count_[dim] = (int32_t)(last_cell - first_cell + 1);
+			}
+		}
+	}
+	
+	// Make sure our buffers are large enough; they are kept across evaluations to avoid reallocation
+	size_t total_cells = (size_t)cell_count;
+	
+	if (grid.cells_capacity_ < total_cells)
+	{
+		grid.cells_capacity_ = total_cells;
+		grid.cell_starts_ = (uint32_t *)realloc(grid.cell_starts_, (total_cells + 1) * sizeof(uint32_t));
+	}
+	
+	if (grid.individuals_capacity_ < (size_t)individual_count)
+	{
+		grid.individuals_capacity_ = individual_count;
+		grid.members_ = (slim_popsize_t *)realloc(grid.members_, individual_count * sizeof(slim_popsize_t));
+		grid.positions_ = (double *)realloc(grid.positions_, individual_count * SLIM_MAX_DIMENSIONALITY * sizeof(double));
+		grid.individual_cells_ = (uint32_t *)realloc(grid.individual_cells_, individual_count * sizeof(uint32_t));
+	}
+	
+	if (!grid.cell_starts_ || (individual_count && (!grid.members_ || !grid.positions_ || !grid.individual_cells_)))
+		EIDOS_TERMINATION << "ERROR (InteractionType::EnsureGridPresent): allocation failed; you may need to raise the memory limit for SLiM." << EidosTerminate(nullptr);
+	
+	// Counting sort of the individuals by cell: count the individuals in each cell, convert the counts to start offsets,
+	// and then place each individual (and its position) at the next free offset for its cell
+	uint32_t *cell_starts = grid.cell_starts_;
+	
+	EIDOS_BZERO(cell_starts, (total_cells + 1) * sizeof(uint32_t));
+	
+	for (slim_popsize_t i = 0; i < individual_count; ++i)
+	{
+		double *position = positions + i * SLIM_MAX_DIMENSIONALITY;
+		uint32_t cell = 0;
+		
+		for (int dim = spatiality_ - 1; dim >= 0; --dim)
+			cell = cell * grid.cell_count_[dim] + GridCellForCoordinate(grid, dim, position[dim]);
+		
+		grid.individual_cells_[i] = cell;
+		cell_starts[cell + 1]++;
+	}
+	
+	for (size_t cell = 0; cell < total_cells; ++cell)
+		cell_starts[cell + 1] += cell_starts[cell];
+	
+	// use the start offsets as insertion cursors, and then shift them back to starts afterwards
+	for (slim_popsize_t i = 0; i < individual_count; ++i)
+	{
+		uint32_t member_index = cell_starts[grid.individual_cells_[i]]++;
+		
+		grid.members_[member_index] = i;
+		memcpy(grid.positions_ + member_index * SLIM_MAX_DIMENSIONALITY, positions + i * SLIM_MAX_DIMENSIONALITY, SLIM_MAX_DIMENSIONALITY * sizeof(double));
+	}
+	
+	for (size_t cell = total_cells; cell > 0; --cell)
+		cell_starts[cell] = cell_starts[cell - 1];
+	cell_starts[0] = 0;
+	
+	grid.present_ = true;
+	return true;
+}
+
+// find the cells of the grid to scan for neighbors of p_point along each dimension: the point's own cell and its neighbors, wrapping
+// around in periodic dimensions; with fewer than three cells along a periodic dimension the wrapped neighbors coincide, so we remove
+// duplicates.  Unused dimensions have just the one cell.
+void InteractionType::GridNeighborCells(SLiM_Grid &p_grid, double *p_point, int32_t p_neighbor_cells[][3], int *p_neighbor_cell_count)
+{
+	bool periodic[SLIM_MAX_DIMENSIONALITY] = {periodic_x_, periodic_y_, periodic_z_};
+	
+	for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+	{
+		if (dim >= spatiality_)
+		{
+			p_neighbor_cells[dim][0] = 0;
+			p_neighbor_cell_count[dim] = 1;
+			continue;
+		}
+		
+		int32_t dim_cell_count = p_grid.cell_count_[dim];
+		int32_t dim_cell = GridCellForCoordinate(p_grid, dim, p_point[dim]);
+		int count = 0;
+		
+		for (int32_t offset = -1; offset <= 1; ++offset)
+		{
+			int32_t neighbor = dim_cell + offset;
+			
+			if ((neighbor < 0) || (neighbor >= dim_cell_count))
+			{
+				if (!periodic[dim])
+					continue;
+				
+				neighbor = (neighbor + dim_cell_count) % dim_cell_count;
+			}
+			
+			if (std::find(p_neighbor_cells[dim], p_neighbor_cells[dim] + count, neighbor) == p_neighbor_cells[dim] + count)
+				p_neighbor_cells[dim][count++] = neighbor;
+		}
+		
+		p_neighbor_cell_count[dim] = count;
+	}
+}
+
+// add neighbors to the sparse array using the uniform grid, in any spatiality; exerters outside [start_exerter, after_end_exerter) are skipped
+// the focal individual's entries go in row p_focal_individual_index - p_first_row, so that a block of rows can be built separately
+// this dispatches to a version of BuildSA_Grid_D() specialized for the spatiality and for the presence of periodicity, so that the
+// distance calculation for each candidate pair is a fixed, unrolled sequence of operations
+void InteractionType::BuildSA_Grid(InteractionsData &p_subpop_data, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, uint32_t p_first_row, int start_exerter, int after_end_exerter)
+{
+	bool any_periodic = (periodic_x_ || periodic_y_ || periodic_z_);
+	
+	switch (spatiality_)
+	{
+		case 1:
+			if (any_periodic)	BuildSA_Grid_D<1, true>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			else				BuildSA_Grid_D<1, false>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			break;
+		case 2:
+			if (any_periodic)	BuildSA_Grid_D<2, true>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			else				BuildSA_Grid_D<2, false>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			break;
+		case 3:
+			if (any_periodic)	BuildSA_Grid_D<3, true>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			else				BuildSA_Grid_D<3, false>(p_subpop_data, p_focal_individual_index, p_sparse_array, p_first_row, start_exerter, after_end_exerter);
+			break;
+		default:
+			EIDOS_TERMINATION << "ERROR (InteractionType::BuildSA_Grid): (internal error) unsupported spatiality." << EidosTerminate();
+	}
+}
+
+template <int SPATIALITY, bool ANY_PERIODIC>
+void InteractionType::BuildSA_Grid_D(InteractionsData &p_subpop_data, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, uint32_t p_first_row, int start_exerter, int after_end_exerter)
+{
+	SLiM_Grid &grid = p_subpop_data.grid_;
+	double *nd = p_subpop_data.positions_ + p_focal_individual_index * SLIM_MAX_DIMENSIONALITY;
+	bool periodic[SLIM_MAX_DIMENSIONALITY] = {periodic_x_, periodic_y_, periodic_z_};
+	double bounds[SLIM_MAX_DIMENSIONALITY] = {p_subpop_data.bounds_x1_, p_subpop_data.bounds_y1_, p_subpop_data.bounds_z1_};
+	double local_max_distance_sq = max_distance_sq_;
+	uint32_t sa_row = (uint32_t)p_focal_individual_index - p_first_row;
+	
+	// Find the cells to scan along each dimension
+	int32_t neighbor_cells[SLIM_MAX_DIMENSIONALITY][3];
+	int neighbor_cell_count[SLIM_MAX_DIMENSIONALITY];
+	
+	GridNeighborCells(grid, nd, neighbor_cells, neighbor_cell_count);
+	
+	for (int i2 = 0; i2 < neighbor_cell_count[2]; ++i2)
+	{
+		for (int i1 = 0; i1 < neighbor_cell_count[1]; ++i1)
+		{
+			for (int i0 = 0; i0 < neighbor_cell_count[0]; ++i0)
+			{
+				uint32_t cell = (uint32_t)((neighbor_cells[2][i2] * grid.cell_count_[1] + neighbor_cells[1][i1]) * grid.cell_count_[0] + neighbor_cells[0][i0]);
+				uint32_t member_index = grid.cell_starts_[cell];
+				uint32_t member_end = grid.cell_starts_[cell + 1];
+				
+				for ( ; member_index < member_end; ++member_index)
+				{
+					slim_popsize_t exerter_index = grid.members_[member_index];
+					
+					if ((exerter_index == p_focal_individual_index) || (exerter_index < start_exerter) || (exerter_index >= after_end_exerter))
+						continue;
+					
+					double *exerter_position = grid.positions_ + member_index * SLIM_MAX_DIMENSIONALITY;
+					double d = 0.0;
+					
+					if (ANY_PERIODIC)
+					{
+						for (int dim = 0; dim < SPATIALITY; ++dim)
+						{
+							double t = std::fabs(exerter_position[dim] - nd[dim]);
+							
+							// the maximum distance is less than half the periodic extent, so only the nearer image can interact
+							if (periodic[dim] && (t > bounds[dim] * 0.5))
+								t = bounds[dim] - t;
+							
+							d += t * t;
+						}
+					}
+					else
+					{
+						for (int dim = 0; dim < SPATIALITY; ++dim)
+						{
+							double t = exerter_position[dim] - nd[dim];
+							
+							d += t * t;
+						}
+					}
+					
+					if (d <= local_max_distance_sq)
+						p_sparse_array->AddEntryDistance(sa_row, exerter_index, (sa_distance_t)sqrt(d));
+				}
+			}
+		}
+	}
+}
+
+// add neighbors to the sparse array for rows [start_row, after_end_row) by updating the sparse array from the previous evaluation,
+// if that is possible and worthwhile, and return true; otherwise return false, leaving p_sparse_array untouched.  We compare the
+// current positions with the previous ones, index by index; an individual whose position differs has moved, and individuals at
+// indices beyond the end of the shorter evaluation have been added or removed.  A row can be copied from the previous sparse array
+// if its individual has not changed and no changed individual is within max_distance_ of it, at either its old or new position;
+// that row would then be built identically, since the same exerters are found at the same distances, and the grid finds them in
+// the same order (see the comment on SLiM_Grid).  All other rows are built anew.  This is worthwhile only if few individuals have
+// changed; otherwise finding the affected rows costs about as much as rebuilding them, so we give up and also stop keeping the
+// previous sparse array around (see RetainPreviousEvaluation()).  Note that a nonWF model in which individuals die shifts the index
+// of every later individual, so this only helps if the population is unchanged apart from movement and additions at the end.
+bool InteractionType::BuildSA_Grid_Incremental(InteractionsData &p_subpop_data, SparseArray *p_sparse_array, int start_row, int after_end_row, int start_exerter, int after_end_exerter)
+{
+	SLiM_Grid &grid = p_subpop_data.grid_;
+	double *positions = p_subpop_data.positions_;
+	double *previous_positions = p_subpop_data.previous_positions_;
+	slim_popsize_t individual_count = p_subpop_data.individual_count_;
+	slim_popsize_t previous_count = p_subpop_data.previous_individual_count_;
+	bool periodic[SLIM_MAX_DIMENSIONALITY] = {periodic_x_, periodic_y_, periodic_z_};
+	double bounds[SLIM_MAX_DIMENSIONALITY] = {p_subpop_data.bounds_x1_, p_subpop_data.bounds_y1_, p_subpop_data.bounds_z1_};
+	
+	p_subpop_data.retain_previous_dist_str_ = false;
+	
+	// The previous evaluation must be comparable: the same maximum distance and periodic bounds, and for sex-segregated
+	// interactions the same sex layout, since the rows and columns that interact depend upon it
+	if (!previous_positions || (p_subpop_data.previous_max_distance_ != max_distance_))
+		return false;
+	
+	for (int dim = 0; dim < spatiality_; ++dim)
+		if (periodic[dim] && (p_subpop_data.previous_bounds_[dim] != bounds[dim]))
+			return false;
+	
+	if (((receiver_sex_ != IndividualSex::kUnspecified) || (exerter_sex_ != IndividualSex::kUnspecified)) &&
+		((previous_count != individual_count) || (p_subpop_data.previous_first_male_index_ != p_subpop_data.first_male_index_)))
+		return false;
+	
+	// Find the changed individuals, and the points (old and new positions) around which rows must be rebuilt
+	slim_popsize_t common_count = std::min(individual_count, previous_count);
+	slim_popsize_t max_changed_count = individual_count / 4;
+	slim_popsize_t changed_count = 0;
+	size_t position_size = spatiality_ * sizeof(double);
+	std::vector<uint8_t> row_dirty(individual_count, 0);
+	std::vector<double *> changed_points;
+	
+	for (slim_popsize_t index = 0; index < common_count; ++index)
+	{
+		double *position = positions + index * SLIM_MAX_DIMENSIONALITY;
+		double *previous_position = previous_positions + index * SLIM_MAX_DIMENSIONALITY;
+		
+		if (memcmp(position, previous_position, position_size) != 0)
+		{
+			if (++changed_count > max_changed_count)
+				return false;
+			
+			row_dirty[index] = 1;
+			changed_points.push_back(position);
+			changed_points.push_back(previous_position);
+		}
+	}
+	
+	changed_count += std::abs(individual_count - previous_count);
+	
+	if (changed_count > max_changed_count)
+		return false;
+	
+	for (slim_popsize_t index = common_count; index < individual_count; ++index)
+	{
+		row_dirty[index] = 1;
+		changed_points.push_back(positions + index * SLIM_MAX_DIMENSIONALITY);
+	}
+	
+	for (slim_popsize_t index = common_count; index < previous_count; ++index)
+		changed_points.push_back(previous_positions + index * SLIM_MAX_DIMENSIONALITY);
+	
+	// Few enough individuals changed that this is worthwhile, so keep this evaluation's sparse array for next time too; but we
+	// can only proceed now if we have the previous sparse array, built with cells of the same size
+	p_subpop_data.retain_previous_dist_str_ = true;
+	
+	if (!p_subpop_data.previous_dist_str_valid_ || !p_subpop_data.previous_dist_str_)
+		return false;
+	
+	for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+		if (p_subpop_data.previous_grid_scale_[dim] != grid.scale_[dim])
+			return false;
+	
+	// Mark as dirty every row whose individual is within max_distance_ of a changed point; the distance is calculated exactly
+	// as in BuildSA_Grid_D(), so that the decision matches the one a full rebuild would make
+	for (double *point : changed_points)
+	{
+		int32_t neighbor_cells[SLIM_MAX_DIMENSIONALITY][3];
+		int neighbor_cell_count[SLIM_MAX_DIMENSIONALITY];
+		
+		GridNeighborCells(grid, point, neighbor_cells, neighbor_cell_count);
+		
+		for (int i2 = 0; i2 < neighbor_cell_count[2]; ++i2)
+			for (int i1 = 0; i1 < neighbor_cell_count[1]; ++i1)
+				for (int i0 = 0; i0 < neighbor_cell_count[0]; ++i0)
+				{
+					uint32_t cell = (uint32_t)((neighbor_cells[2][i2] * grid.cell_count_[1] + neighbor_cells[1][i1]) * grid.cell_count_[0] + neighbor_cells[0][i0]);
+					
+					for (uint32_t member_index = grid.cell_starts_[cell]; member_index < grid.cell_starts_[cell + 1]; ++member_index)
+					{
+						double *member_position = grid.positions_ + member_index * SLIM_MAX_DIMENSIONALITY;
+						double d = 0.0;
+						
+						for (int dim = 0; dim < spatiality_; ++dim)
+						{
+							double t = std::fabs(point[dim] - member_position[dim]);
+							
+							if (periodic[dim] && (t > bounds[dim] * 0.5))
+								t = bounds[dim] - t;
+							
+							d += t * t;
+						}
+						
+						if (d <= max_distance_sq_)
+							row_dirty[grid.members_[member_index]] = 1;
+					}
+				}
+	}
+	
+	// Build the sparse array, rebuilding dirty rows and copying runs of clean rows
+	SparseArray &previous_dist_str = *p_subpop_data.previous_dist_str_;
+	int row = start_row;
+	
+	while (row < after_end_row)
+	{
+		if (row_dirty[row])
+		{
+			BuildSA_Grid(p_subpop_data, row, p_sparse_array, 0, start_exerter, after_end_exerter);
+			row++;
+		}
+		else
+		{
+			int run_end = row + 1;
+			
+			while ((run_end < after_end_row) && !row_dirty[run_end])
+				run_end++;
+			
+			p_sparse_array->AddRowsFromArray(previous_dist_str, row, run_end - row, row);
+			row = run_end;
+		}
+	}
+	
+	return true;
+}
+
+#ifdef _OPENMP
+// add neighbors to the sparse array for rows [start_row, after_end_row) using multiple threads; the rows are divided into
+// contiguous blocks, each block is built into its own sparse array by whichever thread picks it up, and the blocks are then
+// appended to p_sparse_array in row order.  This is safe because the grid and positions are only read during the build.
+void InteractionType::BuildSA_Grid_Parallel(InteractionsData &p_subpop_data, SparseArray *p_sparse_array, int start_row, int after_end_row, int start_exerter, int after_end_exerter)
+{
+	// use several blocks per thread, so that threads finishing sparse regions early can help with dense regions
+	int row_count = after_end_row - start_row;
+	int block_count = std::min(omp_get_max_threads() * 4, row_count);
+	uint32_t column_count = p_sparse_array->ColumnCount();
+	
+	while ((int)sa_chunks_.size() < block_count)
+		sa_chunks_.push_back(new SparseArray(1, column_count));
+	
+	// An exception must not escape the parallel region (that would call std::terminate()), and EIDOS_TERMINATION is not thread-safe,
+	// so nothing inside it may raise.  Each block has at least one row and column_count is non-zero, so Reset() cannot raise; the
+	// only other failure is overflowing a chunk's entry count, so a block stops before any row that could overflow it (a row adds
+	// at most column_count entries) and the error is raised below, after the region, instead.
+	bool chunk_overflow = false;
+	
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int block_index = 0; block_index < block_count; ++block_index)
+	{
+		int block_start = start_row + (int)(((int64_t)row_count * block_index) / block_count);
+		int block_end = start_row + (int)(((int64_t)row_count * (block_index + 1)) / block_count);
+		SparseArray *chunk = sa_chunks_[block_index];
+		
+		chunk->Reset(block_end - block_start, column_count);
+		
+		for (int row = block_start; row < block_end; row++)
+		{
+			if ((uint64_t)chunk->NonZeroCount() + column_count > UINT32_MAX)
+			{
+#pragma omp atomic write
+				chunk_overflow = true;
+				break;
+			}
+			
+			BuildSA_Grid(p_subpop_data, row, chunk, block_start, start_exerter, after_end_exerter);
+		}
+	}
+	
+	if (chunk_overflow)
+		EIDOS_TERMINATION << "ERROR (InteractionType::BuildSA_Grid_Parallel): too many interacting pairs for sparse array." << EidosTerminate();
+	
+	for (int block_index = 0; block_index < block_count; ++block_index)
+	{
+		int block_start = start_row + (int)(((int64_t)row_count * block_index) / block_count);
+		
+		SparseArray *chunk = sa_chunks_[block_index];
+		
+		p_sparse_array->AddRowsFromArray(*chunk, 0, chunk->AddedRowCount(), block_start);
+	}
+}
+#endif
+
+
 #pragma mark -
 #pragma mark k-d tree neighbor searches
 #pragma mark -
@@ -2312,7 +2973,84 @@ void InteractionType::FindNeighborsA_3(SLiM_kdNode *root, double *nd, slim_popsi
 // globals to decrease parameter-passing
 slim_popsize_t gKDTree_found_count;
 double gKDTree_worstbest;
-int gKDTree_worstbest_index;
+
+// The N best candidates found so far are kept as a max-heap on squared distance, so the worst of the best is always at index 0
+// and replacing it costs O(log N) rather than the O(N) scan for the new worst that a flat list needs; this matters when scripts
+// ask for hundreds of nearest neighbors.  Candidates are accepted if within the max distance until the roster is full; after
+// that a candidate must beat the worst of the best, which is kept in gKDTree_worstbest for pruning by FindNeighborsN_X().
+static inline void KDTreeHeapSiftUp(SLiM_kdNode **best, double *best_dist, int p_index)
+{
+	SLiM_kdNode *node = best[p_index];
+	double dist = best_dist[p_index];
+	
+	while (p_index > 0)
+	{
+		int parent = (p_index - 1) >> 1;
+		
+		if (best_dist[parent] >= dist)
+			break;
+		
+		best[p_index] = best[parent];
+		best_dist[p_index] = best_dist[parent];
+		p_index = parent;
+	}
+	
+	best[p_index] = node;
+	best_dist[p_index] = dist;
+}
+
+static inline void KDTreeHeapSiftDown(SLiM_kdNode **best, double *best_dist, int p_count)
+{
+	SLiM_kdNode *node = best[0];
+	double dist = best_dist[0];
+	int index = 0;
+	
+	while (true)
+	{
+		int child = (index << 1) + 1;
+		
+		if (child >= p_count)
+			break;
+		if ((child + 1 < p_count) && (best_dist[child + 1] > best_dist[child]))
+			child++;
+		if (best_dist[child] <= dist)
+			break;
+		
+		best[index] = best[child];
+		best_dist[index] = best_dist[child];
+		index = child;
+	}
+	
+	best[index] = node;
+	best_dist[index] = dist;
+}
+
+inline __attribute__((always_inline)) void InteractionType::AddNeighborCandidateN(SLiM_kdNode *p_node, double p_dist_sq, int p_count, SLiM_kdNode **best, double *best_dist)
+{
+	if (gKDTree_found_count == p_count)
+	{
+		// We have a full roster of candidates, so now the question is, is this one better than the worst one?
+		if (p_dist_sq < gKDTree_worstbest)
+		{
+			// Replace the worst of the best, at the top of the heap, and restore the heap
+			best[0] = p_node;
+			best_dist[0] = p_dist_sq;
+			KDTreeHeapSiftDown(best, best_dist, p_count);
+			
+			gKDTree_worstbest = best_dist[0];
+		}
+	}
+	else if (p_dist_sq <= max_distance_sq_)
+	{
+		// We do not yet have a full roster of candidates, so if this one is qualified, it is in
+		best[gKDTree_found_count] = p_node;
+		best_dist[gKDTree_found_count] = p_dist_sq;
+		KDTreeHeapSiftUp(best, best_dist, gKDTree_found_count);
+		
+		if (++gKDTree_found_count == p_count)
+			gKDTree_worstbest = best_dist[0];
+	}
+}
 
 // find N neighbors in 1D
 void InteractionType::FindNeighborsN_1(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, int p_count, SLiM_kdNode **best, double *best_dist)
@@ -2328,50 +3066,7 @@ void InteractionType::FindNeighborsN_1(SLiM_kdNode *root, double *nd, slim_popsi
 	double dx2 = dx * dx;
 	
 	if (root->individual_index_ != p_focal_individual_index)
-	{
-		if (gKDTree_found_count == p_count)
-		{
-			// We have a full roster of candidates, so now the question is, is this one better than the worst one?
-			if (d < gKDTree_worstbest)
-			{
-				// Replace the worst of the best
-				best_dist[gKDTree_worstbest_index] = d;
-				best[gKDTree_worstbest_index] = root;
-				
-				// Scan to find the new worst of the best
-				gKDTree_worstbest = -1;
-				
-				for (int best_index = 0; best_index < p_count; ++best_index)
-				{
-					if (best_dist[best_index] > gKDTree_worstbest)
-					{
-						gKDTree_worstbest = best_dist[best_index];
-						gKDTree_worstbest_index = best_index;
-					}
-				}
-			}
-		}
-		else
-		{
-			// We do not yet have a full roster of candidates, so if this one is qualified, it is in
-			if (d <= max_distance_sq_)
-			{
-				// Replace the first empty entry
-				best_dist[gKDTree_found_count] = d;
-				best[gKDTree_found_count] = root;
-				
-				// Update the worst of the best as needed
-				if (d > gKDTree_worstbest)
-				{
-					gKDTree_worstbest = d;
-					gKDTree_worstbest_index = gKDTree_found_count;
-				}
-				
-				// Move to the next slot
-				gKDTree_found_count++;
-			}
-		}
-	}
+		AddNeighborCandidateN(root, d, p_count, best, best_dist);
 	
 	// Continue the search
 	FindNeighborsN_1(dx > 0 ? root->left : root->right, nd, p_focal_individual_index, p_count, best, best_dist);
@@ -2404,50 +3099,7 @@ void InteractionType::FindNeighborsN_2(SLiM_kdNode *root, double *nd, slim_popsi
 	double dx2 = dx * dx;
 	
 	if (root->individual_index_ != p_focal_individual_index)
-	{
-		if (gKDTree_found_count == p_count)
-		{
-			// We have a full roster of candidates, so now the question is, is this one better than the worst one?
-			if (d < gKDTree_worstbest)
-			{
-				// Replace the worst of the best
-				best_dist[gKDTree_worstbest_index] = d;
-				best[gKDTree_worstbest_index] = root;
-				
-				// Scan to find the new worst of the best
-				gKDTree_worstbest = -1;
-				
-				for (int best_index = 0; best_index < p_count; ++best_index)
-				{
-					if (best_dist[best_index] > gKDTree_worstbest)
-					{
-						gKDTree_worstbest = best_dist[best_index];
-						gKDTree_worstbest_index = best_index;
-					}
-				}
-			}
-		}
-		else
-		{
-			// We do not yet have a full roster of candidates, so if this one is qualified, it is in
-			if (d <= max_distance_sq_)
-			{
-				// Replace the first empty entry
-				best_dist[gKDTree_found_count] = d;
-				best[gKDTree_found_count] = root;
-				
-				// Update the worst of the best as needed
-				if (d > gKDTree_worstbest)
-				{
-					gKDTree_worstbest = d;
-					gKDTree_worstbest_index = gKDTree_found_count;
-				}
-				
-				// Move to the next slot
-				gKDTree_found_count++;
-			}
-		}
-	}
+		AddNeighborCandidateN(root, d, p_count, best, best_dist);
 	
 	// Continue the search
 	if (++p_phase >= 2) p_phase = 0;
@@ -2482,50 +3134,7 @@ void InteractionType::FindNeighborsN_3(SLiM_kdNode *root, double *nd, slim_popsi
 	double dx2 = dx * dx;
 	
 	if (root->individual_index_ != p_focal_individual_index)
-	{
-		if (gKDTree_found_count == p_count)
-		{
-			// We have a full roster of candidates, so now the question is, is this one better than the worst one?
-			if (d < gKDTree_worstbest)
-			{
-				// Replace the worst of the best
-				best_dist[gKDTree_worstbest_index] = d;
-				best[gKDTree_worstbest_index] = root;
-				
-				// Scan to find the new worst of the best
-				gKDTree_worstbest = -1;
-				
-				for (int best_index = 0; best_index < p_count; ++best_index)
-				{
-					if (best_dist[best_index] > gKDTree_worstbest)
-					{
-						gKDTree_worstbest = best_dist[best_index];
-						gKDTree_worstbest_index = best_index;
-					}
-				}
-			}
-		}
-		else
-		{
-			// We do not yet have a full roster of candidates, so if this one is qualified, it is in
-			if (d <= max_distance_sq_)
-			{
-				// Replace the first empty entry
-				best_dist[gKDTree_found_count] = d;
-				best[gKDTree_found_count] = root;
-				
-				// Update the worst of the best as needed
-				if (d > gKDTree_worstbest)
-				{
-					gKDTree_worstbest = d;
-					gKDTree_worstbest_index = gKDTree_found_count;
-				}
-				
-				// Move to the next slot
-				gKDTree_found_count++;
-			}
-		}
-	}
+		AddNeighborCandidateN(root, d, p_count, best, best_dist);
 	
 	// Continue the search
 	if (++p_phase >= 3) p_phase = 0;
@@ -4099,6 +4708,34 @@ const std::vector<EidosMethodSignature_CSP> *InteractionType_Class::Methods(void
 #pragma mark _InteractionsData
 #pragma mark -
 
+static void FreeGridBuffers(SLiM_Grid &p_grid)
+{
+	free(p_grid.cell_starts_);
+	free(p_grid.members_);
+	free(p_grid.positions_);
+	free(p_grid.individual_cells_);
+	
+	p_grid = SLiM_Grid();
+}
+
+// copies the bookkeeping for incremental rebuilding; the caller takes care of the pointers in p_source
+static void CopyPreviousEvaluationState(_InteractionsData &p_dest, _InteractionsData &p_source)
+{
+	p_dest.previous_positions_ = p_source.previous_positions_;
+	p_dest.previous_dist_str_ = p_source.previous_dist_str_;
+	p_dest.previous_dist_str_valid_ = p_source.previous_dist_str_valid_;
+	p_dest.retain_previous_dist_str_ = p_source.retain_previous_dist_str_;
+	p_dest.previous_individual_count_ = p_source.previous_individual_count_;
+	p_dest.previous_first_male_index_ = p_source.previous_first_male_index_;
+	p_dest.previous_max_distance_ = p_source.previous_max_distance_;
+	
+	for (int dim = 0; dim < SLIM_MAX_DIMENSIONALITY; ++dim)
+	{
+		p_dest.previous_bounds_[dim] = p_source.previous_bounds_[dim];
+		p_dest.previous_grid_scale_[dim] = p_source.previous_grid_scale_[dim];
+	}
+}
+
 _InteractionsData::_InteractionsData(_InteractionsData&& p_source)
 {
 	evaluated_ = p_source.evaluated_;
@@ -4110,6 +4747,8 @@ _InteractionsData::_InteractionsData(_InteractionsData&& p_source)
 	dist_str_ = p_source.dist_str_;
 	kd_nodes_ = p_source.kd_nodes_;
 	kd_root_ = p_source.kd_root_;
+	grid_ = p_source.grid_;
+	CopyPreviousEvaluationState(*this, p_source);
 	
 	p_source.evaluated_ = false;
 	p_source.evaluation_interaction_callbacks_.clear();
@@ -4120,6 +4759,10 @@ _InteractionsData::_InteractionsData(_InteractionsData&& p_source)
 	p_source.dist_str_ = nullptr;
 	p_source.kd_nodes_ = nullptr;
 	p_source.kd_root_ = nullptr;
+	p_source.grid_ = SLiM_Grid();
+	p_source.previous_positions_ = nullptr;
+	p_source.previous_dist_str_ = nullptr;
+	p_source.previous_dist_str_valid_ = false;
 }
 
 _InteractionsData& _InteractionsData::operator=(_InteractionsData&& p_source)
@@ -4132,6 +4775,11 @@ _InteractionsData& _InteractionsData::operator=(_InteractionsData&& p_source)
 			delete dist_str_;
 		if (kd_nodes_)
 			free(kd_nodes_);
+		FreeGridBuffers(grid_);
+		if (previous_positions_)
+			free(previous_positions_);
+		if (previous_dist_str_)
+			delete previous_dist_str_;
 		
 		evaluated_ = p_source.evaluated_;
 		evaluation_interaction_callbacks_.swap(p_source.evaluation_interaction_callbacks_);
@@ -4142,6 +4790,8 @@ _InteractionsData& _InteractionsData::operator=(_InteractionsData&& p_source)
 		dist_str_ = p_source.dist_str_;
 		kd_nodes_ = p_source.kd_nodes_;
 		kd_root_ = p_source.kd_root_;
+		grid_ = p_source.grid_;
+		CopyPreviousEvaluationState(*this, p_source);
 		
 		p_source.evaluated_ = false;
 		p_source.evaluation_interaction_callbacks_.clear();
@@ -4152,6 +4802,10 @@ _InteractionsData& _InteractionsData::operator=(_InteractionsData&& p_source)
 		p_source.dist_str_ = nullptr;
 		p_source.kd_nodes_ = nullptr;
 		p_source.kd_root_ = nullptr;
+		p_source.grid_ = SLiM_Grid();
+		p_source.previous_positions_ = nullptr;
+		p_source.previous_dist_str_ = nullptr;
+		p_source.previous_dist_str_valid_ = false;
 	}
 	
 	return *this;
@@ -4187,6 +4841,20 @@ _InteractionsData::~_InteractionsData(void)
 	
 	kd_root_ = nullptr;
 	
+	FreeGridBuffers(grid_);
+	
+	if (previous_positions_)
+	{
+		free(previous_positions_);
+		previous_positions_ = nullptr;
+	}
+	
+	if (previous_dist_str_)
+	{
+		delete previous_dist_str_;
+		previous_dist_str_ = nullptr;
+	}
+	
 	// Unnecessary since it's about to be destroyed anyway
 	//evaluation_interaction_callbacks_.clear();
 }
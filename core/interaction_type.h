@@ -78,6 +78,31 @@ struct _SLiM_kdNode
 };
 typedef struct _SLiM_kdNode SLiM_kdNode;
 
+// As an alternative to the k-d tree, the distances for all interacting pairs in a subpopulation (CalculateAllDistances()) can be
+// found using a uniform grid whose cells are at least max_distance_ wide in every dimension, so that all of the interacting
+// neighbors of an individual lie in its own cell or an adjacent cell.  The grid is built in linear time with a counting sort
+// of the individuals by cell, and keeps a copy of the positions in cell order so that scanning a cell reads memory sequentially.
+// It is used automatically whenever max_distance_ is finite; see EnsureGridPresent().  In non-periodic dimensions the cells lie
+// on a fixed lattice anchored at zero, and the grid covers just the lattice cells spanned by the individuals; this keeps the
+// order in which neighbors are found independent of where the extreme individuals happen to be, which incremental rebuilding
+// of the sparse array relies upon (see BuildSA_Grid_Incremental()).
+struct _SLiM_Grid
+{
+	bool present_ = false;						// true if the grid below is in sync with positions_
+	int32_t cell_count_[SLIM_MAX_DIMENSIONALITY];	// the number of cells along each dimension (1 for unused dimensions)
+	int64_t origin_cell_[SLIM_MAX_DIMENSIONALITY];	// the lattice coordinate of the grid's first cell in each dimension (0 if periodic)
+	double scale_[SLIM_MAX_DIMENSIONALITY];			// cells per unit distance in each dimension
+	
+	uint32_t *cell_starts_ = nullptr;			// for N cells, N+1 offsets into members_/positions_ (extra end entry)
+	slim_popsize_t *members_ = nullptr;			// individual indices, sorted by cell
+	double *positions_ = nullptr;				// SLIM_MAX_DIMENSIONALITY coordinates for each entry in members_
+	uint32_t *individual_cells_ = nullptr;		// the cell index of each individual, by individual index
+	
+	size_t cells_capacity_ = 0;					// the number of cells allocated for in cell_starts_ (not counting the end entry)
+	size_t individuals_capacity_ = 0;			// the number of individuals allocated for in members_, positions_, and individual_cells_
+};
+typedef struct _SLiM_Grid SLiM_Grid;
+
 struct _InteractionsData
 {
 	// This flag is true when the interaction has been evaluated.  What that means in practice is that allocated blocks below
@@ -103,6 +128,21 @@ struct _InteractionsData
 	SparseArray *dist_str_ = nullptr;		// a sparse array of interaction distances/strengths between individuals, individual_count_ x individual_count_
 	SLiM_kdNode *kd_nodes_ = nullptr;		// individual_count_ entries, holding the nodes of the k-d tree
 	SLiM_kdNode *kd_root_ = nullptr;		// the root of the k-d tree
+	SLiM_Grid grid_;						// a uniform grid, used instead of the k-d tree to build dist_str_ when possible
+	
+	// State kept from the previous evaluation, so that dist_str_ can be rebuilt incrementally when few individuals have moved,
+	// been added, or been removed since then; rows of dist_str_ that no change could affect are then copied from the previous
+	// sparse array rather than recalculated.  The previous positions are always kept, since they are small and tell us whether
+	// an incremental rebuild would pay off; the previous sparse array is kept only when the last comparison said it would.
+	double *previous_positions_ = nullptr;	// previous_individual_count_ * SLIM_MAX_DIMENSIONALITY entries, or nullptr
+	SparseArray *previous_dist_str_ = nullptr;	// the finished sparse array of the previous evaluation, if previous_dist_str_valid_
+	bool previous_dist_str_valid_ = false;	// true if previous_dist_str_ holds the distances for previous_positions_
+	bool retain_previous_dist_str_ = false;	// true if the last comparison of positions found few enough changes to rebuild incrementally
+	slim_popsize_t previous_individual_count_ = 0;
+	slim_popsize_t previous_first_male_index_ = 0;
+	double previous_max_distance_ = 0.0;
+	double previous_bounds_[SLIM_MAX_DIMENSIONALITY];
+	double previous_grid_scale_[SLIM_MAX_DIMENSIONALITY];
 	
 	_InteractionsData(const _InteractionsData&) = delete;					// no copying
 	_InteractionsData& operator=(const _InteractionsData&) = delete;		// no copying
@@ -149,6 +189,10 @@ private:
 	
 	std::map<slim_objectid_t, InteractionsData> data_;		// cached data for the interaction, for each subpopulation
 	
+#ifdef _OPENMP
+	std::vector<SparseArray *> sa_chunks_;					// per-task blocks of sparse array rows for parallel building; kept for reuse
+#endif
+	
 	void CalculateAllDistances(Subpopulation *p_subpop);
 	void CalculateAllStrengths(Subpopulation *p_subpop);
 	
@@ -168,6 +212,7 @@ private:
 	SLiM_kdNode *MakeKDTree3_p1(SLiM_kdNode *t, int len);
 	SLiM_kdNode *MakeKDTree3_p2(SLiM_kdNode *t, int len);
 	void EnsureKDTreePresent(InteractionsData &p_subpop_data);
+	bool EnsureGridPresent(InteractionsData &p_subpop_data);
 	
 	int CheckKDTree1_p0(SLiM_kdNode *t);
 	void CheckKDTree1_p0_r(SLiM_kdNode *t, double split, bool isLeftSubtree);
@@ -188,6 +233,15 @@ private:
 	void BuildSA_SS_1(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, int start_exerter, int after_end_exerter);
 	void BuildSA_SS_2(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, int start_exerter, int after_end_exerter, int p_phase);
 	void BuildSA_SS_3(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, int start_exerter, int after_end_exerter, int p_phase);
+	void GridNeighborCells(SLiM_Grid &p_grid, double *p_point, int32_t p_neighbor_cells[][3], int *p_neighbor_cell_count);
+	void BuildSA_Grid(InteractionsData &p_subpop_data, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, uint32_t p_first_row, int start_exerter, int after_end_exerter);
+	bool BuildSA_Grid_Incremental(InteractionsData &p_subpop_data, SparseArray *p_sparse_array, int start_row, int after_end_row, int start_exerter, int after_end_exerter);
+	void RetainPreviousEvaluation(InteractionsData &p_subpop_data);
+	template <int SPATIALITY, bool ANY_PERIODIC>
+	void BuildSA_Grid_D(InteractionsData &p_subpop_data, slim_popsize_t p_focal_individual_index, SparseArray *p_sparse_array, uint32_t p_first_row, int start_exerter, int after_end_exerter);
+#ifdef _OPENMP
+	void BuildSA_Grid_Parallel(InteractionsData &p_subpop_data, SparseArray *p_sparse_array, int start_row, int after_end_row, int start_exerter, int after_end_exerter);
+#endif
 	
 	void FindNeighbors1_1(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, SLiM_kdNode **best, double *best_dist);
 	void FindNeighbors1_2(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, SLiM_kdNode **best, double *best_dist, int p_phase);
@@ -195,6 +249,7 @@ private:
 	void FindNeighborsA_1(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, EidosValue_Object_vector &p_result_vec, std::vector<Individual *> &p_individuals);
 	void FindNeighborsA_2(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, EidosValue_Object_vector &p_result_vec, std::vector<Individual *> &p_individuals, int p_phase);
 	void FindNeighborsA_3(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, EidosValue_Object_vector &p_result_vec, std::vector<Individual *> &p_individuals, int p_phase);
+	inline __attribute__((always_inline)) void AddNeighborCandidateN(SLiM_kdNode *p_node, double p_dist_sq, int p_count, SLiM_kdNode **best, double *best_dist);
 	void FindNeighborsN_1(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, int p_count, SLiM_kdNode **best, double *best_dist);
 	void FindNeighborsN_2(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, int p_count, SLiM_kdNode **best, double *best_dist, int p_phase);
 	void FindNeighborsN_3(SLiM_kdNode *root, double *nd, slim_popsize_t p_focal_individual_index, int p_count, SLiM_kdNode **best, double *best_dist, int p_phase);
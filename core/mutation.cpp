@@ -184,6 +184,11 @@ mutation_type_ptr_(p_mutation_type_ptr), position_(p_position), selection_coeff_
 	// initialize the tag to the "unset" value
 	tag_value_ = SLIM_TAG_UNSET_VALUE;
 	
+#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
+	// not registered in our muttype's registry until AddToMuttypeRegistry() is called
+	muttype_registry_index_ = -1;
+#endif
+	
 	// cache values used by the fitness calculation code for speed; see header
 	cached_one_plus_sel_ = (slim_selcoeff_t)std::max(0.0, 1.0 + selection_coeff_);
 	cached_one_plus_dom_sel_ = (slim_selcoeff_t)std::max(0.0, 1.0 + mutation_type_ptr_->dominance_coeff_ * selection_coeff_);
@@ -236,6 +241,11 @@ mutation_type_ptr_(p_mutation_type_ptr), position_(p_position), selection_coeff_
 	// initialize the tag to the "unset" value
 	tag_value_ = SLIM_TAG_UNSET_VALUE;
 	
+#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
+	// not registered in our muttype's registry until AddToMuttypeRegistry() is called
+	muttype_registry_index_ = -1;
+#endif
+	
 	// cache values used by the fitness calculation code for speed; see header
 	cached_one_plus_sel_ = (slim_selcoeff_t)std::max(0.0, 1.0 + selection_coeff_);
 	cached_one_plus_dom_sel_ = (slim_selcoeff_t)std::max(0.0, 1.0 + mutation_type_ptr_->dominance_coeff_ * selection_coeff_);
@@ -641,6 +651,22 @@ EidosValue_SP Mutation::ExecuteMethod_setMutationType(EidosGlobalStringID p_meth
 	if (mutation_type_ptr->nucleotide_based_ != mutation_type_ptr_->nucleotide_based_)
 		EIDOS_TERMINATION << "ERROR (Mutation::ExecuteMethod_setMutationType): setMutationType() does not allow a mutation to be changed from nucleotide-based to non-nucleotide-based or vice versa." << EidosTerminate();
 	
+#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
+	// Move ourselves from our old muttype's registry to the new one's, if we are still registered (a mutation that has been lost or
+	// fixed is no longer in its muttype's registry, but the user might still have a reference to it)
+	if (mutation_type_ptr != mutation_type_ptr_)
+	{
+		MutationIndex mut_index = BlockIndex();
+		MutationRun &old_registry = mutation_type_ptr_->muttype_registry_;
+		
+		if ((muttype_registry_index_ >= 0) && (muttype_registry_index_ < old_registry.size()) && (old_registry[muttype_registry_index_] == mut_index))
+		{
+			mutation_type_ptr_->RemoveFromMuttypeRegistry(mut_index);
+			mutation_type_ptr->AddToMuttypeRegistry(mut_index);
+		}
+	}
+#endif
+	
 	// We take just the mutation type pointer; if the user wants a new selection coefficient, they can do that themselves
 	mutation_type_ptr_ = mutation_type_ptr;
 	
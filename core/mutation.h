@@ -86,6 +86,10 @@ public:
 	slim_selcoeff_t cached_one_plus_sel_;				// a cached value for (1 + selection_coeff_), clamped to 0.0 minimum
 	slim_selcoeff_t cached_one_plus_dom_sel_;			// a cached value for (1 + dominance_coeff * selection_coeff_), clamped to 0.0 minimum
 	
+#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
+	int32_t muttype_registry_index_;					// our index in mutation_type_ptr_->muttype_registry_, for O(1) removal; valid only while registered
+#endif
+	
 	Mutation(const Mutation&) = delete;					// no copying
 	Mutation& operator=(const Mutation&) = delete;		// no copying
 	Mutation(void) = delete;							// no null construction; Mutation is an immutable class
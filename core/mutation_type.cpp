@@ -59,9 +59,6 @@ MutationType::MutationType(SLiMSim &p_sim, slim_objectid_t p_mutation_type_id, d
 #endif
 self_symbol_(Eidos_GlobalStringIDForString(SLiMEidosScript::IDStringWithPrefix('m', p_mutation_type_id)), EidosValue_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_Object_singleton(this, gSLiM_MutationType_Class))),
 	sim_(p_sim), mutation_type_id_(p_mutation_type_id), dominance_coeff_(static_cast<slim_selcoeff_t>(p_dominance_coeff)), dominance_coeff_changed_(false), dfe_type_(p_dfe_type), dfe_parameters_(p_dfe_parameters), dfe_strings_(p_dfe_strings), nucleotide_based_(p_nuc_based), convert_to_substitution_(false), stack_policy_(MutationStackPolicy::kStack), stack_group_(p_mutation_type_id), cached_dfe_script_(nullptr)
-#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	, muttype_registry_call_count_(0), keeping_muttype_registry_(false)
-#endif
 #ifdef SLIMGUI
 	, mutation_type_index_(p_mutation_type_index)
 #endif
@@ -95,14 +92,6 @@ MutationType::~MutationType(void)
 {
 	delete cached_dfe_script_;
 	cached_dfe_script_ = nullptr;
-	
-#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	if (keeping_muttype_registry_)
-	{
-		muttype_registry_.clear();
-		keeping_muttype_registry_ = false;
-	}
-#endif
 }
 
 void MutationType::ParseDFEParameters(std::string &p_dfe_type_string, const EidosValue_SP *const p_arguments, int p_argument_count, DFEType *p_dfe_type, std::vector<double> *p_dfe_parameters, std::vector<std::string> *p_dfe_strings)
@@ -104,16 +104,33 @@ public:
 	mutable EidosScript *cached_dfe_script_;	// used by DFE type 's' to hold a cached script for the DFE
 	
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	// MutationType now has the ability to (optionally) keep a registry of all extant mutations of its type in the simulation,
-	// separate from the main registry kept by Population.  This allows much faster response to SLiMSim::mutationsOfType()
-	// and SLiMSim::countOfMutationsOfType(), because the muttype's registry can be consulted rather than doing a full scan of
-	// main registry.  However, there is obviously overhead associated with adding/removing mutations from another registry, so
-	// this feature is only turned on if there is demand: when more than one call per generation is made to SLiMSim::mutationsOfType()
-	// or SLiMSim::countOfMutationsOfType() for a given muttype.  From then on, that muttype will track its own registry.  Obviously
-	// this heuristic could be refined, perhaps with a way to stop tracking if it no longer seems to be used.
-	mutable int muttype_registry_call_count_;
-	mutable bool keeping_muttype_registry_;
+	// MutationType keeps a registry of all extant mutations of its type in the simulation, separate from the main registry kept by
+	// Population.  This allows SLiMSim::mutationsOfType() and SLiMSim::countOfMutationsOfType() to answer in time proportional to the
+	// size of the result, rather than doing a full scan of the main registry.  The registry is always kept, for every muttype; each
+	// mutation knows its index in its muttype's registry (Mutation::muttype_registry_index_), so removal is O(1) with a backfill.
 	MutationRun muttype_registry_;
+	
+	inline __attribute__((always_inline)) void AddToMuttypeRegistry(MutationIndex p_mut_index)
+	{
+		(gSLiM_Mutation_Block + p_mut_index)->muttype_registry_index_ = muttype_registry_.size();
+		muttype_registry_.emplace_back(p_mut_index);
+	}
+	
+	inline __attribute__((always_inline)) void RemoveFromMuttypeRegistry(MutationIndex p_mut_index)
+	{
+		int32_t registry_index = (gSLiM_Mutation_Block + p_mut_index)->muttype_registry_index_;
+		int32_t last_index = muttype_registry_.size() - 1;
+		
+		if (registry_index != last_index)
+		{
+			MutationIndex last_mut_index = muttype_registry_[last_index];
+			
+			muttype_registry_[registry_index] = last_mut_index;
+			(gSLiM_Mutation_Block + last_mut_index)->muttype_registry_index_ = registry_index;
+		}
+		
+		muttype_registry_.pop_back();
+	}
 #endif
 	
 	// For optimizing the fitness calculation code, the exact situation for each mutation type is of great interest: does it have
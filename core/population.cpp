@@ -100,24 +100,11 @@ void Population::RemoveAllSubpopulationInfo(void)
 	mutation_registry_.clear();
 	
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	// If we're keeping any separate registries inside mutation types, clear those now as well
-	if (keeping_muttype_registries_)
-	{
-		const std::map<slim_objectid_t,MutationType*> &mut_types = sim_.MutationTypes();
-		
-		for (auto muttype_iter : mut_types)
-		{
-			MutationType *muttype = muttype_iter.second;
-			
-			if (muttype->keeping_muttype_registry_)
-			{
-				muttype->muttype_registry_.clear();
-				muttype->keeping_muttype_registry_ = false;
-			}
-		}
-		
-		keeping_muttype_registries_ = false;
-	}
+	// Clear the separate registries kept by mutation types as well
+	const std::map<slim_objectid_t,MutationType*> &mut_types = sim_.MutationTypes();
+	
+	for (auto muttype_iter : mut_types)
+		muttype_iter.second->muttype_registry_.clear();
 #endif
 	
 #ifdef SLIMGUI
@@ -330,6 +317,9 @@ void Population::RemoveSubpopulation(Subpopulation &p_subpop)
 		
 		// remember the subpop for later disposal
 		removed_subpops_.emplace_back(&p_subpop);
+		
+		// cached mutation counts/frequencies for sets of subpops including this one are no longer usable
+		InvalidateMutationReferencesCache();
 	}
 }
 #endif  // SLIM_NONWF_ONLY
@@ -2593,8 +2583,7 @@ void Population::DoCrossoverMutation(Subpopulation *p_source_subpop, Genome &p_c
 						mutation_registry_.emplace_back(mutation_iter_mutation_index);
 						
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-						if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-							new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+						new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 						
 						// TREE SEQUENCE RECORDING
@@ -2740,8 +2729,7 @@ void Population::DoCrossoverMutation(Subpopulation *p_source_subpop, Genome &p_c
 										mutation_registry_.emplace_back(mutation_iter_mutation_index);
 										
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-										if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-											new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+										new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 										
 										// TREE SEQUENCE RECORDING
@@ -2786,8 +2774,7 @@ void Population::DoCrossoverMutation(Subpopulation *p_source_subpop, Genome &p_c
 									mutation_registry_.emplace_back(mutation_iter_mutation_index);
 									
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-									if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-										new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+									new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 									
 									// TREE SEQUENCE RECORDING
@@ -2933,8 +2920,7 @@ void Population::DoCrossoverMutation(Subpopulation *p_source_subpop, Genome &p_c
 							mutation_registry_.emplace_back(mutation_iter_mutation_index);
 							
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-							if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-								new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+							new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 							
 							// TREE SEQUENCE RECORDING
@@ -3022,27 +3008,53 @@ void Population::DoHeteroduplexRepair(std::vector<slim_position_t> &p_heterodupl
 	std::vector<slim_position_t> repair_removals;
 	std::vector<Mutation*> repair_additions;
 	
+	// The heteroduplex tracts are sorted and non-overlapping (see Chromosome::DrawDSBBreakpoints()),
+	// as are the breakpoints, so we determine the copy strand for all tracts in a single merged pass
+	// through the breakpoints, carrying the breakpoint index and strand state from tract to tract.
+	std::size_t breakpoint_index = 0, breakpoint_count = p_breakpoints.size();
+	bool copy_strand_is_1 = true;
+	slim_position_t mutrun_length = p_child_genome->mutrun_length_;
+	
 	for (int heteroduplex_tract_index = 0; heteroduplex_tract_index < heteroduplex_tract_count; ++heteroduplex_tract_index)
 	{
 		slim_position_t tract_start = p_heteroduplex[heteroduplex_tract_index * 2];
 		slim_position_t tract_end = p_heteroduplex[heteroduplex_tract_index * 2 + 1];
 		
-		// Determine which parental strand was the non-copy strand in this region, by scanning
-		// the breakpoints vector; it must remain the non-copy strand throughout.
-		bool copy_strand_is_1 = true;
-		
-		for (slim_position_t breakpoint : p_breakpoints)
+		// Determine which parental strand was the non-copy strand in this region, by advancing
+		// through the breakpoints vector; it must remain the non-copy strand throughout.
+		while ((breakpoint_index < breakpoint_count) && (p_breakpoints[breakpoint_index] <= tract_start))
 		{
-			if (breakpoint <= tract_start)
-				copy_strand_is_1 = !copy_strand_is_1;
-			else if (breakpoint > tract_end)
-				break;
-			else
-				EIDOS_TERMINATION << "ERROR (Population::DoCrossoverMutation): (internal error) The heteroduplex tract does not have a consistent copy strand." << EidosTerminate();
+			copy_strand_is_1 = !copy_strand_is_1;
+			breakpoint_index++;
 		}
 		
+		if ((breakpoint_index < breakpoint_count) && (p_breakpoints[breakpoint_index] <= tract_end))
+			EIDOS_TERMINATION << "ERROR (Population::DoCrossoverMutation): (internal error) The heteroduplex tract does not have a consistent copy strand." << EidosTerminate();
+		
 		Genome *noncopy_genome = (copy_strand_is_1 ? p_parent_genome_2 : p_parent_genome_1);
 		
+		// If the offspring genome shares every mutation run spanned by the tract with the non-copy
+		// strand, there can be no mismatches within the tract, and we can skip walking it entirely.
+		// This is the common case for tracts that fall in mutruns that were copied wholesale from
+		// the non-copy strand and left untouched by new mutations.
+		{
+			slim_mutrun_index_t first_run_index = (slim_mutrun_index_t)(tract_start / mutrun_length);
+			slim_mutrun_index_t last_run_index = (slim_mutrun_index_t)(tract_end / mutrun_length);
+			bool all_runs_shared = true;
+			
+			for (slim_mutrun_index_t run_index = first_run_index; run_index <= last_run_index; ++run_index)
+			{
+				if (p_child_genome->mutruns_[run_index].get() != noncopy_genome->mutruns_[run_index].get())
+				{
+					all_runs_shared = false;
+					break;
+				}
+			}
+			
+			if (all_runs_shared)
+				continue;
+		}
+		
 		// Make genome walkers for the non-copy strand and the offspring strand, and move them
 		// to the start of the heteroduplex tract region; we use SLIM_INF_BASE_POSITION to mean
 		// "past the end of the heteroduplex tract" here
@@ -3258,7 +3270,6 @@ void Population::DoHeteroduplexRepair(std::vector<slim_position_t> &p_heterodupl
 		// mutations to be added or removed we make a new mutation run and effect the changes
 		// as we copy mutations over.  Mutruns without changes are left untouched.
 		Mutation *mut_block_ptr = gSLiM_Mutation_Block;
-		slim_position_t mutrun_length = p_child_genome->mutrun_length_;
 		slim_position_t mutrun_count = p_child_genome->mutrun_count_;
 		std::size_t removal_index = 0, addition_index = 0;
 		slim_position_t next_removal_pos = (removal_index < repair_removals.size()) ? repair_removals[removal_index] : SLIM_INF_BASE_POSITION;
@@ -3685,8 +3696,7 @@ void Population::DoRecombinantMutation(Subpopulation *p_mutorigin_subpop, Genome
 									mutation_registry_.emplace_back(mutation_iter_mutation_index);
 									
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-									if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-										new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+									new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 									
 									// TREE SEQUENCE RECORDING
@@ -3731,8 +3741,7 @@ void Population::DoRecombinantMutation(Subpopulation *p_mutorigin_subpop, Genome
 								mutation_registry_.emplace_back(mutation_iter_mutation_index);
 								
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-								if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-									new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+								new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 								
 								// TREE SEQUENCE RECORDING
@@ -3878,8 +3887,7 @@ void Population::DoRecombinantMutation(Subpopulation *p_mutorigin_subpop, Genome
 						mutation_registry_.emplace_back(mutation_iter_mutation_index);
 						
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-						if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-							new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+						new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 						
 						// TREE SEQUENCE RECORDING
@@ -3930,6 +3938,21 @@ void Population::DoRecombinantMutation(Subpopulation *p_mutorigin_subpop, Genome
 #endif
 }
 
+inline void Population::CopyClonalGenome(Genome &p_child_genome, Genome &p_parent_genome)
+{
+#ifdef SLIM_WF_ONLY
+	// In WF models the child can share the parent's whole array of runs, making this O(1); ClearParentalGenomes() then
+	// leaves the child as the sole owner of the array.  See GenomeRunArrayHeader.
+	if (sim_.ModelType() == SLiMModelType::kModelTypeWF)
+	{
+		p_child_genome.share_from_genome(p_parent_genome);
+		return;
+	}
+#endif	// SLIM_WF_ONLY
+	
+	p_child_genome.copy_from_genome(p_parent_genome);
+}
+
 void Population::DoClonalMutation(Subpopulation *p_mutorigin_subpop, Genome &p_child_genome, Genome &p_parent_genome, IndividualSex p_child_sex, std::vector<SLiMEidosBlock*> *p_mutation_callbacks)
 {
 #pragma unused(p_child_sex)
@@ -3967,7 +3990,7 @@ void Population::DoClonalMutation(Subpopulation *p_mutorigin_subpop, Genome &p_c
 	if (num_mutations == 0)
 	{
 		// no mutations, so the child genome is just a copy of the parental genome
-		p_child_genome.copy_from_genome(p_parent_genome);
+		CopyClonalGenome(p_child_genome, p_parent_genome);
 	}
 	else
 	{
@@ -4013,7 +4036,7 @@ void Population::DoClonalMutation(Subpopulation *p_mutorigin_subpop, Genome &p_c
 				if (mutations_to_add.size() == 0)
 				{
 					MutationRun::FreeMutationRun(&mutations_to_add);
-					p_child_genome.copy_from_genome(p_parent_genome);
+					CopyClonalGenome(p_child_genome, p_parent_genome);
 					return;
 				}
 			}
@@ -4093,8 +4116,7 @@ void Population::DoClonalMutation(Subpopulation *p_mutorigin_subpop, Genome &p_c
 							mutation_registry_.emplace_back(mutation_iter_mutation_index);
 							
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-							if (keeping_muttype_registries_ && new_mut_type->keeping_muttype_registry_)
-								new_mut_type->muttype_registry_.emplace_back(mutation_iter_mutation_index);
+							new_mut_type->AddToMuttypeRegistry(mutation_iter_mutation_index);
 #endif
 							
 							// TREE SEQUENCE RECORDING
@@ -4707,7 +4729,7 @@ void Population::SplitMutationRuns(int32_t p_new_mutrun_count)
 					
 					genome.clear_to_nullptr();
 					if (genome.mutruns_ != genome.run_buffer_)
-						delete[] genome.mutruns_;
+						Genome::FreeRunArray(genome.mutruns_);
 					genome.mutruns_ = nullptr;
 					
 					genome.mutrun_count_ = new_mutrun_count;
@@ -4716,7 +4738,7 @@ void Population::SplitMutationRuns(int32_t p_new_mutrun_count)
 					if (new_mutrun_count <= SLIM_GENOME_MUTRUN_BUFSIZE)
 						genome.mutruns_ = genome.run_buffer_;
 					else
-						genome.mutruns_ = new MutationRun_SP[new_mutrun_count];
+						genome.mutruns_ = Genome::NewRunArray(new_mutrun_count);
 					
 					// Install empty MutationRun objects; I think this is not necessary, since this is the
 					// child generation, which will not be accessed by anybody until crossover-mutation
@@ -4808,7 +4830,7 @@ void Population::SplitMutationRuns(int32_t p_new_mutrun_count)
 				// now replace the runs in the genome with those in mutrun_buf
 				genome.clear_to_nullptr();
 				if (genome.mutruns_ != genome.run_buffer_)
-					delete[] genome.mutruns_;
+					Genome::FreeRunArray(genome.mutruns_);
 				genome.mutruns_ = nullptr;
 				
 				genome.mutrun_count_ = new_mutrun_count;
@@ -4817,7 +4839,7 @@ void Population::SplitMutationRuns(int32_t p_new_mutrun_count)
 				if (new_mutrun_count <= SLIM_GENOME_MUTRUN_BUFSIZE)
 					genome.mutruns_ = genome.run_buffer_;
 				else
-					genome.mutruns_ = new MutationRun_SP[new_mutrun_count];
+					genome.mutruns_ = Genome::NewRunArray(new_mutrun_count);
 				
 				for (int run_index = 0; run_index < new_mutrun_count; ++run_index)
 					genome.mutruns_[run_index].reset(mutruns_buf[run_index]);
@@ -4879,7 +4901,7 @@ void Population::JoinMutationRuns(int32_t p_new_mutrun_count)
 					
 					genome.clear_to_nullptr();
 					if (genome.mutruns_ != genome.run_buffer_)
-						delete[] genome.mutruns_;
+						Genome::FreeRunArray(genome.mutruns_);
 					genome.mutruns_ = nullptr;
 					
 					genome.mutrun_count_ = new_mutrun_count;
@@ -4888,7 +4910,7 @@ void Population::JoinMutationRuns(int32_t p_new_mutrun_count)
 					if (new_mutrun_count <= SLIM_GENOME_MUTRUN_BUFSIZE)
 						genome.mutruns_ = genome.run_buffer_;
 					else
-						genome.mutruns_ = new MutationRun_SP[new_mutrun_count];
+						genome.mutruns_ = Genome::NewRunArray(new_mutrun_count);
 					
 					// Install empty MutationRun objects; I think this is not necessary, since this is the
 					// child generation, which will not be accessed by anybody until crossover-mutation
@@ -4980,7 +5002,7 @@ void Population::JoinMutationRuns(int32_t p_new_mutrun_count)
 				// now replace the runs in the genome with those in mutrun_buf
 				genome.clear_to_nullptr();
 				if (genome.mutruns_ != genome.run_buffer_)
-					delete[] genome.mutruns_;
+					Genome::FreeRunArray(genome.mutruns_);
 				genome.mutruns_ = nullptr;
 				
 				genome.mutrun_count_ = new_mutrun_count;
@@ -4989,7 +5011,7 @@ void Population::JoinMutationRuns(int32_t p_new_mutrun_count)
 				if (new_mutrun_count <= SLIM_GENOME_MUTRUN_BUFSIZE)
 					genome.mutruns_ = genome.run_buffer_;
 				else
-					genome.mutruns_ = new MutationRun_SP[new_mutrun_count];
+					genome.mutruns_ = Genome::NewRunArray(new_mutrun_count);
 				
 				for (int run_index = 0; run_index < new_mutrun_count; ++run_index)
 					genome.mutruns_[run_index].reset(mutruns_buf[run_index]);
@@ -5016,7 +5038,7 @@ void Population::MaintainRegistry(void)
 #endif	// SLIM_WF_ONLY
 	
 	// go through all genomes and increment mutation reference counts; this updates total_genome_count_
-	TallyMutationReferences(nullptr, true);
+	TallyMutationReferences(true);
 	
 	// remove any mutations that have been eliminated or have fixed
 	RemoveAllFixedMutations();
@@ -5131,48 +5153,55 @@ void Population::SwapGenerations(void)
 
 // count the total number of times that each Mutation in the registry is referenced by a population, and return the maximum possible number of references (i.e. fixation)
 // the only tricky thing is that if we're running in the GUI, we also tally up references within the selected subpopulations only
-slim_refcount_t Population::TallyMutationReferences(std::vector<Subpopulation*> *p_subpops_to_tally, bool p_force_recache)
+slim_refcount_t Population::TallyMutationReferences(bool p_force_recache)
 {
-	// First, figure out whether we're doing all subpops or a subset
-	if (p_subpops_to_tally)
-	{
-		if (p_subpops_to_tally->size() == subpops_.size())
-		{
-			// Rather than doing an equality test, we'll just assume that if there are N subpops and we've been asked to tally across N subpops,
-			// we have been asked to tally across the whole population.  Hard to imagine a rational case that would violate that assumption.
-			p_subpops_to_tally = nullptr;
-		}
-	}
-	
-	// Second, figure out whether the last tally was of the same thing, such that we can skip the work
+	// First, figure out whether the last tally is still valid, such that we can skip the work
 	if (!p_force_recache && (cached_tally_genome_count_ != 0))
-	{
-		if ((p_subpops_to_tally == nullptr) && (last_tallied_subpops_.size() == 0))
-		{
-			return cached_tally_genome_count_;
-		}
-		else if (p_subpops_to_tally && last_tallied_subpops_.size() && (last_tallied_subpops_ == *p_subpops_to_tally))
-		{
-			return cached_tally_genome_count_;
-		}
-	}
+		return cached_tally_genome_count_;
+	
+	// Any cached tallies across subsets of the subpopulations are suspect now too, since we are re-tallying for a reason
+	for (SubpopTallyCache &subpop_tally : cached_subpop_tallies_)
+		subpop_tally.genome_count_ = 0;
+	
+	// We have a fast case, where we can tally using MutationRuns, and a slow case where we have to tally each
+	// mutation in each Genome; our first order of business is to figure out which case we are using.
+	bool can_tally_runs = true;
+	
+	// To tally using MutationRun, we should be at the point in the generation cycle where the registry is
+	// maintained, so that other Genome objects have been cleared.  Otherwise, the tallies might not add up.
+#ifdef SLIM_WF_ONLY
+	if ((sim_.ModelType() == SLiMModelType::kModelTypeWF) && !child_generation_valid_)
+		can_tally_runs = false;
+#endif	// SLIM_WF_ONLY
 	
-	// Now do the actual tallying, since apparently it is necessary
-	if (p_subpops_to_tally)
+#ifdef SLIMGUI
+	// If we're in SLiMgui, we need to figure out how we're going to handle its refcounts, which are
+	// separate from slim's since the user can select just a subset of subpopulations.
+	bool slimgui_subpop_subset_selected = false;
+	
+	for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
+		if (!subpop_pair.second->gui_selected_)
+			slimgui_subpop_subset_selected = true;
+	
+	// If a subset of subpops is selected, we can't tally using MutationRun, because the MutationRun
+	// refcounts are across all subpopulations.  (We could tally just for slim, but we would be left with
+	// no way to get the sub-tallies for SLiMgui, so there's no point in doing that.)
+	if (slimgui_subpop_subset_selected)
+		can_tally_runs = false;
+#endif
+	
+	// To tally using MutationRun, the refcounts of all active MutationRun objects should add up to the same
+	// total as the total number of Genome objects being tallied across.  Otherwise, something is very wrong.
+#ifdef DEBUG
+	if (can_tally_runs)
 	{
-		// When tallying just a subset of the subpops, we don't update the SLiMgui counts, nor do we update total_genome_count_
-		
-		// first zero out the refcounts in all registered Mutation objects
-		SLiM_ZeroRefcountBlock(mutation_registry_);
-		
-		// then increment the refcounts through all pointers to Mutation in all genomes
-		slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
-		slim_refcount_t total_genome_count = 0;
+		slim_refcount_t total_genome_count = 0, tally_mutrun_ref_count = 0, total_mutrun_count = 0;
+		int64_t operation_id = ++gSLiM_MutationRun_OperationID;
 		
-		for (Subpopulation *subpop : *p_subpops_to_tally)
+		for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
 		{
-			// Particularly for SLiMgui, we need to be able to tally mutation references after the generations have been swapped, i.e.
-			// when the parental generation is active and the child generation is invalid.
+			Subpopulation *subpop = subpop_pair.second;
+			
 			slim_popsize_t subpop_genome_count = subpop->CurrentGenomeCount();
 			std::vector<Genome *> &subpop_genomes = subpop->CurrentGenomes();
 			
@@ -5182,170 +5211,99 @@ slim_refcount_t Population::TallyMutationReferences(std::vector<Subpopulation*>
 				
 				if (!genome.IsNull())
 				{
-					int mutrun_count = genome.mutrun_count_;
-					
-					for (int run_index = 0; run_index < mutrun_count; ++run_index)
-					{
-						MutationRun *mutrun = genome.mutruns_[run_index].get();
-						const MutationIndex *genome_iter = mutrun->begin_pointer_const();
-						const MutationIndex *genome_end_iter = mutrun->end_pointer_const();
-						
-						for (; genome_iter != genome_end_iter; ++genome_iter)
-							++(*(refcount_block_ptr + *genome_iter));
-					}
-					
-					total_genome_count++;	// count only non-null genomes to determine fixation
+					subpop_genomes[i]->TallyGenomeReferences(&tally_mutrun_ref_count, &total_mutrun_count, operation_id);
+					total_genome_count++;
 				}
 			}
 		}
 		
-		// set up the cache info
-		last_tallied_subpops_ = *p_subpops_to_tally;
-		cached_tally_genome_count_ = total_genome_count;
+		int mutrun_count = sim_.TheChromosome().mutrun_count_;
 		
-		return total_genome_count;
+		if (total_genome_count * mutrun_count != tally_mutrun_ref_count)
+			EIDOS_TERMINATION << "ERROR (Population::TallyMutationReferences): (internal error) tally != total genome count." << EidosTerminate();
+		
+		//std::cout << "Total genomes / MutationRuns: " << total_genome_count << " / " << total_mutrun_count << std::endl;
 	}
-	else
+#endif
+	
+	if (can_tally_runs)
 	{
-		// We have a fast case, where we can tally using MutationRuns, and a slow case where we have to tally each
-		// mutation in each Genome; our first order of business is to figure out which case we are using.
-		bool can_tally_runs = true;
+		//	FAST CASE: TALLY MUTATIONRUN OBJECTS AS CHUNKS
+		//
 		
-		// To tally using MutationRun, we should be at the point in the generation cycle where the registry is
-		// maintained, so that other Genome objects have been cleared.  Otherwise, the tallies might not add up.
-#ifdef SLIM_WF_ONLY
-		if ((sim_.ModelType() == SLiMModelType::kModelTypeWF) && !child_generation_valid_)
-			can_tally_runs = false;
-#endif	// SLIM_WF_ONLY
+		// Give the core work to our fast worker method; this is mostly for easier performance monitoring
+		slim_refcount_t total_genome_count = TallyMutationReferences_FAST();
 		
-#ifdef SLIMGUI
-		// If we're in SLiMgui, we need to figure out how we're going to handle its refcounts, which are
-		// separate from slim's since the user can select just a subset of subpopulations.
-		bool slimgui_subpop_subset_selected = false;
+		// set up the cache info
+		cached_tally_genome_count_ = total_genome_count;
 		
-		for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
-			if (!subpop_pair.second->gui_selected_)
-				slimgui_subpop_subset_selected = true;
+		// set up the global genome counts
+		total_genome_count_ = total_genome_count;
 		
-		// If a subset of subpops is selected, we can't tally using MutationRun, because the MutationRun
-		// refcounts are across all subpopulations.  (We could tally just for slim, but we would be left with
-		// no way to get the sub-tallies for SLiMgui, so there's no point in doing that.)
-		if (slimgui_subpop_subset_selected)
-			can_tally_runs = false;
-#endif
+#ifdef SLIMGUI
+		// SLiMgui can use this case if all subpops are selected; in that case, copy refcounts over to SLiMgui's info
+		Mutation *mut_block_ptr = gSLiM_Mutation_Block;
+		slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
+		const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
+		const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
 		
-		// To tally using MutationRun, the refcounts of all active MutationRun objects should add up to the same
-		// total as the total number of Genome objects being tallied across.  Otherwise, something is very wrong.
-#ifdef DEBUG
-		if (can_tally_runs)
+		while (registry_iter != registry_iter_end)
 		{
-			slim_refcount_t total_genome_count = 0, tally_mutrun_ref_count = 0, total_mutrun_count = 0;
-			int64_t operation_id = ++gSLiM_MutationRun_OperationID;
+			MutationIndex mut_index = *registry_iter;
+			slim_refcount_t *refcount_ptr = refcount_block_ptr + mut_index;
+			const Mutation *mutation = mut_block_ptr + mut_index;
 			
-			for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
-			{
-				Subpopulation *subpop = subpop_pair.second;
-				
-				slim_popsize_t subpop_genome_count = subpop->CurrentGenomeCount();
-				std::vector<Genome *> &subpop_genomes = subpop->CurrentGenomes();
-				
-				for (slim_popsize_t i = 0; i < subpop_genome_count; i++)							// child genomes
-				{
-					Genome &genome = *subpop_genomes[i];
-					
-					if (!genome.IsNull())
-					{
-						subpop_genomes[i]->TallyGenomeReferences(&tally_mutrun_ref_count, &total_mutrun_count, operation_id);
-						total_genome_count++;
-					}
-				}
-			}
-			
-			int mutrun_count = sim_.TheChromosome().mutrun_count_;
-			
-			if (total_genome_count * mutrun_count != tally_mutrun_ref_count)
-				EIDOS_TERMINATION << "ERROR (Population::TallyMutationReferences): (internal error) tally != total genome count." << EidosTerminate();
-			
-			//std::cout << "Total genomes / MutationRuns: " << total_genome_count << " / " << total_mutrun_count << std::endl;
+			mutation->gui_reference_count_ = *refcount_ptr;
+			registry_iter++;
 		}
+		
+		gui_total_genome_count_ = total_genome_count;
 #endif
 		
-		if (can_tally_runs)
-		{
-			//	FAST CASE: TALLY MUTATIONRUN OBJECTS AS CHUNKS
-			//
-			
-			// Give the core work to our fast worker method; this is mostly for easier performance monitoring
-			slim_refcount_t total_genome_count = TallyMutationReferences_FAST();
-			
-			// set up the cache info
-			last_tallied_subpops_.clear();
-			cached_tally_genome_count_ = total_genome_count;
-			
-			// set up the global genome counts
-			total_genome_count_ = total_genome_count;
-			
+		return total_genome_count;
+	}
+	else
+	{
+		//	SLOW CASE: TALLY EACH DISTINCT MUTATIONRUN, WITH ITS USE COUNT AMONG THE GENOMES TALLIED
+		//
+		
+		// When tallying the full population, we update SLiMgui counts as well, and we update total_genome_count_
+		slim_refcount_t total_genome_count = 0;
 #ifdef SLIMGUI
-			// SLiMgui can use this case if all subpops are selected; in that case, copy refcounts over to SLiMgui's info
-			Mutation *mut_block_ptr = gSLiM_Mutation_Block;
-			slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
+		slim_refcount_t gui_total_genome_count = 0;
+		Mutation *mut_block_ptr = gSLiM_Mutation_Block;
+#endif
+		
+		// first zero out the refcounts in all registered Mutation objects
+#ifdef SLIMGUI
+		// So, we have two different cases in SLiMgui that are both handled by the slow case here.  One is that all subpops are
+		// selected in SLiMgui; in this case we can just copy the refcounts over after they have been tallied, so we don't
+		// need to zero out the gui tallies here, or tally them separately below.  The other is that only some subpops are
+		// selected in SLiMgui; in that case, we have to go the super-slow route and increment the gui tallies one by one,
+		// so we have to zero them out here.
+		if (slimgui_subpop_subset_selected)
+		{
 			const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
 			const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
 			
 			while (registry_iter != registry_iter_end)
 			{
-				MutationIndex mut_index = *registry_iter;
-				slim_refcount_t *refcount_ptr = refcount_block_ptr + mut_index;
-				const Mutation *mutation = mut_block_ptr + mut_index;
+				MutationIndex mutation_index = *registry_iter;
+				Mutation *mutation = mut_block_ptr + mutation_index;
 				
-				mutation->gui_reference_count_ = *refcount_ptr;
+				mutation->gui_reference_count_ = 0;
 				registry_iter++;
 			}
-			
-			gui_total_genome_count_ = total_genome_count;
-#endif
-			
-			return total_genome_count;
 		}
-		else
-		{
-			//	SLOW CASE: TALLY EACH MUTATION INDIVIDUALLY
-			//
-			
-			// When tallying the full population, we update SLiMgui counts as well, and we update total_genome_count_
-			slim_refcount_t total_genome_count = 0;
-#ifdef SLIMGUI
-			slim_refcount_t gui_total_genome_count = 0;
-			Mutation *mut_block_ptr = gSLiM_Mutation_Block;
 #endif
-			
-			// first zero out the refcounts in all registered Mutation objects
+		SLiM_ZeroRefcountBlock(mutation_registry_);
+		
+		// then increment the refcounts through all pointers to Mutation in all genomes
+		slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
+		
 #ifdef SLIMGUI
-			// So, we have two different cases in SLiMgui that are both handled by the slow case here.  One is that all subpops are
-			// selected in SLiMgui; in this case we can just copy the refcounts over after they have been tallied, so we don't
-			// need to zero out the gui tallies here, or tally them separately below.  The other is that only some subpops are
-			// selected in SLiMgui; in that case, we have to go the super-slow route and increment the gui tallies one by one,
-			// so we have to zero them out here.
-			if (slimgui_subpop_subset_selected)
-			{
-				const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
-				const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
-				
-				while (registry_iter != registry_iter_end)
-				{
-					MutationIndex mutation_index = *registry_iter;
-					Mutation *mutation = mut_block_ptr + mutation_index;
-					
-					mutation->gui_reference_count_ = 0;
-					registry_iter++;
-				}
-			}
-#endif
-			SLiM_ZeroRefcountBlock(mutation_registry_);
-			
-			// then increment the refcounts through all pointers to Mutation in all genomes
-			slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
-			
+		if (slimgui_subpop_subset_selected)
+		{
 			for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
 			{
 				Subpopulation *subpop = subpop_pair.second;
@@ -5355,7 +5313,6 @@ slim_refcount_t Population::TallyMutationReferences(std::vector<Subpopulation*>
 				slim_popsize_t subpop_genome_count = subpop->CurrentGenomeCount();
 				std::vector<Genome *> &subpop_genomes = subpop->CurrentGenomes();
 				
-#ifdef SLIMGUI
 				// When running under SLiMgui, we need to tally up mutation references within the selected subpops, too; note
 				// the else clause here drops outside of the #ifdef to the standard tally code.  Note that this clause is used
 				// only when a subset of subpops in selected in SLiMgui; if all are selected, we can be smarter (below).
@@ -5393,7 +5350,6 @@ slim_refcount_t Population::TallyMutationReferences(std::vector<Subpopulation*>
 					}
 				}
 				else
-#endif
 				{
 					for (slim_popsize_t i = 0; i < subpop_genome_count; i++)							// child genomes
 					{
@@ -5440,39 +5396,50 @@ slim_refcount_t Population::TallyMutationReferences(std::vector<Subpopulation*>
 					}
 				}
 			}
+		}
+		else
+#endif
+		{
+			// Unless SLiMgui needs a separate tally for its selected subpops, we can tally each distinct MutationRun just once
+			static std::vector<Subpopulation*> subpops_to_tally;	// using and clearing a static prevents allocation thrash
 			
-			// set up the cache info
-			last_tallied_subpops_.clear();
-			cached_tally_genome_count_ = total_genome_count;
-			
-			// set up the global genome counts
-			total_genome_count_ = total_genome_count;
+			for (const std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : subpops_)
+				subpops_to_tally.emplace_back(subpop_pair.second);
 			
+			total_genome_count = TallyMutationRunReferences(subpops_to_tally, refcount_block_ptr);
+			subpops_to_tally.clear();
+		}
+		
+		// set up the cache info
+		cached_tally_genome_count_ = total_genome_count;
+		
+		// set up the global genome counts
+		total_genome_count_ = total_genome_count;
+		
 #ifdef SLIMGUI
-			// If all subpops are selected in SLiMgui, we now copy the refcounts over, as in the fast case
-			if (!slimgui_subpop_subset_selected)
+		// If all subpops are selected in SLiMgui, we now copy the refcounts over, as in the fast case
+		if (!slimgui_subpop_subset_selected)
+		{
+			const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
+			const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
+			
+			while (registry_iter != registry_iter_end)
 			{
-				const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
-				const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
-				
-				while (registry_iter != registry_iter_end)
-				{
-					MutationIndex mut_index = *registry_iter;
-					slim_refcount_t *refcount_ptr = refcount_block_ptr + mut_index;
-					const Mutation *mutation = mut_block_ptr + mut_index;
-					
-					mutation->gui_reference_count_ = *refcount_ptr;
-					registry_iter++;
-				}
+				MutationIndex mut_index = *registry_iter;
+				slim_refcount_t *refcount_ptr = refcount_block_ptr + mut_index;
+				const Mutation *mutation = mut_block_ptr + mut_index;
 				
-				gui_total_genome_count = total_genome_count;
+				mutation->gui_reference_count_ = *refcount_ptr;
+				registry_iter++;
 			}
 			
-			gui_total_genome_count_ = gui_total_genome_count;
-#endif
-			
-			return total_genome_count;
+			gui_total_genome_count = total_genome_count;
 		}
+		
+		gui_total_genome_count_ = gui_total_genome_count;
+#endif
+		
+		return total_genome_count;
 	}
 }
 
@@ -5522,6 +5489,138 @@ slim_refcount_t Population::TallyMutationReferences_FAST(void)
 	return total_genome_count;
 }
 
+// Tally mutation references into p_refcount_block (which must have been zeroed for all registered mutations) across the non-null genomes of
+// the given subpopulations, and return the number of genomes tallied.  This works even when MutationRun use counts do not reflect the genomes
+// being tallied (when tallying a subset of subpopulations, or outside of the point in the generation cycle where TallyMutationReferences_FAST()
+// can be used): we count the uses of each distinct run among the genomes tallied, marking runs with operation IDs that index into run_uses
+// starting from base_operation_id, and then tally the mutations in each distinct run just once, weighted by its use count.
+slim_refcount_t Population::TallyMutationRunReferences(const std::vector<Subpopulation*> &p_subpops_to_tally, slim_refcount_t *p_refcount_block)
+{
+	static std::vector<MutationRun *> runs;				// using and clearing statics prevents allocation thrash
+	static std::vector<slim_refcount_t> run_uses;
+	int64_t base_operation_id = gSLiM_MutationRun_OperationID + 1;
+	slim_refcount_t total_genome_count = 0;
+	
+	for (Subpopulation *subpop : p_subpops_to_tally)
+	{
+		// Particularly for SLiMgui, we need to be able to tally mutation references after the generations have been swapped, i.e.
+		// when the parental generation is active and the child generation is invalid.
+		slim_popsize_t subpop_genome_count = subpop->CurrentGenomeCount();
+		std::vector<Genome *> &subpop_genomes = subpop->CurrentGenomes();
+		
+		for (slim_popsize_t i = 0; i < subpop_genome_count; i++)
+		{
+			Genome &genome = *subpop_genomes[i];
+			
+			if (!genome.IsNull())
+			{
+				int mutrun_count = genome.mutrun_count_;
+				
+				for (int run_index = 0; run_index < mutrun_count; ++run_index)
+				{
+					MutationRun *mutrun = genome.mutruns_[run_index].get();
+					int64_t run_cache_index = mutrun->operation_id_ - base_operation_id;
+					
+					if (run_cache_index < 0)
+					{
+						mutrun->operation_id_ = ++gSLiM_MutationRun_OperationID;
+						runs.emplace_back(mutrun);
+						run_uses.emplace_back(1);
+					}
+					else
+					{
+						run_uses[run_cache_index]++;
+					}
+				}
+				
+				total_genome_count++;	// count only non-null genomes to determine fixation
+			}
+		}
+	}
+	
+	size_t run_count = runs.size();
+	
+	for (size_t run_cache_index = 0; run_cache_index < run_count; ++run_cache_index)
+	{
+		MutationRun *mutrun = runs[run_cache_index];
+		slim_refcount_t use_count = run_uses[run_cache_index];
+		const MutationIndex *genome_iter = mutrun->begin_pointer_const();
+		const MutationIndex *genome_end_iter = mutrun->end_pointer_const();
+		
+		while (genome_iter != genome_end_iter)
+			*(p_refcount_block + (*genome_iter++)) += use_count;
+	}
+	
+	runs.clear();
+	run_uses.clear();
+	
+	return total_genome_count;
+}
+
+slim_refcount_t Population::TallySubpopMutationReferences(const std::vector<Subpopulation*> &p_subpops_to_tally, const slim_refcount_t **p_refcount_block)
+{
+	// If we have been asked to tally across all of the subpops, that is the whole-population tally, which may well be cached already.
+	// Rather than doing an equality test, we'll just assume that if there are N subpops and we've been asked to tally across N subpops,
+	// we have been asked to tally across the whole population.  Hard to imagine a rational case that would violate that assumption.
+	if (p_subpops_to_tally.size() == subpops_.size())
+	{
+		*p_refcount_block = gSLiM_Mutation_Refcounts;
+		return TallyMutationReferences(false);
+	}
+	
+	// Look for a cached tally for this set of subpops; if it is still valid we can use it, otherwise we can re-tally into its buffer
+	SubpopTallyCache *subpop_tally = nullptr;
+	
+	for (SubpopTallyCache &cached_subpop_tally : cached_subpop_tallies_)
+	{
+		if (cached_subpop_tally.subpops_ == p_subpops_to_tally)
+		{
+			subpop_tally = &cached_subpop_tally;
+			break;
+		}
+	}
+	
+	if (subpop_tally && (subpop_tally->genome_count_ != 0))
+	{
+		*p_refcount_block = subpop_tally->refcounts_.data();
+		return subpop_tally->genome_count_;
+	}
+	
+	if (!subpop_tally)
+	{
+		// We keep a handful of cached tallies, since each one is as large as the mutation block; beyond that, entries are replaced in turn
+		if (cached_subpop_tallies_.size() < 4)
+		{
+			cached_subpop_tallies_.emplace_back();
+			subpop_tally = &cached_subpop_tallies_.back();
+		}
+		else
+		{
+			subpop_tally = &cached_subpop_tallies_[cached_subpop_tallies_replace_index_];
+			cached_subpop_tallies_replace_index_ = (cached_subpop_tallies_replace_index_ + 1) % cached_subpop_tallies_.size();
+		}
+		
+		subpop_tally->subpops_ = p_subpops_to_tally;
+	}
+	
+	// Zero the refcounts for all registered mutations, and tally
+	std::vector<slim_refcount_t> &refcounts = subpop_tally->refcounts_;
+	
+	if (refcounts.size() < (size_t)(gSLiM_Mutation_Block_LastUsedIndex + 1))
+		refcounts.resize(gSLiM_Mutation_Block_LastUsedIndex + 1);
+	
+	const MutationIndex *registry_iter = mutation_registry_.begin_pointer_const();
+	const MutationIndex *registry_iter_end = mutation_registry_.end_pointer_const();
+	
+	while (registry_iter != registry_iter_end)
+		refcounts[*registry_iter++] = 0;
+	
+	subpop_tally->genome_count_ = TallyMutationRunReferences(p_subpops_to_tally, refcounts.data());
+	
+	*p_refcount_block = refcounts.data();
+	return subpop_tally->genome_count_;
+}
+
 // handle negative fixation (remove from the registry) and positive fixation (convert to Substitution), using reference counts from TallyMutationReferences()
 // TallyMutationReferences() must have cached tallies across the whole population before this is called, or it will malfunction!
 void Population::RemoveAllFixedMutations(void)
@@ -5620,49 +5719,14 @@ void Population::RemoveAllFixedMutations(void)
 	}
 	
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	// remove fixed mutations from MutationType registries as well, if we've got any; this is simpler since
-	// the main registry is in charge of all bookkeeping, substitution, removal, etc.
-	if (keeping_muttype_registries_ && removed_mutation_accumulator.size())
+	// remove removed mutations from MutationType registries as well; this is simpler since the main registry is in charge of all
+	// bookkeeping, substitution, removal, etc., and each removal is O(1) since mutations know their index in their muttype's registry
+	for (int i = 0; i < removed_mutation_accumulator.size(); i++)
 	{
-		const std::map<slim_objectid_t,MutationType*> &mut_types = sim_.MutationTypes();
+		MutationIndex mutation_index = removed_mutation_accumulator[i];
+		Mutation *mutation = mut_block_ptr + mutation_index;
 		
-		for (auto muttype_iter : mut_types)
-		{
-			MutationType *muttype = muttype_iter.second;
-			
-			if (muttype->keeping_muttype_registry_)
-			{
-				MutationRun &registry = muttype->muttype_registry_;
-				int registry_length = registry.size();
-				
-				for (int i = 0; i < registry_length; ++i)
-				{
-					MutationIndex mutation_index = registry[i];
-					Mutation *mutation = mut_block_ptr + mutation_index;
-					slim_refcount_t reference_count = *(refcount_block_ptr + mutation_index);
-					
-					if ((reference_count <= 0) || ((reference_count == total_genome_count_) && (mutation->mutation_type_ptr_->convert_to_substitution_)))
-					{
-						// We have an unreferenced mutation object, so we want to remove it quickly
-						if (i == registry_length - 1)
-						{
-							registry.pop_back();
-							
-							--registry_length;
-						}
-						else
-						{
-							MutationIndex last_mutation = registry[registry_length - 1];
-							registry[i] = last_mutation;
-							registry.pop_back();
-							
-							--registry_length;
-							--i;	// revisit this index
-						}
-					}
-				}
-			}
-		}
+		mutation->mutation_type_ptr_->RemoveFromMuttypeRegistry(mutation_index);
 	}
 #endif
 	
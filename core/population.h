@@ -68,10 +68,6 @@ public:
 	SLiMSim &sim_;											// We have a reference back to our simulation
 	
 	MutationRun mutation_registry_;							// OWNED POINTERS: a registry of all mutations that have been added to this population
-#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	bool keeping_muttype_registries_ = false;				// if true, at least one MutationType is also keeping its own registry
-	bool any_muttype_call_count_used_ = false;				// if true, a muttype's muttype_registry_call_count_ has been incremented
-#endif
 	
 	slim_refcount_t total_genome_count_ = 0;				// the number of modeled genomes in the population; a fixed mutation has this frequency
 #ifdef SLIMGUI
@@ -79,9 +75,20 @@ public:
 #endif
 	
 	// Cache info for TallyMutationReferences(); see that function
-	std::vector<Subpopulation*> last_tallied_subpops_;		// NOT OWNED POINTERS
 	slim_refcount_t cached_tally_genome_count_ = 0;
 	
+	// Cached tallies across subsets of the subpopulations; see TallySubpopMutationReferences().  These are kept apart from the
+	// whole-population tallies in gSLiM_Mutation_Refcounts, so that queries alternating between different sets of subpopulations,
+	// or between a subset and the whole population, do not need to re-tally each time.
+	typedef struct {
+		std::vector<Subpopulation*> subpops_;				// NOT OWNED POINTERS; the subpopulations tallied, in the order requested
+		slim_refcount_t genome_count_;						// the number of non-null genomes tallied; 0 if the cached tally is invalid
+		std::vector<slim_refcount_t> refcounts_;			// refcounts indexed by MutationIndex, parallel to gSLiM_Mutation_Refcounts
+	} SubpopTallyCache;
+	
+	std::vector<SubpopTallyCache> cached_subpop_tallies_;
+	size_t cached_subpop_tallies_replace_index_ = 0;		// the next cache entry to be replaced when all are in use
+	
 	std::vector<Substitution*> substitutions_;				// OWNED POINTERS: Substitution objects for all fixed mutations
 	std::unordered_multimap<slim_position_t, Substitution*> treeseq_substitutions_map_;	// TREE SEQUENCE RECORDING; keeps all fixed mutations, hashed by position
 
@@ -132,6 +139,7 @@ public:
 	
 	// generate a child genome from a single parental genome, without recombination or gene conversion, but with mutation
 	void DoClonalMutation(Subpopulation *p_mutorigin_subpop, Genome &p_child_genome, Genome &p_parent_genome, IndividualSex p_child_sex, std::vector<SLiMEidosBlock*> *p_mutation_callbacks);
+	inline void CopyClonalGenome(Genome &p_child_genome, Genome &p_parent_genome);	// for clonal gametes with no new mutations
 	
 	// An internal method that validates cached fitness values kept by Mutation objects
 	void ValidateMutationFitnessCaches(void);
@@ -150,8 +158,21 @@ public:
 	void MaintainRegistry(void);
 	
 	// count the total number of times that each Mutation in the registry is referenced by a population, and set total_genome_count_ to the maximum possible number of references (i.e. fixation)
-	slim_refcount_t TallyMutationReferences(std::vector<Subpopulation*> *p_subpops_to_tally, bool p_force_recache);
+	slim_refcount_t TallyMutationReferences(bool p_force_recache);
 	slim_refcount_t TallyMutationReferences_FAST(void);
+	slim_refcount_t TallyMutationRunReferences(const std::vector<Subpopulation*> &p_subpops_to_tally, slim_refcount_t *p_refcount_block);
+	
+	// count references across a subset of the subpopulations, into a cached block of refcounts returned in p_refcount_block; does not affect gSLiM_Mutation_Refcounts
+	slim_refcount_t TallySubpopMutationReferences(const std::vector<Subpopulation*> &p_subpops_to_tally, const slim_refcount_t **p_refcount_block);
+	
+	// mark all cached tallies as invalid; this should be called whenever genomes change in ways that affect mutation counts
+	inline void InvalidateMutationReferencesCache(void)
+	{
+		cached_tally_genome_count_ = 0;
+		
+		for (SubpopTallyCache &subpop_tally : cached_subpop_tallies_)
+			subpop_tally.genome_count_ = 0;
+	}
 	
 	// handle negative fixation (remove from the registry) and positive fixation (convert to Substitution), using reference counts from TallyMutationReferences()
 	void RemoveAllFixedMutations(void);
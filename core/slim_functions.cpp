@@ -25,6 +25,7 @@
 
 #include <string>
 #include <vector>
+#include <cstring>
 
 
 const std::vector<EidosFunctionSignature_CSP> *SLiMSim::SLiMFunctionSignatures(void)
@@ -415,20 +416,27 @@ static void CountNucleotides(EidosValue *sequence_value, int64_t *total_ACGT, co
 		}
 		else // sequence_type == EidosValueType::kValueString
 		{
-			uint8_t *nuc_lookup = NucleotideArray::NucleotideCharToIntLookup();
 			const std::string &string_ref = sequence_value->IsSingleton() ? ((EidosValue_String_singleton *)sequence_value)->StringValue() : (*sequence_value->StringVector())[0];
 			std::size_t length = string_ref.length();
+			const uint8_t *char_ptr = (const uint8_t *)string_ref.data();
+			
+			// Tally a histogram of all characters without branching, then check that nothing but A/C/G/T was seen
+			int64_t char_counts[256];
+			
+			memset(char_counts, 0, sizeof(char_counts));
 			
 			for (std::size_t i = 0; i < length; ++i)
-			{
-				char nuc_char = string_ref[i];
-				uint8_t nuc_index = nuc_lookup[(int)(nuc_char)];
-				
-				if (nuc_index > 3)
-					EIDOS_TERMINATION << "ERROR (SLiM_ExecuteFunction_" << function_name << "): function " << function_name << "() requires string sequence values to be 'A', 'C', 'G', or 'T'." << EidosTerminate(nullptr);
-				
-				total_ACGT[nuc_index]++;
-			}
+				char_counts[char_ptr[i]]++;
+			
+			int64_t count_A = char_counts[(int)'A'], count_C = char_counts[(int)'C'], count_G = char_counts[(int)'G'], count_T = char_counts[(int)'T'];
+			
+			if (count_A + count_C + count_G + count_T != (int64_t)length)
+				EIDOS_TERMINATION << "ERROR (SLiM_ExecuteFunction_" << function_name << "): function " << function_name << "() requires string sequence values to be 'A', 'C', 'G', or 'T'." << EidosTerminate(nullptr);
+			
+			total_ACGT[0] += count_A;
+			total_ACGT[1] += count_C;
+			total_ACGT[2] += count_G;
+			total_ACGT[3] += count_T;
 		}
 	}
 	else
@@ -437,16 +445,19 @@ static void CountNucleotides(EidosValue *sequence_value, int64_t *total_ACGT, co
 		if (sequence_type == EidosValueType::kValueInt)
 		{
 			const int64_t *int_data = sequence_value->IntVector()->data();
+			uint64_t invalid = 0;
 			
+			// values < 0 become > 3 when cast; we check validity once at the end, masking to stay in bounds until then
 			for (int value_index = 0; value_index < sequence_count; ++value_index)
 			{
 				uint64_t nuc = int_data[value_index];
 				
-				if (nuc > 3)
-					EIDOS_TERMINATION << "ERROR (SLiM_ExecuteFunction_" << function_name << "): function " << function_name << "() requires integer sequence values to be in [0,3]." << EidosTerminate(nullptr);
-				
-				total_ACGT[nuc]++;
+				invalid |= nuc;
+				total_ACGT[nuc & 0x03]++;
 			}
+			
+			if (invalid > 3)
+				EIDOS_TERMINATION << "ERROR (SLiM_ExecuteFunction_" << function_name << "): function " << function_name << "() requires integer sequence values to be in [0,3]." << EidosTerminate(nullptr);
 		}
 		else // sequence_type == EidosValueType::kValueString
 		{
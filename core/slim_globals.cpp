@@ -27,6 +27,7 @@
 
 #include <string>
 #include <vector>
+#include <cstring>
 
 
 EidosValue_String_SP gStaticEidosValue_StringA;
@@ -533,36 +534,66 @@ std::ostream& operator<<(std::ostream& p_out, IndividualSex p_sex)
 #pragma mark NucleotideArray
 #pragma mark -
 
-NucleotideArray::NucleotideArray(std::size_t p_length, const int64_t *p_int_buffer) : length_(p_length)
+// Pack nucleotides, obtained from p_nuc_at_index(index) as 0..3 (or > 3 if invalid), into p_buffer.  Full 32-nucleotide
+// chunks are packed without per-nucleotide bounds checks, and validity is checked once per chunk by OR-ing the values;
+// returns false if any value was invalid.
+template <typename F>
+static bool _PackNucleotides(uint64_t *p_buffer, std::size_t p_length, F p_nuc_at_index)
 {
-	buffer_ = (uint64_t *)malloc(((length_ + 31) / 32) * sizeof(uint64_t));
-	
-	// Eat 32 nucleotides at a time if we can
-	std::size_t index = 0, buf_index = 0;
+	std::size_t full_chunks = p_length / 32;
+	std::size_t index = 0;
 	
-	for ( ; index < length_; index += 32)
+	for (std::size_t buf_index = 0; buf_index < full_chunks; ++buf_index)
 	{
-		uint64_t accumulator = 0;
+		uint64_t accumulator = 0, invalid = 0;
 		
-		for (std::size_t i = 0; i < 32; )
+		for (int i = 0; i < 32; ++i)
 		{
-			uint64_t nuc = (uint64_t)p_int_buffer[index + i];
-			
-			if (nuc > 3)	// values < 0 will becomes > 3 after casting above
-			{
-				free(buffer_);
-				buffer_ = nullptr;
-				
-				throw std::out_of_range("integer nucleotide value out of range");
-			}
+			uint64_t nuc = p_nuc_at_index(index++);
 			
+			invalid |= nuc;
 			accumulator |= (nuc << (i * 2));
+		}
+		
+		if (invalid > 3)
+			return false;
+		
+		p_buffer[buf_index] = accumulator;
+	}
+	
+	// Then the final partial chunk, if any
+	if (index < p_length)
+	{
+		uint64_t accumulator = 0, invalid = 0;
+		
+		for (int i = 0; index < p_length; ++i)
+		{
+			uint64_t nuc = p_nuc_at_index(index++);
 			
-			if (index + ++i == length_)
-				break;
+			invalid |= nuc;
+			accumulator |= (nuc << (i * 2));
 		}
 		
-		buffer_[buf_index++] = accumulator;
+		if (invalid > 3)
+			return false;
+		
+		p_buffer[full_chunks] = accumulator;
+	}
+	
+	return true;
+}
+
+NucleotideArray::NucleotideArray(std::size_t p_length, const int64_t *p_int_buffer) : length_(p_length)
+{
+	buffer_ = (uint64_t *)malloc(((length_ + 31) / 32) * sizeof(uint64_t));
+	
+	// values < 0 will become > 3 after casting
+	if (!_PackNucleotides(buffer_, length_, [p_int_buffer](std::size_t index) { return (uint64_t)p_int_buffer[index]; }))
+	{
+		free(buffer_);
+		buffer_ = nullptr;
+		
+		throw std::out_of_range("integer nucleotide value out of range");
 	}
 }
 
@@ -587,78 +618,173 @@ uint8_t *NucleotideArray::NucleotideCharToIntLookup(void)
 	return nuc_lookup;
 }
 
+const char *NucleotideArray::NucleotideByteToCharsLookup(void)
+{
+	// set up a lookup table for speed; each byte of a chunk holds four nucleotides, least-significant bits first
+	static char *byte_lookup = nullptr;
+	
+	if (!byte_lookup)
+	{
+		static const char nuc_chars[4] = {'A', 'C', 'G', 'T'};
+		
+		byte_lookup = (char *)malloc(256 * 4 * sizeof(char));
+		
+		for (int i = 0; i < 256; ++i)
+		{
+			byte_lookup[i * 4] = nuc_chars[i & 0x03];
+			byte_lookup[i * 4 + 1] = nuc_chars[(i >> 2) & 0x03];
+			byte_lookup[i * 4 + 2] = nuc_chars[(i >> 4) & 0x03];
+			byte_lookup[i * 4 + 3] = nuc_chars[(i >> 6) & 0x03];
+		}
+	}
+	
+	return byte_lookup;
+}
+
 NucleotideArray::NucleotideArray(std::size_t p_length, const char *p_char_buffer) : length_(p_length)
 {
 	uint8_t *nuc_lookup = NucleotideArray::NucleotideCharToIntLookup();
 	
 	buffer_ = (uint64_t *)malloc(((length_ + 31) / 32) * sizeof(uint64_t));
 	
-	// Eat 32 nucleotides at a time if we can
-	std::size_t index = 0, buf_index = 0;
-	
-	for ( ; index < length_; index += 32)
+	if (!_PackNucleotides(buffer_, length_, [p_char_buffer, nuc_lookup](std::size_t index) { return (uint64_t)nuc_lookup[(uint8_t)(p_char_buffer[index])]; }))
 	{
-		uint64_t accumulator = 0;
-		
-		for (std::size_t i = 0; i < 32; )
-		{
-			char nuc_char = p_char_buffer[index + i];
-			uint64_t nuc = nuc_lookup[(int)(nuc_char)];
-			
-			if (nuc > 3)
-			{
-				free(buffer_);
-				buffer_ = nullptr;
-				
-				throw std::out_of_range("char nucleotide value out of range");
-			}
-			
-			accumulator |= (nuc << (i * 2));
-			
-			if (index + ++i == length_)
-				break;
-		}
+		free(buffer_);
+		buffer_ = nullptr;
 		
-		buffer_[buf_index++] = accumulator;
+		throw std::out_of_range("char nucleotide value out of range");
 	}
 }
 
 NucleotideArray::NucleotideArray(std::size_t p_length, const std::vector<std::string> &p_string_vector) : length_(p_length)
 {
+	uint8_t *nuc_lookup = NucleotideArray::NucleotideCharToIntLookup();
+	
 	buffer_ = (uint64_t *)malloc(((length_ + 31) / 32) * sizeof(uint64_t));
 	
-	// Eat 32 nucleotides at a time if we can
-	std::size_t index = 0, buf_index = 0;
+	if (!_PackNucleotides(buffer_, length_, [&p_string_vector, nuc_lookup](std::size_t index) {
+		const std::string &nuc_string = p_string_vector[index];
+		return (uint64_t)((nuc_string.length() == 1) ? nuc_lookup[(uint8_t)(nuc_string[0])] : 4);
+	}))
+	{
+		free(buffer_);
+		buffer_ = nullptr;
+		
+		throw std::out_of_range("string nucleotide value out of range");
+	}
+}
+
+NucleotideArray::NucleotideArray(std::istream &p_fasta_stream, std::size_t p_length_hint) : length_(0)
+{
+	uint8_t *nuc_lookup = NucleotideArray::NucleotideCharToIntLookup();
+	std::size_t capacity_chunks = std::max((p_length_hint + 31) / 32, (std::size_t)1024);
+	std::size_t chunk_index = 0;
+	uint64_t accumulator = 0;
+	int accumulator_count = 0;
+	
+	buffer_ = (uint64_t *)malloc(capacity_chunks * sizeof(uint64_t));
+	
+	// Parse state: whether we are at the start of a line, skipping the remainder of a line, or have begun the sequence
+	bool at_line_start = true, skipping_line = false, started_sequence = false, finished = false;
+	const std::size_t block_size = 1024 * 1024;
+	std::vector<char> block(block_size);
 	
-	for ( ; index < length_; index += 32)
+	while (!finished && p_fasta_stream)
 	{
-		uint64_t accumulator = 0;
+		p_fasta_stream.read(block.data(), block_size);
 		
-		for (std::size_t i = 0; i < 32; )
+		std::size_t block_count = (std::size_t)p_fasta_stream.gcount();
+		const char *block_ptr = block.data();
+		
+		for (std::size_t block_index = 0; block_index < block_count; ++block_index)
 		{
-			const std::string &nuc_string = p_string_vector[index + i];
-			uint64_t nuc;
+			char nuc_char = block_ptr[block_index];
+			
+			if (at_line_start)
+			{
+				// skippable lines are blank or start with a '>' or ';'; we skip over them if they're at the start of the
+				// file, and once we start a sequence they terminate the sequence
+				if ((nuc_char == '\n') || (nuc_char == '\r') || (nuc_char == '>') || (nuc_char == ';'))
+				{
+					if (started_sequence)
+					{
+						finished = true;
+						break;
+					}
+					
+					if (nuc_char != '\n')
+					{
+						at_line_start = false;
+						skipping_line = true;
+					}
+					continue;
+				}
+				
+				at_line_start = false;
+				skipping_line = false;
+				started_sequence = true;
+			}
 			
-			if (nuc_string == gStr_A) nuc = 0;
-			else if (nuc_string == gStr_C) nuc = 1;
-			else if (nuc_string == gStr_G) nuc = 2;
-			else if (nuc_string == gStr_T) nuc = 3;
-			else
+			if (nuc_char == '\n')
+			{
+				at_line_start = true;
+				continue;
+			}
+			
+			if (skipping_line || (nuc_char == '\r'))
+				continue;
+			
+			uint64_t nuc = nuc_lookup[(uint8_t)nuc_char];
+			
+			if (nuc > 3)
 			{
 				free(buffer_);
 				buffer_ = nullptr;
 				
-				throw std::out_of_range("string nucleotide value out of range");
+				throw std::out_of_range("char nucleotide value out of range");
 			}
 			
-			accumulator |= (nuc << (i * 2));
+			accumulator |= (nuc << (accumulator_count * 2));
 			
-			if (index + ++i == length_)
-				break;
+			if (++accumulator_count == 32)
+			{
+				if (chunk_index == capacity_chunks)
+				{
+					capacity_chunks *= 2;
+					buffer_ = (uint64_t *)realloc(buffer_, capacity_chunks * sizeof(uint64_t));
+				}
+				
+				buffer_[chunk_index++] = accumulator;
+				accumulator = 0;
+				accumulator_count = 0;
+			}
+		}
+	}
+	
+	if (p_fasta_stream.bad())
+	{
+		free(buffer_);
+		buffer_ = nullptr;
+		
+		throw std::runtime_error("stream error reading FASTA sequence");
+	}
+	
+	// Store the final partial chunk, and trim our allocation to fit
+	if (accumulator_count)
+	{
+		if (chunk_index == capacity_chunks)
+		{
+			capacity_chunks++;
+			buffer_ = (uint64_t *)realloc(buffer_, capacity_chunks * sizeof(uint64_t));
 		}
 		
-		buffer_[buf_index++] = accumulator;
+		buffer_[chunk_index++] = accumulator;
 	}
+	
+	length_ = (chunk_index - (accumulator_count ? 1 : 0)) * 32 + accumulator_count;
+	
+	if (chunk_index < capacity_chunks)
+		buffer_ = (uint64_t *)realloc(buffer_, std::max(chunk_index, (std::size_t)1) * sizeof(uint64_t));
 }
 
 void NucleotideArray::SetNucleotideAtIndex(std::size_t p_index, uint64_t p_nuc)
@@ -674,6 +800,35 @@ void NucleotideArray::SetNucleotideAtIndex(std::size_t p_index, uint64_t p_nuc)
 	chunk = (chunk & ~mask) | nucbits;
 }
 
+// A sequential reader over packed nucleotides, used by the bulk conversions below; it shifts through one uint64_t chunk
+// at a time, rather than doing the division and modulo of NucleotideAtIndex() for every nucleotide
+class _NucleotideReader
+{
+private:
+	const uint64_t *chunk_ptr_;
+	uint64_t chunk_;
+	int remaining_;
+	
+public:
+	_NucleotideReader(const uint64_t *p_buffer, std::size_t p_start) : chunk_ptr_(p_buffer + p_start / 32), chunk_(*chunk_ptr_ >> ((p_start % 32) * 2)), remaining_(32 - (int)(p_start % 32)) {}
+	
+	inline int NextNucleotide(void)
+	{
+		if (remaining_ == 0)
+		{
+			chunk_ = *(++chunk_ptr_);
+			remaining_ = 32;
+		}
+		
+		int nuc = (int)(chunk_ & 0x03);
+		
+		chunk_ >>= 2;
+		remaining_--;
+		
+		return nuc;
+	}
+};
+
 EidosValue_SP NucleotideArray::NucleotidesAsIntegerVector(int64_t start, int64_t end)
 {
 	int64_t length = end - start + 1;
@@ -692,9 +847,11 @@ EidosValue_SP NucleotideArray::NucleotidesAsIntegerVector(int64_t start, int64_t
 	{
 		// return a vector of integers, 3 0 3 0
 		EidosValue_Int_vector *int_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Int_vector())->resize_no_initialize((int)length);
+		int64_t *int_data = int_result->data();
+		_NucleotideReader reader(buffer_, start);
 		
 		for (int value_index = 0; value_index < length; ++value_index)
-			int_result->set_int_no_check(NucleotideAtIndex(start + value_index), value_index);
+			int_data[value_index] = reader.NextNucleotide();
 		
 		return EidosValue_SP(int_result);
 	}
@@ -724,17 +881,17 @@ EidosValue_SP NucleotideArray::NucleotidesAsCodonVector(int64_t start, int64_t e
 			EIDOS_TERMINATION << "ERROR (NucleotideArray::NucleotidesAsCodonVector): to obtain codons, the requested sequence length must be a multiple of 3." << EidosTerminate();
 		
 		EidosValue_Int_vector *int_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Int_vector())->resize_no_initialize((int)length_3);
+		int64_t *int_data = int_result->data();
+		_NucleotideReader reader(buffer_, start);
 		
 		for (int64_t value_index = 0; value_index < length_3; ++value_index)
 		{
-			int64_t codon_base = start + value_index * 3;
-			
-			int nuc1 = NucleotideAtIndex(codon_base);
-			int nuc2 = NucleotideAtIndex(codon_base + 1);
-			int nuc3 = NucleotideAtIndex(codon_base + 2);
+			int nuc1 = reader.NextNucleotide();
+			int nuc2 = reader.NextNucleotide();
+			int nuc3 = reader.NextNucleotide();
 			int codon = nuc1 * 16 + nuc2 * 4 + nuc3;	// 0..63
 			
-			int_result->set_int_no_check(codon, value_index);
+			int_data[value_index] = codon;
 		}
 		
 		return EidosValue_SP(int_result);
@@ -759,18 +916,11 @@ EidosValue_SP NucleotideArray::NucleotidesAsStringVector(int64_t start, int64_t
 	{
 		// return a vector of one-character strings, "T" "A" "T" "A"
 		EidosValue_String_vector *string_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_String_vector())->Reserve((int)length);
+		const std::string *nuc_strings[4] = {&gStr_A, &gStr_C, &gStr_G, &gStr_T};
+		_NucleotideReader reader(buffer_, start);
 		
 		for (int value_index = 0; value_index < length; ++value_index)
-		{
-			switch (NucleotideAtIndex(start + value_index))
-			{
-				case 0:		string_result->PushString(gStr_A); break;
-				case 1:		string_result->PushString(gStr_C); break;
-				case 2:		string_result->PushString(gStr_G); break;
-				case 3:		string_result->PushString(gStr_T); break;
-				default:	string_result->PushString("*"); break;		// should never happen
-			}
-		}
+			string_result->PushString(*nuc_strings[reader.NextNucleotide()]);
 		
 		return EidosValue_SP(string_result);
 	}
@@ -795,7 +945,6 @@ EidosValue_SP NucleotideArray::NucleotidesAsStringSingleton(int64_t start, int64
 	else
 	{
 		// return a singleton string for the whole sequence, "TATA"; we munge the std::string inside the EidosValue to avoid memory copying, very naughty
-		static const char nuc_chars[4] = {'A', 'C', 'G', 'T'};
 		EidosValue_String_singleton *string_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_String_singleton(""));
 		std::string &nuc_string = string_result->StringValue_Mutable();
 		
@@ -803,8 +952,7 @@ EidosValue_SP NucleotideArray::NucleotidesAsStringSingleton(int64_t start, int64
 		
 		char *nuc_string_ptr = &nuc_string[0];	// data() returns a const pointer, but this is safe in C++11 and later
 		
-		for (int value_index = 0; value_index < length; ++value_index)
-			nuc_string_ptr[value_index] = nuc_chars[NucleotideAtIndex(start + value_index)];
+		WriteNucleotidesToBuffer(nuc_string_ptr, start, end);
 		
 		return EidosValue_SP(string_result);
 	}
@@ -813,27 +961,55 @@ EidosValue_SP NucleotideArray::NucleotidesAsStringSingleton(int64_t start, int64
 }
 
 void NucleotideArray::WriteNucleotidesToBuffer(char *buffer) const
+{
+	if (length_ > 0)
+		WriteNucleotidesToBuffer(buffer, 0, length_ - 1);
+}
+
+void NucleotideArray::WriteNucleotidesToBuffer(char *buffer, std::size_t p_start, std::size_t p_end) const
 {
 	static const char nuc_chars[4] = {'A', 'C', 'G', 'T'};
+	const char *byte_lookup = NucleotideByteToCharsLookup();
+	std::size_t index = p_start;
+	
+	// Emit nucleotides singly until we are aligned to a chunk boundary
+	while ((index <= p_end) && (index % 32))
+		*(buffer++) = nuc_chars[NucleotideAtIndex(index++)];
+	
+	// Then decode whole chunks, four nucleotides (one byte) at a time
+	while (index + 31 <= p_end)
+	{
+		uint64_t chunk = buffer_[index / 32];
+		
+		for (int byte_index = 0; byte_index < 8; ++byte_index)
+		{
+			memcpy(buffer, byte_lookup + (chunk & 0xFF) * 4, 4);
+			chunk >>= 8;
+			buffer += 4;
+		}
+		
+		index += 32;
+	}
 	
-	for (std::size_t index = 0; index < length_; ++index)
-		buffer[index] = nuc_chars[NucleotideAtIndex(index)];
+	// Then emit any remaining nucleotides singly
+	while (index <= p_end)
+		*(buffer++) = nuc_chars[NucleotideAtIndex(index++)];
 }
 
 void NucleotideArray::ReadNucleotidesFromBuffer(char *buffer)
 {
-	for (std::size_t index = 0; index < length_; ++index)
+	uint8_t *nuc_lookup = NucleotideArray::NucleotideCharToIntLookup();
+	
+	if (!_PackNucleotides(buffer_, length_, [buffer, nuc_lookup](std::size_t index) { return (uint64_t)nuc_lookup[(uint8_t)(buffer[index])]; }))
 	{
-		char nuc_char = buffer[index];
-		uint64_t nuc_int;
-		
-		if (nuc_char == 'A')		nuc_int = 0;
-		else if (nuc_char == 'C')	nuc_int = 1;
-		else if (nuc_char == 'G')	nuc_int = 2;
-		else if (nuc_char == 'T')	nuc_int = 3;
-		else EIDOS_TERMINATION << "ERROR (NucleotideArray::ReadNucleotidesFromBuffer): unexpected character '" << nuc_char << "' in nucleotide sequence." << EidosTerminate();
-		
-		SetNucleotideAtIndex(index, nuc_int);
+		// find the offending character for the error message
+		for (std::size_t index = 0; index < length_; ++index)
+		{
+			char nuc_char = buffer[index];
+			
+			if (nuc_lookup[(uint8_t)nuc_char] > 3)
+				EIDOS_TERMINATION << "ERROR (NucleotideArray::ReadNucleotidesFromBuffer): unexpected character '" << nuc_char << "' in nucleotide sequence." << EidosTerminate();
+		}
 	}
 }
 
@@ -876,7 +1052,6 @@ void NucleotideArray::ReadCompressedNucleotides(char **buffer, char *end)
 std::ostream& operator<<(std::ostream& p_out, const NucleotideArray &p_nuc_array)
 {
 	// Emit FASTA format with 70 bases per line
-	static const char nuc_chars[4] = {'A', 'C', 'G', 'T'};
 	std::size_t index = 0;
 	std::string nuc_string;
 	
@@ -885,8 +1060,7 @@ std::ostream& operator<<(std::ostream& p_out, const NucleotideArray &p_nuc_array
 	
 	while (index + 70 <= p_nuc_array.length_)
 	{
-		for (int line_index = 0; line_index < 70; ++line_index)
-			nuc_string[line_index] = nuc_chars[p_nuc_array.NucleotideAtIndex(index + line_index)];
+		p_nuc_array.WriteNucleotidesToBuffer(&nuc_string[0], index, index + 69);
 		
 		p_out << nuc_string << std::endl;
 		index += 70;
@@ -895,17 +1069,10 @@ std::ostream& operator<<(std::ostream& p_out, const NucleotideArray &p_nuc_array
 	// Then emit a final line with any remaining nucleotides
 	if (index < p_nuc_array.length_)
 	{
-		for ( ; index < p_nuc_array.length_; ++index)
-		{
-			int nuc = p_nuc_array.NucleotideAtIndex(index);
-			
-			if (nuc == 0)			p_out << 'A';
-			else if (nuc == 1)		p_out << 'C';
-			else if (nuc == 2)		p_out << 'G';
-			else /*if (nuc == 3)*/	p_out << 'T';
-		}
+		nuc_string.resize(p_nuc_array.length_ - index);
+		p_nuc_array.WriteNucleotidesToBuffer(&nuc_string[0], index, p_nuc_array.length_ - 1);
 		
-		p_out << std::endl;
+		p_out << nuc_string << std::endl;
 	}
 	
 	return p_out;
@@ -1140,6 +1307,9 @@ const std::string gStr_rescheduleScriptBlock = "rescheduleScriptBlock";
 const std::string gStr_simulationFinished = "simulationFinished";
 const std::string gStr_treeSeqCoalesced = "treeSeqCoalesced";
 const std::string gStr_treeSeqSimplify = "treeSeqSimplify";
+const std::string gStr_treeSeqDiversity = "treeSeqDiversity";
+const std::string gStr_treeSeqDivergence = "treeSeqDivergence";
+const std::string gStr_treeSeqSFS = "treeSeqSFS";
 const std::string gStr_treeSeqRememberIndividuals = "treeSeqRememberIndividuals";
 const std::string gStr_treeSeqOutput = "treeSeqOutput";
 const std::string gStr_setMigrationRates = "setMigrationRates";
@@ -1480,6 +1650,9 @@ void SLiM_RegisterGlobalStringsAndIDs(void)
 		Eidos_RegisterStringForGlobalID(gStr_simulationFinished, gID_simulationFinished);
 		Eidos_RegisterStringForGlobalID(gStr_treeSeqCoalesced, gID_treeSeqCoalesced);
 		Eidos_RegisterStringForGlobalID(gStr_treeSeqSimplify, gID_treeSeqSimplify);
+		Eidos_RegisterStringForGlobalID(gStr_treeSeqDiversity, gID_treeSeqDiversity);
+		Eidos_RegisterStringForGlobalID(gStr_treeSeqDivergence, gID_treeSeqDivergence);
+		Eidos_RegisterStringForGlobalID(gStr_treeSeqSFS, gID_treeSeqSFS);
 		Eidos_RegisterStringForGlobalID(gStr_treeSeqRememberIndividuals, gID_treeSeqRememberIndividuals);
 		Eidos_RegisterStringForGlobalID(gStr_treeSeqOutput, gID_treeSeqOutput);
 		Eidos_RegisterStringForGlobalID(gStr_setMigrationRates, gID_setMigrationRates);
@@ -75,7 +75,7 @@ void SLiM_WarmUp(void);
 #pragma mark Global optimization flags
 #pragma mark -
 
-// If defined, MutationType will keep its own registry of all mutations of that type, under certain circumstances.
+// If defined, each MutationType will keep its own registry of all mutations of that type.
 // See mutation_type.h for more information on this optimization.
 #define SLIM_KEEP_MUTTYPE_REGISTRIES
 
@@ -393,6 +393,13 @@ public:
 	NucleotideArray(std::size_t p_length, const char *p_char_buffer);
 	NucleotideArray(std::size_t p_length, const std::vector<std::string> &p_string_vector);
 	
+	// Constructor that reads a FASTA sequence from a stream, packing nucleotides directly as they are read, in blocks,
+	// with no intermediate string buffer.  Blank lines and lines starting with '>' or ';' are skipped at the start, and
+	// terminate the sequence after it has begun.  p_length_hint is an upper bound on the sequence length if known (the
+	// file size, typically), or 0; it just sets the initial allocation.  Raises std::out_of_range for characters other
+	// than ACGT, and std::runtime_error for a stream error; the sequence read may have length zero, which is legal here.
+	NucleotideArray(std::istream &p_fasta_stream, std::size_t p_length_hint);
+	
 	std::size_t size() const { return length_; }
 	
 	inline int NucleotideAtIndex(std::size_t p_index) const {
@@ -403,7 +410,9 @@ public:
 	
 	// Write nucleotides to a char buffer; the buffer must be allocated with sufficient length
 	// Read nucleotides from a char buffer; the buffer is assumed to be of appropriate length
+	// The ranged version writes the nucleotides in [p_start, p_end] only, decoding whole uint64_t chunks at a time
 	void WriteNucleotidesToBuffer(char *buffer) const;
+	void WriteNucleotidesToBuffer(char *buffer, std::size_t p_start, std::size_t p_end) const;
 	void ReadNucleotidesFromBuffer(char *buffer);
 	
 	// Write compressed nucleotides to an ostream as a binary block, with a leading 64-bit size in nucleotides
@@ -424,6 +433,9 @@ public:
 	
 	// Provides a static lookup table for going from char ('A'/'C'/'G'/'T') to int (0/1/2/3; 4 for errors)
 	static uint8_t *NucleotideCharToIntLookup(void);
+	
+	// Provides a static lookup table for going from a byte of packed nucleotides to their four chars; entry i is at i * 4
+	static const char *NucleotideByteToCharsLookup(void);
 };
 
 std::ostream& operator<<(std::ostream& p_out, const NucleotideArray &p_nuc_array);
@@ -624,6 +636,9 @@ extern const std::string gStr_rescheduleScriptBlock;
 extern const std::string gStr_simulationFinished;
 extern const std::string gStr_treeSeqCoalesced;
 extern const std::string gStr_treeSeqSimplify;
+extern const std::string gStr_treeSeqDiversity;
+extern const std::string gStr_treeSeqDivergence;
+extern const std::string gStr_treeSeqSFS;
 extern const std::string gStr_treeSeqRememberIndividuals;
 extern const std::string gStr_treeSeqOutput;
 extern const std::string gStr_setMigrationRates;
@@ -927,6 +942,9 @@ enum _SLiMGlobalStringID : int {
 	gID_simulationFinished,
 	gID_treeSeqCoalesced,
 	gID_treeSeqSimplify,
+	gID_treeSeqDiversity,
+	gID_treeSeqDivergence,
+	gID_treeSeqSFS,
 	gID_treeSeqRememberIndividuals,
 	gID_treeSeqOutput,
 	gID_setMigrationRates,
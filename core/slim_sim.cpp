@@ -45,6 +45,8 @@
 #include <unordered_map>
 #include <float.h>
 #include <ctime>
+#include <chrono>
+#include <cstring>
 
 //TREE SEQUENCE
 #include <stdio.h>
@@ -616,8 +618,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromTextFile(const char *p_file,
 		population_.mutation_registry_.emplace_back(new_mut_index);
 		
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-		if (population_.keeping_muttype_registries_)
-			EIDOS_TERMINATION << "ERROR (SLiMSim::_InitializePopulationFromTextFile): (internal error) separate muttype registries set up during pop load." << EidosTerminate();
+		mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 		
 		// all mutations seen here will be added to the simulation somewhere, so check and set pure_neutral_ and all_pure_neutral_DFE_
@@ -628,7 +629,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromTextFile(const char *p_file,
 		}
 	}
 	
-	population_.cached_tally_genome_count_ = 0;
+	population_.InvalidateMutationReferencesCache();
 	
 	// If there is an Individuals section (added in SLiM 2.0), we now need to parse it since it might contain spatial positions
 	if (line.find("Individuals") != std::string::npos)
@@ -846,7 +847,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromTextFile(const char *p_file,
 	
 	// Re-tally mutation references so we have accurate frequency counts for our new mutations
 	population_.UniqueMutationRuns();
-	population_.TallyMutationReferences(nullptr, true);
+	population_.TallyMutationReferences(true);
 	
 	if (file_version <= 2)
 	{
@@ -1241,8 +1242,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromBinaryFile(const char *p_fil
 		population_.mutation_registry_.emplace_back(new_mut_index);
 		
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-		if (population_.keeping_muttype_registries_)
-			EIDOS_TERMINATION << "ERROR (SLiMSim::_InitializePopulationFromBinaryFile): (internal error) separate muttype registries set up during pop load." << EidosTerminate();
+		mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 		
 		// all mutations seen here will be added to the simulation somewhere, so check and set pure_neutral_ and all_pure_neutral_DFE_
@@ -1253,7 +1253,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromBinaryFile(const char *p_fil
 		}
 	}
 	
-	population_.cached_tally_genome_count_ = 0;
+	population_.InvalidateMutationReferencesCache();
 	
 	if (p + sizeof(section_end_tag) > buf_end)
 		EIDOS_TERMINATION << "ERROR (SLiMSim::_InitializePopulationFromBinaryFile): unexpected EOF after mutations." << EidosTerminate();
@@ -1495,7 +1495,7 @@ slim_generation_t SLiMSim::_InitializePopulationFromBinaryFile(const char *p_fil
 	
 	// Re-tally mutation references so we have accurate frequency counts for our new mutations
 	population_.UniqueMutationRuns();
-	population_.TallyMutationReferences(nullptr, true);
+	population_.TallyMutationReferences(true);
 	
 	if (file_version <= 2)
 	{
@@ -2999,17 +2999,6 @@ bool SLiMSim::_RunOneGeneration(void)
 	}
 	else
 	{
-#ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-		// Optimization; see mutation_type.h for an explanation of what this counter is used for
-		if (population_.any_muttype_call_count_used_)
-		{
-			for (auto muttype_iter : mutation_types_)
-				(muttype_iter.second)->muttype_registry_call_count_ = 0;
-			
-			population_.any_muttype_call_count_used_ = false;
-		}
-#endif
-		
 		// Non-zero generations are handled by separate functions for WF and nonWF models
 		
 #if defined(SLIM_WF_ONLY) && defined(SLIM_NONWF_ONLY)
@@ -3426,7 +3415,7 @@ bool SLiMSim::_RunOneGenerationWF(void)
 		// NOTE that this means tallies may be different in SLiMgui than in slim!  I *think* this will never be visible to the
 		// user's model, because if they ask for mutation counts/frequences a call to TallyMutationReferences() will be made at that
 		// point anyway to synchronize; but in slim's code itself, not in Eidos, the tallies can definitely differ!  Beware!
-		population_.TallyMutationReferences(nullptr, false);
+		population_.TallyMutationReferences(false);
 #endif
 	
 		// TREE SEQUENCE RECORDING
@@ -3530,6 +3519,12 @@ bool SLiMSim::_RunOneGenerationNonWF(void)
 		std::vector<SLiMEidosBlock*> recombination_callbacks = ScriptBlocksMatching(generation_, SLiMEidosBlockType::SLiMEidosRecombinationCallback, -1, -1, -1);
 		std::vector<SLiMEidosBlock*> mutation_callbacks = ScriptBlocksMatching(generation_, SLiMEidosBlockType::SLiMEidosMutationCallback, -1, -1, -1);
 		
+		// mutation(), recombination(), and modifyChild() callbacks run while an offspring's genomes are not yet in
+		// nonWF_offspring_genomes_, where a background simplification could not renumber them if the callback forced it to
+		// finish (by calling outputUsage(), for example); so it is finished beforehand instead
+		if (recording_tree_ && (mutation_callbacks.size() || recombination_callbacks.size() || modify_child_callbacks.size()))
+			FinishBackgroundSimplification();
+		
 		// cache a list of callbacks registered for each subpop
 		for (std::pair<const slim_objectid_t,Subpopulation*> &subpop_pair : population_.subpops_)
 		{
@@ -3607,7 +3602,7 @@ bool SLiMSim::_RunOneGenerationNonWF(void)
 				individual->migrant_ = false;
 		
 		// cached mutation counts/frequencies are no longer accurate; mark the cache as invalid
-		population_.cached_tally_genome_count_ = 0;
+		population_.InvalidateMutationReferencesCache();
 		
 		// the stage is done, so deregister script blocks as requested
 		DeregisterScheduledScriptBlocks();
@@ -3854,7 +3849,7 @@ bool SLiMSim::_RunOneGenerationNonWF(void)
 		// NOTE that this means tallies may be different in SLiMgui than in slim!  I *think* this will never be visible to the
 		// user's model, because if they ask for mutation counts/frequences a call to TallyMutationReferences() will be made at that
 		// point anyway to synchronize; but in slim's code itself, not in Eidos, the tallies can definitely differ!  Beware!
-		population_.TallyMutationReferences(nullptr, false);
+		population_.TallyMutationReferences(false);
 #endif
 	
 		// TREE SEQUENCE RECORDING
@@ -4069,20 +4064,27 @@ void SLiMSim::_CheckMutationStackPolicy(void)
 void SLiMSim::CacheNucleotideMatrices(void)
 {
 	// Go through all genomic element types in a nucleotide-based model, analyze their mutation matrices,
-	// and find the maximum mutation rate expressed by any genomic element type for any genomic background.
+	// and find the maximum mutation rate expressed by each genomic element type for any genomic background,
+	// as well as the maximum across all genomic element types.
 	max_nucleotide_mut_rate_ = 0.0;
 	
+	std::unordered_map<GenomicElementType *, double> max_rate_for_type;
+	
 	for (auto type_entry : genomic_element_types_)
 	{
 		GenomicElementType *ge_type = type_entry.second;
 		
 		if (ge_type->mm_thresholds)
+		{
 			free(ge_type->mm_thresholds);
+			ge_type->mm_thresholds = nullptr;
+		}
 		
 		if (ge_type->mutation_matrix_)
 		{
 			EidosValue_Float_vector *mm = ge_type->mutation_matrix_.get();
 			double *mm_data = mm->data();
+			double type_max_rate = 0.0;
 			
 			if (mm->Count() == 16)
 			{
@@ -4094,8 +4096,8 @@ void SLiMSim::CacheNucleotideMatrices(void)
 					double rateT = mm_data[nuc + 12];
 					double total_rate = rateA + rateC + rateG + rateT;
 					
-					if (total_rate > max_nucleotide_mut_rate_)
-						max_nucleotide_mut_rate_ = total_rate;
+					if (total_rate > type_max_rate)
+						type_max_rate = total_rate;
 				}
 			}
 			else if (mm->Count() == 256)
@@ -4108,17 +4110,26 @@ void SLiMSim::CacheNucleotideMatrices(void)
 					double rateT = mm_data[trinuc + 192];
 					double total_rate = rateA + rateC + rateG + rateT;
 					
-					if (total_rate > max_nucleotide_mut_rate_)
-						max_nucleotide_mut_rate_ = total_rate;
+					if (total_rate > type_max_rate)
+						type_max_rate = total_rate;
 				}
 			}
 			else
 				EIDOS_TERMINATION << "ERROR (SLiMSim::CacheNucleotideMatrices): (internal error) unsupported mutation matrix size." << EidosTerminate();
+			
+			max_rate_for_type[ge_type] = type_max_rate;
+			
+			if (type_max_rate > max_nucleotide_mut_rate_)
+				max_nucleotide_mut_rate_ = type_max_rate;
 		}
 	}
 	
-	// Now go through the genomic element types again, and calculate normalized mutation rate
-	// threshold values that will allow fast decisions on which derived nucleotide to create
+	// Now go through the genomic element types again, and calculate normalized mutation rate threshold values that
+	// will allow fast decisions on which derived nucleotide to create.  The thresholds for each genomic element type
+	// are normalized to that type's own maximum rate, not to the model-wide maximum; the mutation rate map is then
+	// scaled down within each genomic element by mm_max_rate_fraction_ (see Chromosome::_InitializeOneMutationMap()).
+	// This keeps the rejection sampling in Chromosome::DrawNewMutationExtended() as tight as it can be for each
+	// genomic element type, rather than rejecting most draws in elements with a low maximum rate.
 	for (auto type_entry : genomic_element_types_)
 	{
 		GenomicElementType *ge_type = type_entry.second;
@@ -4127,6 +4138,9 @@ void SLiMSim::CacheNucleotideMatrices(void)
 		{
 			EidosValue_Float_vector *mm = ge_type->mutation_matrix_.get();
 			double *mm_data = mm->data();
+			double type_max_rate = max_rate_for_type[ge_type];
+			
+			ge_type->mm_max_rate_fraction_ = ((max_nucleotide_mut_rate_ > 0.0) ? (type_max_rate / max_nucleotide_mut_rate_) : 0.0);
 			
 			if (mm->Count() == 16)
 			{
@@ -4139,13 +4153,22 @@ void SLiMSim::CacheNucleotideMatrices(void)
 					double rateG = mm_data[nuc + 8];
 					double rateT = mm_data[nuc + 12];
 					double total_rate = rateA + rateC + rateG + rateT;
-					double fraction_of_max_rate = total_rate / max_nucleotide_mut_rate_;
 					double *nuc_thresholds = ge_type->mm_thresholds + nuc * 4;
 					
-					nuc_thresholds[0] = (rateA / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[1] = ((rateA + rateC) / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[2] = ((rateA + rateC + rateG) / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[3] = fraction_of_max_rate;
+					if (total_rate > 0.0)
+					{
+						double fraction_of_max_rate = total_rate / type_max_rate;
+						
+						nuc_thresholds[0] = (rateA / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[1] = ((rateA + rateC) / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[2] = ((rateA + rateC + rateG) / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[3] = fraction_of_max_rate;
+					}
+					else
+					{
+						// no mutations ever occur on this background; every draw is rejected
+						nuc_thresholds[0] = nuc_thresholds[1] = nuc_thresholds[2] = nuc_thresholds[3] = 0.0;
+					}
 				}
 			}
 			else if (mm->Count() == 256)
@@ -4159,13 +4182,22 @@ void SLiMSim::CacheNucleotideMatrices(void)
 					double rateG = mm_data[trinuc + 128];
 					double rateT = mm_data[trinuc + 192];
 					double total_rate = rateA + rateC + rateG + rateT;
-					double fraction_of_max_rate = total_rate / max_nucleotide_mut_rate_;
 					double *nuc_thresholds = ge_type->mm_thresholds + trinuc * 4;
 					
-					nuc_thresholds[0] = (rateA / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[1] = ((rateA + rateC) / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[2] = ((rateA + rateC + rateG) / total_rate) * fraction_of_max_rate;
-					nuc_thresholds[3] = fraction_of_max_rate;
+					if (total_rate > 0.0)
+					{
+						double fraction_of_max_rate = total_rate / type_max_rate;
+						
+						nuc_thresholds[0] = (rateA / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[1] = ((rateA + rateC) / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[2] = ((rateA + rateC + rateG) / total_rate) * fraction_of_max_rate;
+						nuc_thresholds[3] = fraction_of_max_rate;
+					}
+					else
+					{
+						// no mutations ever occur on this background; every draw is rejected
+						nuc_thresholds[0] = nuc_thresholds[1] = nuc_thresholds[2] = nuc_thresholds[3] = 0.0;
+					}
 				}
 			}
 			else
@@ -4181,10 +4213,10 @@ void SLiMSim::CreateNucleotideMutationRateMap(void)
 	// because any particular spot could have the nucleotide sequence that leads to that maximum rate; we don't want
 	// to have to calculate the mutation rate map every time the sequence changes, so instead we use rejection
 	// sampling.  With a hotspot map, the mutation rate map is the product of the hotspot map and the maximum
-	// sequence-based rate.  Note that we could get more tricky here – even without a hotspot map we could vary
-	// the mutation rate map based upon the genomic elements in the chromosome, since different genomic elements
-	// may have different maximum sequence-based mutation rates.  We do not do that right now, to keep the model
-	// simple.
+	// sequence-based rate.  Different genomic element types may have different maximum sequence-based mutation
+	// rates; that is accounted for when the rate map is intersected with the genomic elements, in
+	// Chromosome::_InitializeOneMutationMap(), by scaling each element's rate by its type's mm_max_rate_fraction_.
+	// The rate map here therefore remains simple, and need not change when an element's type changes.
 	
 	// Note that in nucleotide-based models we completely hide the existence of the mutation rate map from the user;
 	// all the user sees are the mutationMatrix parameters to initializeGenomicElementType() and the hotspot map
@@ -4447,7 +4479,18 @@ void SLiMSim::TabulateMemoryUsage(SLiM_MemoryUsage *p_usage, EidosSymbolTable *p
 		
 		p_usage->slimsimObjects = (sizeof(SLiMSim) - sizeof(Chromosome)) * p_usage->slimsimObjects_count;	// Chromosome is handled separately above
 		
+		if (recording_tree_)
+			FinishBackgroundSimplification();
+		
 		p_usage->slimsimTreeSeqTables = recording_tree_ ? MemoryUsageForTables(tables_) : 0;
+		
+		// the buffers for staged nodes and edges are empty after the flush above, but keep their capacity
+		if (recording_tree_)
+		{
+			p_usage->slimsimTreeSeqTables += (staged_node_time_.capacity() + staged_edge_left_.capacity() + staged_edge_right_.capacity()) * sizeof(double);
+			p_usage->slimsimTreeSeqTables += (staged_node_population_.capacity() + staged_edge_parent_.capacity() + staged_edge_child_.capacity()) * sizeof(tsk_id_t);
+			p_usage->slimsimTreeSeqTables += staged_node_metadata_.capacity() * sizeof(GenomeMetadataRec);
+		}
 	}
 	
 	// Subpopulation
@@ -4732,79 +4775,205 @@ void SLiMSim::ReorderIndividualTable(tsk_table_collection_t *p_tables, std::vect
 	}
 }
 
-void SLiMSim::SimplifyTreeSequence(void)
+// Merges the edges [0, p_split), which are in sorted order, with the edges [p_split, num_rows), which have just been sorted,
+// into a single edge table in the order required by simplify: by parent time, with each parent's edges contiguous and sorted
+// by child and then by left.  Edges whose parent times occur in only one of the two runs are taken as they are; where both
+// runs share a parent time (a parent born before the last simplification can have both old and new children, for example),
+// that block of edges is sorted in full.  This takes linear time, apart from such shared blocks, which are usually small.
+static void MergeSortedEdgeRuns(tsk_table_collection_t *p_tables, tsk_size_t p_split)
 {
-#if DEBUG
-	if (!recording_tree_)
-		EIDOS_TERMINATION << "ERROR (SLiMSim::SimplifyTreeSequence): (internal error) tree sequence recording method called with recording off." << EidosTerminate();
-#endif
+	struct EdgeRec {
+		double time_;
+		tsk_id_t parent_, child_;
+		double left_, right_;
+	};
 	
-	if (tables_.nodes.num_rows == 0)
-		return;
+	tsk_edge_table_t &edges = p_tables->edges;
+	const double *node_time = p_tables->nodes.time;
+	tsk_size_t edge_count = edges.num_rows;
+	std::vector<EdgeRec> merged;
 	
-	std::vector<tsk_id_t> samples;
+	merged.reserve(edge_count);
 	
-	// BCH 7/27/2019: We now build a std::unordered_map containing all of the entries of remembered_genomes_,
-	// so that the find() operations in the loop below can be done in constant time instead of O(N) time.
-	// We need to be able to find out the index of an entry, in remembered_genomes_, once we have found it;
-	// that is what the mapped value provides, whereas the key value is the tsk_id_t we need to find below.
-	// We do all this inside a block so the map gets deallocated as soon as possible, to minimize footprint.
+	auto take_edge = [&](tsk_size_t p_index) {
+		tsk_id_t parent = edges.parent[p_index];
+		merged.emplace_back(EdgeRec{node_time[parent], parent, edges.child[p_index], edges.left[p_index], edges.right[p_index]});
+	};
+	
+	tsk_size_t old_index = 0, new_index = p_split;
+	
+	while ((old_index < p_split) || (new_index < edge_count))
 	{
-		std::unordered_map<tsk_id_t, uint32_t> remembered_genomes_lookup;
-		
-		// the remembered_genomes_ come first in the list of samples
-		uint32_t index = 0;
+		double old_time = (old_index < p_split) ? node_time[edges.parent[old_index]] : INFINITY;
+		double new_time = (new_index < edge_count) ? node_time[edges.parent[new_index]] : INFINITY;
 		
-		for (tsk_id_t sid : remembered_genomes_)
+		if (old_time < new_time)
 		{
-			samples.push_back(sid);
-			remembered_genomes_lookup.emplace(std::pair<tsk_id_t, uint32_t>(sid, index));
-			index++;
+			take_edge(old_index++);
 		}
+		else if (new_time < old_time)
+		{
+			take_edge(new_index++);
+		}
+		else
+		{
+			size_t block_start = merged.size();
+			
+			while ((old_index < p_split) && (node_time[edges.parent[old_index]] == old_time))
+				take_edge(old_index++);
+			while ((new_index < edge_count) && (node_time[edges.parent[new_index]] == new_time))
+				take_edge(new_index++);
+			
+			std::sort(merged.begin() + block_start, merged.end(), [](const EdgeRec &a, const EdgeRec &b) {
+				if (a.parent_ != b.parent_) return a.parent_ < b.parent_;
+				if (a.child_ != b.child_) return a.child_ < b.child_;
+				return a.left_ < b.left_;
+			});
+		}
+	}
+	
+	for (tsk_size_t index = 0; index < edge_count; ++index)
+	{
+		const EdgeRec &edge = merged[index];
 		
-		// and then come all the genomes of the extant individuals
-		tsk_id_t newValueInNodeTable = (tsk_id_t)remembered_genomes_.size();
+		edges.left[index] = edge.left_;
+		edges.right[index] = edge.right_;
+		edges.parent[index] = edge.parent_;
+		edges.child[index] = edge.child_;
+	}
+}
+
+// Sorts p_tables for simplification, given that its edges [0, p_sorted_edge_count) are already in sorted order; returns a tskit
+// error code.  This touches nothing but p_tables, so that it can be run on a background thread by StartBackgroundSimplification().
+static int SortTablesForSimplification(tsk_table_collection_t *p_tables, tsk_size_t p_sorted_edge_count)
+{
+	// Edges up to p_sorted_edge_count are still in the order left by the last simplification (or sort), since we only append
+	// edges and never change the times of existing nodes; so we sort only the edges recorded since then, and merge the two
+	// runs.  The cost of sorting thus scales with the new edges, not with the whole edge table.  Sites and mutations are
+	// still sorted in full by tskit, which does not support a starting offset for them.
+	tsk_size_t edge_count = p_tables->edges.num_rows;
+	tsk_size_t sorted_count = std::min(p_sorted_edge_count, edge_count);
+	tsk_bookmark_t start;
+	
+	memset(&start, 0, sizeof(start));
+	start.edges = sorted_count;
+	
+	int ret = tsk_table_collection_sort(p_tables, &start, /* flags */ 0);
+	if (ret < 0) return ret;
+	
+	if ((sorted_count > 0) && (sorted_count < edge_count))
+		MergeSortedEdgeRuns(p_tables, sorted_count);
+	
+	return 0;
+}
+
+// The table size used by the ratio-based auto-simplification heuristic; see CheckAutoSimplification()
+static uint64_t TableSizeForSimplification(tsk_table_collection_t &p_tables)
+{
+	// We could, in principle, calculate actual memory used based on number of rows * sizeof(column), etc.,
+	// but that seems like overkill; adding together the number of rows in all the tables should be a
+	// reasonable proxy, and this whole thing is just a heuristic that needs to be tailored anyway.
+	uint64_t table_size = (uint64_t)p_tables.nodes.num_rows;
+	table_size += (uint64_t)p_tables.edges.num_rows;
+	table_size += (uint64_t)p_tables.sites.num_rows;
+	table_size += (uint64_t)p_tables.mutations.num_rows;
+	
+	return table_size;
+}
+
+void SLiMSim::SortTreeSequenceTables(void)
+{
+	int ret = SortTablesForSimplification(&tables_, sorted_edge_count_);
+	if (ret < 0) handle_error("tsk_table_collection_sort", ret);
+	
+	sorted_edge_count_ = tables_.edges.num_rows;
+}
+
+void SLiMSim::CollectSimplificationSamples(std::vector<tsk_id_t> &p_samples)
+{
+	// BCH 7/27/2019: We now build a std::unordered_map containing all of the entries of remembered_genomes_,
+	// so that the find() operations in the loop below can be done in constant time instead of O(N) time.
+	// We need to be able to find out the index of an entry, in remembered_genomes_, once we have found it;
+	// that is what the mapped value provides, whereas the key value is the tsk_id_t we need to find below.
+	// We do all this in its own method so the map gets deallocated as soon as possible, to minimize footprint.
+	std::unordered_map<tsk_id_t, uint32_t> remembered_genomes_lookup;
+	
+	// the remembered_genomes_ come first in the list of samples
+	uint32_t index = 0;
+	
+	for (tsk_id_t sid : remembered_genomes_)
+	{
+		p_samples.push_back(sid);
+		remembered_genomes_lookup.emplace(std::pair<tsk_id_t, uint32_t>(sid, index));
+		index++;
+	}
+	
+	// and then come all the genomes of the extant individuals
+	tsk_id_t newValueInNodeTable = (tsk_id_t)remembered_genomes_.size();
+	
+	for (auto it = population_.subpops_.begin(); it != population_.subpops_.end(); it++)
+	{
+		std::vector<Genome *> &subpopulationGenomes = it->second->parent_genomes_;
 		
-		for (auto it = population_.subpops_.begin(); it != population_.subpops_.end(); it++)
+		for (Genome *genome : subpopulationGenomes)
 		{
-			std::vector<Genome *> &subpopulationGenomes = it->second->parent_genomes_;
+			tsk_id_t M = genome->tsk_node_id_;
+			
+			// check if this sample is already being remembered, and assign the correct tsk_node_id_
+			// if not remembered, it is currently alive, so we need to mark it as a sample so it persists through simplify()
+			auto iter = remembered_genomes_lookup.find(M);
 			
-			for (Genome *genome : subpopulationGenomes)
+			if (iter == remembered_genomes_lookup.end())
 			{
-				tsk_id_t M = genome->tsk_node_id_;
-				
-				// check if this sample is already being remembered, and assign the correct tsk_node_id_
-				// if not remembered, it is currently alive, so we need to mark it as a sample so it persists through simplify()
-				auto iter = remembered_genomes_lookup.find(M);
-				
-				if (iter == remembered_genomes_lookup.end())
-				{
-					samples.push_back(M);
-					genome->tsk_node_id_ = newValueInNodeTable++;
-				}
-				else
-				{
-					genome->tsk_node_id_ = (tsk_id_t)(iter->second);
-				}
+				p_samples.push_back(M);
+				genome->tsk_node_id_ = newValueInNodeTable++;
+			}
+			else
+			{
+				genome->tsk_node_id_ = (tsk_id_t)(iter->second);
 			}
 		}
 	}
+}
+
+void SLiMSim::SimplifyTreeSequence(void)
+{
+#if DEBUG
+	if (!recording_tree_)
+		EIDOS_TERMINATION << "ERROR (SLiMSim::SimplifyTreeSequence): (internal error) tree sequence recording method called with recording off." << EidosTerminate();
+#endif
+	
+	FinishBackgroundSimplification();
+	
+	if (tables_.nodes.num_rows == 0)
+		return;
+	
+	std::vector<tsk_id_t> samples;
+	
+	CollectSimplificationSamples(samples);
 	
 	// the tables need to have a population table to be able to sort it
 	WritePopulationTable(&tables_);
 	
+	last_simplification_ = SimplificationRecord{generation_, MemoryUsageForTables(tables_, true), 0, 0};
+	auto start_time = std::chrono::steady_clock::now();
+	
 	// sort the table collection
-	int ret = tsk_table_collection_sort(&tables_, /* edge_start */ 0, /* flags */ 0);
-	if (ret < 0) handle_error("tsk_table_collection_sort", ret);
+	SortTreeSequenceTables();
 	
 	// remove redundant sites we added
-	ret = tsk_table_collection_deduplicate_sites(&tables_, 0);
+	int ret = tsk_table_collection_deduplicate_sites(&tables_, 0);
 	if (ret < 0) handle_error("tsk_table_collection_deduplicate_sites", ret);
 	
 	// simplify
 	ret = tsk_table_collection_simplify(&tables_, samples.data(), (tsk_size_t)samples.size(), TSK_FILTER_SITES | TSK_FILTER_INDIVIDUALS, NULL);
 	if (ret != 0) handle_error("tsk_table_collection_simplify", ret);
 	
+	CompleteSimplificationRecord(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+	
+	// the simplified edges are in sorted order, so the next sort only needs to handle edges added after this point
+	sorted_edge_count_ = tables_.edges.num_rows;
+	
 	// update map of remembered_genomes_, which are now the first n entries in the node table
 	for (tsk_id_t i = 0; i < (tsk_id_t)remembered_genomes_.size(); i++)
 		remembered_genomes_[i] = i;
@@ -4820,6 +4989,438 @@ void SLiMSim::SimplifyTreeSequence(void)
 		CheckCoalescenceAfterSimplification();
 }
 
+#ifdef _OPENMP
+void SLiMSim::CheckExtantGenomeNodeIds(void)
+{
+	// A genome recorded during a background simplification but missed by the renumbering in FinishBackgroundSimplification()
+	// would silently refer to the wrong node, corrupting the tables; such a genome's id is left pointing past the node table.
+	// So we check the parents and nonWF offspring, which will be recorded as parents in turn, when each background simplification
+	// is finished and again when the next one starts, by which time any offspring then being generated have become parents.
+	// This is cheap next to the simplification itself, so it is done even without crosschecks, which would finish each
+	// simplification as soon as it begins, hiding the problem.
+	tsk_id_t node_count = (tsk_id_t)tables_.nodes.num_rows;
+	
+	for (auto subpop_pair : population_.subpops_)
+	{
+		Subpopulation *subpop = subpop_pair.second;
+		
+		for (std::vector<Genome *> *genomes : {&subpop->parent_genomes_, &subpop->nonWF_offspring_genomes_})
+			for (Genome *genome : *genomes)
+				if ((genome->tsk_node_id_ < 0) || (genome->tsk_node_id_ >= node_count))
+					EIDOS_TERMINATION << "ERROR (SLiMSim::CheckExtantGenomeNodeIds): (internal error) genome node id " << genome->tsk_node_id_ << " is outside the node table (" << node_count << " rows) around a background simplification." << EidosTerminate();
+	}
+}
+
+void SLiMSim::StartBackgroundSimplification(void)
+{
+	// This does the same simplification as SimplifyTreeSequence(), but lets the next generation run while it happens.  The
+	// main thread does the cheap part here: collecting the samples and renumbering the extant genomes, which simplify() will
+	// map to node ids 0..n-1.  It then hands the whole table collection to a worker thread and starts an empty tables_, to
+	// which new nodes are recorded with ids starting at buffer_node_offset_, the size of the old node table, so that they
+	// can be told apart from the renumbered sample ids.  FinishBackgroundSimplification() joins the worker and appends the
+	// new rows to the simplified tables, renumbering them; the result is identical to simplifying synchronously.
+	FinishBackgroundSimplification();
+	
+	if (tables_.nodes.num_rows == 0)
+		return;
+	
+	CheckExtantGenomeNodeIds();
+	
+	simplify_samples_.clear();
+	CollectSimplificationSamples(simplify_samples_);
+	
+	// the tables need to have a population table to be able to sort it
+	WritePopulationTable(&tables_);
+	
+	last_simplification_ = SimplificationRecord{generation_, MemoryUsageForTables(tables_, true), 0, 0};
+	
+	// hand the table collection over to the worker; the struct copy transfers ownership of the column buffers
+	tsk_size_t sorted_edge_count = sorted_edge_count_;
+	
+	simplify_tables_ = tables_;
+	buffer_node_offset_ = (tsk_id_t)simplify_tables_.nodes.num_rows;
+	
+	int ret = tsk_table_collection_init(&tables_, 0);
+	if (ret != 0) handle_error("StartBackgroundSimplification()", ret);
+	
+	tables_.sequence_length = simplify_tables_.sequence_length;
+	sorted_edge_count_ = 0;
+	
+	// update map of remembered_genomes_, which will be the first n entries in the node table
+	for (tsk_id_t i = 0; i < (tsk_id_t)remembered_genomes_.size(); i++)
+		remembered_genomes_[i] = i;
+	
+	// reset current position, used to rewind individuals that are rejected by modifyChild()
+	RecordTablePosition();
+	
+	// and reset our elapsed time since last simplification, for auto-simplification
+	simplify_elapsed_ = 0;
+	
+	// the worker touches only simplify_tables_ and simplify_samples_, and reports errors back through simplify_ret_
+	simplify_ret_ = 0;
+	simplify_error_ = nullptr;
+	
+	simplify_thread_ = std::thread([this, sorted_edge_count]() {
+		auto start_time = std::chrono::steady_clock::now();
+		int worker_ret = SortTablesForSimplification(&simplify_tables_, sorted_edge_count);
+		
+		if (worker_ret < 0) { simplify_error_ = "tsk_table_collection_sort"; simplify_ret_ = worker_ret; return; }
+		
+		worker_ret = tsk_table_collection_deduplicate_sites(&simplify_tables_, 0);
+		
+		if (worker_ret < 0) { simplify_error_ = "tsk_table_collection_deduplicate_sites"; simplify_ret_ = worker_ret; return; }
+		
+		worker_ret = tsk_table_collection_simplify(&simplify_tables_, simplify_samples_.data(), (tsk_size_t)simplify_samples_.size(), TSK_FILTER_SITES | TSK_FILTER_INDIVIDUALS, NULL);
+		
+		if (worker_ret != 0) { simplify_error_ = "tsk_table_collection_simplify"; simplify_ret_ = worker_ret; return; }
+		
+		simplify_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	});
+}
+#endif
+
+void SLiMSim::FinishBackgroundSimplification(void)
+{
+	// Whatever else happens, tables_ is complete on return; staged rows go into the buffer, ahead of any renumbering below
+	FlushStagedTableRows();
+	
+#ifdef _OPENMP
+	if (!simplify_thread_.joinable())
+		return;
+	
+	simplify_thread_.join();
+	
+	// swap the simplified tables back in; the rows recorded since the simplification began are in buffer
+	tsk_table_collection_t buffer = tables_;
+	tsk_id_t node_base = buffer_node_offset_;
+	
+	tables_ = simplify_tables_;
+	buffer_node_offset_ = 0;
+	simplify_samples_.clear();
+	
+	if (simplify_ret_ != 0)
+	{
+		tsk_table_collection_free(&buffer);
+		handle_error(simplify_error_, simplify_ret_);
+	}
+	
+	if (buffer.individuals.num_rows || buffer.populations.num_rows || buffer.migrations.num_rows || buffer.provenances.num_rows)
+		EIDOS_TERMINATION << "ERROR (SLiMSim::FinishBackgroundSimplification): (internal error) unexpected table rows recorded during background simplification." << EidosTerminate();
+	
+	// the simplified edges are in sorted order, so the next sort only needs to handle edges added after this point
+	sorted_edge_count_ = tables_.edges.num_rows;
+	
+	CompleteSimplificationRecord(simplify_seconds_);
+	
+	if (simplify_adjusts_interval_)
+	{
+		AdjustSimplificationInterval(simplify_old_table_size_, TableSizeForSimplification(tables_));
+		simplify_adjusts_interval_ = false;
+	}
+	
+	// renumber the buffered rows to follow the simplified rows; node ids below node_base are already simplified sample ids
+	tsk_bookmark_t simplified_rows;
+	tsk_id_t node_shift = (tsk_id_t)tables_.nodes.num_rows - node_base;
+	tsk_id_t site_shift = (tsk_id_t)tables_.sites.num_rows;
+	tsk_id_t mutation_shift = (tsk_id_t)tables_.mutations.num_rows;
+	
+	tsk_table_collection_record_num_rows(&tables_, &simplified_rows);
+	
+	for (tsk_size_t edge_index = 0; edge_index < buffer.edges.num_rows; ++edge_index)
+	{
+		if (buffer.edges.parent[edge_index] >= node_base)
+			buffer.edges.parent[edge_index] += node_shift;
+		buffer.edges.child[edge_index] += node_shift;
+	}
+	
+	for (tsk_size_t mut_index = 0; mut_index < buffer.mutations.num_rows; ++mut_index)
+	{
+		if (buffer.mutations.node[mut_index] >= node_base)
+			buffer.mutations.node[mut_index] += node_shift;
+		buffer.mutations.site[mut_index] += site_shift;
+		if (buffer.mutations.parent[mut_index] != TSK_NULL)
+			buffer.mutations.parent[mut_index] += mutation_shift;
+	}
+	
+	int ret = tsk_node_table_append_columns(&tables_.nodes, buffer.nodes.num_rows, buffer.nodes.flags, buffer.nodes.time, buffer.nodes.population, buffer.nodes.individual, buffer.nodes.metadata, buffer.nodes.metadata_offset);
+	if (ret != 0) handle_error("tsk_node_table_append_columns", ret);
+	
+	ret = tsk_edge_table_append_columns(&tables_.edges, buffer.edges.num_rows, buffer.edges.left, buffer.edges.right, buffer.edges.parent, buffer.edges.child);
+	if (ret != 0) handle_error("tsk_edge_table_append_columns", ret);
+	
+	ret = tsk_site_table_append_columns(&tables_.sites, buffer.sites.num_rows, buffer.sites.position, buffer.sites.ancestral_state, buffer.sites.ancestral_state_offset, buffer.sites.metadata, buffer.sites.metadata_offset);
+	if (ret != 0) handle_error("tsk_site_table_append_columns", ret);
+	
+	ret = tsk_mutation_table_append_columns(&tables_.mutations, buffer.mutations.num_rows, buffer.mutations.site, buffer.mutations.node, buffer.mutations.parent, buffer.mutations.derived_state, buffer.mutations.derived_state_offset, buffer.mutations.metadata, buffer.mutations.metadata_offset);
+	if (ret != 0) handle_error("tsk_mutation_table_append_columns", ret);
+	
+	tsk_table_collection_free(&buffer);
+	
+	// renumber the extant genomes recorded since the simplification began, too
+	for (auto subpop_pair : population_.subpops_)
+	{
+		Subpopulation *subpop = subpop_pair.second;
+		
+		for (std::vector<Genome *> *genomes : {&subpop->parent_genomes_, &subpop->child_genomes_, &subpop->nonWF_offspring_genomes_})
+			for (Genome *genome : *genomes)
+				if (genome->tsk_node_id_ >= node_base)
+					genome->tsk_node_id_ += node_shift;
+	}
+	
+	CheckExtantGenomeNodeIds();
+	
+	// and move the rewind position past the simplified rows
+	table_position_.individuals += simplified_rows.individuals;
+	table_position_.nodes += simplified_rows.nodes;
+	table_position_.edges += simplified_rows.edges;
+	table_position_.migrations += simplified_rows.migrations;
+	table_position_.sites += simplified_rows.sites;
+	table_position_.mutations += simplified_rows.mutations;
+	table_position_.populations += simplified_rows.populations;
+	table_position_.provenances += simplified_rows.provenances;
+#endif
+}
+
+void SLiMSim::CompleteSimplificationRecord(double p_seconds)
+{
+	// Fill in the record for the simplification just done, begun in last_simplification_ before it started, and add it to the
+	// totals; this is called when the simplified tables are in tables_, before any newer rows are appended.  The memory-budget
+	// heuristic in CheckAutoSimplification() measures table growth from this point.
+	SimplificationRecord &record = last_simplification_;
+	
+	record.memory_after_ = MemoryUsageForTables(tables_, true);
+	record.seconds_ = p_seconds;
+	simplify_last_table_memory_ = record.memory_after_;
+	simplification_count_++;
+	simplification_seconds_ += p_seconds;
+	
+	if (SLiM_verbosity_level >= 2)
+		SLIM_OUTSTREAM << "// ++ Simplified tree sequence from generation " << record.generation_ << ": table memory " << record.memory_before_ << " -> " << record.memory_after_ << " bytes, " << record.seconds_ << " seconds" << std::endl;
+}
+
+void SLiMSim::DiscardBackgroundSimplification(void)
+{
+	// Used when the tree sequence is being freed; the extant genomes may already be gone, so nothing is renumbered
+#ifdef _OPENMP
+	if (!simplify_thread_.joinable())
+		return;
+	
+	simplify_thread_.join();
+	tsk_table_collection_free(&simplify_tables_);
+	simplify_samples_.clear();
+	simplify_adjusts_interval_ = false;
+#endif
+	
+	buffer_node_offset_ = 0;
+}
+
+// Computes a summary statistic of the sample sets p_sample_sets over the trees in p_tables, which must be indexed, in the manner of
+// tskit's general statistics framework (not present in the bundled tskit).  The summary function p_summary(x, weight, out) adds
+// weight * f(x) into out, where x holds, for each sample set, the number of its samples carrying an allele or below a branch.  In
+// site mode it is evaluated for each allele at each site (derived alleles only, if p_polarised), with x computed from the mutations
+// and the tree; in branch mode it is evaluated for each branch, weighted by the branch length in generations, and also for the
+// complement of x if !p_polarised.  The result is summed along the genome and divided by the sequence length.  The trees are
+// built incrementally from the edge indexes, and in branch mode a running total over all branches is kept up to date as each
+// edge comes and goes, so the cost per tree is proportional to the number of edges that change times the depth of the tree.
+template <typename F>
+static void TreeSeqGeneralStatistic(const tsk_table_collection_t &p_tables, const std::vector<std::vector<tsk_id_t>> &p_sample_sets, bool p_branch_mode, bool p_polarised, size_t p_result_dim, F p_summary, std::vector<double> &p_result)
+{
+	const size_t set_count = p_sample_sets.size();
+	const tsk_id_t node_count = (tsk_id_t)p_tables.nodes.num_rows;
+	const tsk_id_t edge_count = (tsk_id_t)p_tables.edges.num_rows;
+	const double sequence_length = p_tables.sequence_length;
+	const double *node_time = p_tables.nodes.time;
+	const tsk_id_t *edge_parent = p_tables.edges.parent;
+	const tsk_id_t *edge_child = p_tables.edges.child;
+	const double *edge_left = p_tables.edges.left;
+	const double *edge_right = p_tables.edges.right;
+	const tsk_id_t *insertion_order = p_tables.indexes.edge_insertion_order;
+	const tsk_id_t *removal_order = p_tables.indexes.edge_removal_order;
+	
+	std::vector<tsk_id_t> parent(node_count, TSK_NULL);
+	std::vector<double> branch_length(node_count, 0.0);
+	std::vector<double> counts(node_count * set_count, 0.0);	// samples in each set below each node, node-major
+	std::vector<double> totals(set_count, 0.0);
+	std::vector<double> complement(set_count);
+	std::vector<double> running(p_result_dim, 0.0);				// branch mode: the sum over all branches in the current tree
+	
+	p_result.assign(p_result_dim, 0.0);
+	
+	for (size_t set_index = 0; set_index < set_count; ++set_index)
+	{
+		for (tsk_id_t sample : p_sample_sets[set_index])
+			counts[sample * set_count + set_index] += 1.0;
+		
+		totals[set_index] = (double)p_sample_sets[set_index].size();
+	}
+	
+	// adds (or subtracts, with p_sign of -1) the contribution of the branch above p_node to the running total
+	auto add_branch = [&](tsk_id_t p_node, double p_sign) {
+		double weight = p_sign * branch_length[p_node];
+		
+		if (weight == 0.0)
+			return;
+		
+		const double *x = counts.data() + p_node * set_count;
+		
+		p_summary(x, weight, running.data());
+		
+		if (!p_polarised)
+		{
+			for (size_t set_index = 0; set_index < set_count; ++set_index)
+				complement[set_index] = totals[set_index] - x[set_index];
+			
+			p_summary(complement.data(), weight, running.data());
+		}
+	};
+	
+	// adds (or subtracts) the samples below p_child to every node on the path from p_parent to the root
+	auto propagate_counts = [&](tsk_id_t p_child, tsk_id_t p_parent, double p_sign) {
+		const double *child_counts = counts.data() + p_child * set_count;
+		
+		for (tsk_id_t node = p_parent; node != TSK_NULL; node = parent[node])
+		{
+			double *node_counts = counts.data() + node * set_count;
+			
+			if (p_branch_mode)
+				add_branch(node, -1.0);
+			
+			for (size_t set_index = 0; set_index < set_count; ++set_index)
+				node_counts[set_index] += p_sign * child_counts[set_index];
+			
+			if (p_branch_mode)
+				add_branch(node, 1.0);
+		}
+	};
+	
+	// site mode works out the parent of each mutation at a site as it goes, as tsk_table_collection_compute_mutation_parents() does
+	const tsk_size_t site_count = p_tables.sites.num_rows;
+	const tsk_size_t mutation_count = p_tables.mutations.num_rows;
+	std::vector<tsk_id_t> bottom_mutation;
+	std::vector<size_t> mutation_allele;
+	std::vector<std::pair<const char *, tsk_size_t>> alleles;
+	std::vector<double> allele_counts;
+	tsk_size_t site_index = 0, mutation_index = 0;
+	
+	if (!p_branch_mode)
+	{
+		bottom_mutation.resize(node_count, TSK_NULL);
+		mutation_allele.resize(mutation_count, 0);
+	}
+	
+	tsk_id_t insertion_index = 0, removal_index = 0;
+	double left = 0;
+	
+	while ((insertion_index < edge_count) || (left < sequence_length))
+	{
+		while ((removal_index < edge_count) && (edge_right[removal_order[removal_index]] == left))
+		{
+			tsk_id_t edge = removal_order[removal_index++];
+			tsk_id_t child = edge_child[edge];
+			
+			if (p_branch_mode)
+				add_branch(child, -1.0);
+			
+			branch_length[child] = 0.0;
+			parent[child] = TSK_NULL;
+			propagate_counts(child, edge_parent[edge], -1.0);
+		}
+		
+		while ((insertion_index < edge_count) && (edge_left[insertion_order[insertion_index]] == left))
+		{
+			tsk_id_t edge = insertion_order[insertion_index++];
+			tsk_id_t child = edge_child[edge];
+			tsk_id_t edge_parent_node = edge_parent[edge];
+			
+			propagate_counts(child, edge_parent_node, 1.0);
+			parent[child] = edge_parent_node;
+			branch_length[child] = node_time[edge_parent_node] - node_time[child];
+			
+			if (p_branch_mode)
+				add_branch(child, 1.0);
+		}
+		
+		double right = sequence_length;
+		
+		if (insertion_index < edge_count)
+			right = std::min(right, edge_left[insertion_order[insertion_index]]);
+		if (removal_index < edge_count)
+			right = std::min(right, edge_right[removal_order[removal_index]]);
+		
+		if (p_branch_mode)
+		{
+			for (size_t result_index = 0; result_index < p_result_dim; ++result_index)
+				p_result[result_index] += running[result_index] * (right - left);
+		}
+		else
+		{
+			for (; (site_index < site_count) && (p_tables.sites.position[site_index] < right); ++site_index)
+			{
+				// allele 0 is the ancestral state, carried by every sample until a mutation says otherwise
+				tsk_size_t ancestral_start = p_tables.sites.ancestral_state_offset[site_index];
+				
+				alleles.clear();
+				alleles.emplace_back(p_tables.sites.ancestral_state + ancestral_start, p_tables.sites.ancestral_state_offset[site_index + 1] - ancestral_start);
+				allele_counts.assign(totals.begin(), totals.end());
+				
+				tsk_size_t first_mutation = mutation_index;
+				
+				for (; (mutation_index < mutation_count) && (p_tables.mutations.site[mutation_index] == (tsk_id_t)site_index); ++mutation_index)
+				{
+					tsk_size_t derived_start = p_tables.mutations.derived_state_offset[mutation_index];
+					const char *derived_state = p_tables.mutations.derived_state + derived_start;
+					tsk_size_t derived_length = p_tables.mutations.derived_state_offset[mutation_index + 1] - derived_start;
+					size_t allele = 0;
+					
+					while ((allele < alleles.size()) && ((alleles[allele].second != derived_length) || (memcmp(alleles[allele].first, derived_state, derived_length) != 0)))
+						++allele;
+					
+					if (allele == alleles.size())
+					{
+						alleles.emplace_back(derived_state, derived_length);
+						allele_counts.resize(allele_counts.size() + set_count, 0.0);
+					}
+					
+					// the parent mutation is the nearest one above this mutation's node, on the node itself or an ancestor
+					tsk_id_t mutation_node = p_tables.mutations.node[mutation_index];
+					tsk_id_t ancestor = mutation_node;
+					
+					while ((ancestor != TSK_NULL) && (bottom_mutation[ancestor] == TSK_NULL))
+						ancestor = parent[ancestor];
+					
+					size_t parent_allele = 0;
+					
+					if (ancestor != TSK_NULL)
+						parent_allele = mutation_allele[bottom_mutation[ancestor]];
+					
+					mutation_allele[mutation_index] = allele;
+					bottom_mutation[mutation_node] = (tsk_id_t)mutation_index;
+					
+					// the samples below this mutation move from the parent's allele to this mutation's allele
+					const double *x = counts.data() + mutation_node * set_count;
+					
+					for (size_t set_index = 0; set_index < set_count; ++set_index)
+					{
+						allele_counts[allele * set_count + set_index] += x[set_index];
+						allele_counts[parent_allele * set_count + set_index] -= x[set_index];
+					}
+				}
+				
+				for (tsk_size_t mutation = first_mutation; mutation < mutation_index; ++mutation)
+					bottom_mutation[p_tables.mutations.node[mutation]] = TSK_NULL;
+				
+				for (size_t allele = (p_polarised ? 1 : 0); allele < alleles.size(); ++allele)
+					p_summary(allele_counts.data() + allele * set_count, 1.0, p_result.data());
+			}
+		}
+		
+		left = right;
+	}
+	
+	for (size_t result_index = 0; result_index < p_result_dim; ++result_index)
+		p_result[result_index] /= sequence_length;
+}
+
 void SLiMSim::CheckCoalescenceAfterSimplification(void)
 {
 #if DEBUG
@@ -4930,6 +5531,134 @@ void SLiMSim::RecordTablePosition(void)
 {
 	// keep the current table position for rewinding if a proposed child is rejected
 	tsk_table_collection_record_num_rows(&tables_, &table_position_);
+	staged_node_position_ = staged_node_time_.size();
+	staged_edge_position_ = staged_edge_left_.size();
+	staged_mutation_position_ = staged_mutation_node_.size();
+	staged_state_position_ = (staged_state_start_.empty() ? 0 : staged_state_start_.size() - 1);
+}
+
+void SLiMSim::FlushStagedTableRows(void)
+{
+	// Append the nodes and edges staged by RecordNewGenome(), and the derived states staged by RecordNewDerivedState(), to
+	// tables_, with a single append (and so a single reallocation) per table; this is done by FinishBackgroundSimplification(),
+	// before anything reads tables_, and at the end of each generation.  All staged nodes are samples with no individual, and
+	// their metadata records are packed contiguously.
+	size_t node_count = staged_node_time_.size();
+	size_t edge_count = staged_edge_left_.size();
+	
+	if (node_count)
+	{
+		std::vector<tsk_flags_t> flags(node_count, TSK_NODE_IS_SAMPLE);
+		std::vector<tsk_size_t> metadata_offset(node_count + 1);
+		
+		for (size_t node_index = 0; node_index <= node_count; ++node_index)
+			metadata_offset[node_index] = (tsk_size_t)(node_index * sizeof(GenomeMetadataRec));
+		
+		int ret = tsk_node_table_append_columns(&tables_.nodes, (tsk_size_t)node_count, flags.data(), staged_node_time_.data(), staged_node_population_.data(), NULL,
+												(char *)staged_node_metadata_.data(), metadata_offset.data());
+		if (ret != 0) handle_error("tsk_node_table_append_columns", ret);
+	}
+	
+	if (edge_count)
+	{
+		int ret = tsk_edge_table_append_columns(&tables_.edges, (tsk_size_t)edge_count, staged_edge_left_.data(), staged_edge_right_.data(), staged_edge_parent_.data(), staged_edge_child_.data());
+		if (ret != 0) handle_error("tsk_edge_table_append_columns", ret);
+	}
+	
+	// Expand the staged derived states into site and mutation rows.  Consecutive mutations at the same position, as recorded by
+	// bulk operations, share a site; deduplicate_sites() would merge those sites anyway.
+	size_t mutation_count = staged_mutation_node_.size();
+	tsk_size_t position_site_count = 0;		// the number of sites used by the mutations before staged_mutation_position_
+	
+	if (mutation_count)
+	{
+		std::vector<double> site_position;
+		std::vector<tsk_id_t> mutation_site(mutation_count);
+		std::vector<tsk_size_t> derived_state_offset(mutation_count + 1);
+		std::vector<tsk_size_t> metadata_offset(mutation_count + 1);
+		tsk_id_t site_base = (tsk_id_t)tables_.sites.num_rows;
+		size_t state_id_total = 0;
+		
+		for (size_t mut_index = 0; mut_index < mutation_count; ++mut_index)
+		{
+			if (mut_index == staged_mutation_position_)
+				position_site_count = (tsk_size_t)site_position.size();
+			
+			slim_position_t position = staged_mutation_site_position_[mut_index];
+			
+			if ((mut_index == 0) || (position != staged_mutation_site_position_[mut_index - 1]))
+				site_position.push_back((double)position);
+			
+			uint32_t state = staged_mutation_state_[mut_index];
+			
+			mutation_site[mut_index] = site_base + (tsk_id_t)site_position.size() - 1;
+			derived_state_offset[mut_index] = (tsk_size_t)(state_id_total * sizeof(slim_mutationid_t));
+			metadata_offset[mut_index] = (tsk_size_t)(state_id_total * sizeof(MutationMetadataRec));
+			state_id_total += staged_state_start_[state + 1] - staged_state_start_[state];
+		}
+		
+		if (staged_mutation_position_ == mutation_count)
+			position_site_count = (tsk_size_t)site_position.size();
+		
+		derived_state_offset[mutation_count] = (tsk_size_t)(state_id_total * sizeof(slim_mutationid_t));
+		metadata_offset[mutation_count] = (tsk_size_t)(state_id_total * sizeof(MutationMetadataRec));
+		
+		std::vector<slim_mutationid_t> derived_states;
+		std::vector<MutationMetadataRec> metadata;
+		
+		derived_states.reserve(state_id_total);
+		metadata.reserve(state_id_total);
+		
+		for (size_t mut_index = 0; mut_index < mutation_count; ++mut_index)
+		{
+			uint32_t state = staged_mutation_state_[mut_index];
+			size_t state_start = staged_state_start_[state], state_end = staged_state_start_[state + 1];
+			
+			derived_states.insert(derived_states.end(), staged_state_mutation_ids_.begin() + state_start, staged_state_mutation_ids_.begin() + state_end);
+			metadata.insert(metadata.end(), staged_state_metadata_.begin() + state_start, staged_state_metadata_.begin() + state_end);
+		}
+		
+		size_t site_count = site_position.size();
+		std::vector<tsk_size_t> site_offset(site_count + 1, 0);
+		char empty_state = 0;
+		
+		int ret = tsk_site_table_append_columns(&tables_.sites, (tsk_size_t)site_count, site_position.data(), &empty_state, site_offset.data(), &empty_state, site_offset.data());
+		if (ret != 0) handle_error("tsk_site_table_append_columns", ret);
+		
+		ret = tsk_mutation_table_append_columns(&tables_.mutations, (tsk_size_t)mutation_count, mutation_site.data(), staged_mutation_node_.data(), NULL,
+												(char *)derived_states.data(), derived_state_offset.data(), (char *)metadata.data(), metadata_offset.data());
+		if (ret != 0) handle_error("tsk_mutation_table_append_columns", ret);
+	}
+	
+	// the rewind position now lies in the tables rather than in the staging buffers
+	table_position_.nodes += staged_node_position_;
+	table_position_.edges += staged_edge_position_;
+	table_position_.sites += position_site_count;
+	table_position_.mutations += staged_mutation_position_;
+	
+	ClearStagedTableRows();
+}
+
+void SLiMSim::ClearStagedTableRows(void)
+{
+	staged_node_time_.clear();
+	staged_node_population_.clear();
+	staged_node_metadata_.clear();
+	staged_edge_left_.clear();
+	staged_edge_right_.clear();
+	staged_edge_parent_.clear();
+	staged_edge_child_.clear();
+	staged_node_position_ = 0;
+	staged_edge_position_ = 0;
+	
+	staged_mutation_site_position_.clear();
+	staged_mutation_node_.clear();
+	staged_mutation_state_.clear();
+	staged_state_start_.clear();
+	staged_state_mutation_ids_.clear();
+	staged_state_metadata_.clear();
+	staged_mutation_position_ = 0;
+	staged_state_position_ = 0;
 }
 
 void SLiMSim::AllocateTreeSequenceTables(void)
@@ -4946,6 +5675,7 @@ void SLiMSim::AllocateTreeSequenceTables(void)
 	if (ret != 0) handle_error("AllocateTreeSequenceTables()", ret);
 	
 	tables_.sequence_length = (double)chromosome_.last_position_ + 1;
+	sorted_edge_count_ = 0;
 	
 	RecordTablePosition();
 }
@@ -4983,6 +5713,32 @@ void SLiMSim::RetractNewIndividual()
 	//current_new_individual_ = nullptr;
 	
     tsk_table_collection_truncate(&tables_, &table_position_);
+	
+	staged_node_time_.resize(staged_node_position_);
+	staged_node_population_.resize(staged_node_position_);
+	staged_node_metadata_.resize(staged_node_position_);
+	staged_edge_left_.resize(staged_edge_position_);
+	staged_edge_right_.resize(staged_edge_position_);
+	staged_edge_parent_.resize(staged_edge_position_);
+	staged_edge_child_.resize(staged_edge_position_);
+	staged_mutation_site_position_.resize(staged_mutation_position_);
+	staged_mutation_node_.resize(staged_mutation_position_);
+	staged_mutation_state_.resize(staged_mutation_position_);
+	
+	// the retracted mutations may have staged new derived states, which nothing now refers to; states staged before the
+	// rewind position are kept, even if a retracted mutation reused one of them
+	if (staged_state_position_ == 0)
+	{
+		staged_state_start_.clear();
+		staged_state_mutation_ids_.clear();
+		staged_state_metadata_.clear();
+	}
+	else
+	{
+		staged_state_start_.resize(staged_state_position_ + 1);
+		staged_state_mutation_ids_.resize(staged_state_start_.back());
+		staged_state_metadata_.resize(staged_state_start_.back());
+	}
 }
 
 void SLiMSim::RecordNewGenome(std::vector<slim_position_t> *p_breakpoints, Genome *p_new_genome, 
@@ -5001,16 +5757,16 @@ void SLiMSim::RecordNewGenome(std::vector<slim_position_t> *p_breakpoints, Genom
 
 	// add genome node; we mark all nodes with TSK_NODE_IS_SAMPLE here because we have full genealogical information on all of them
 	// (until simplify, which clears TSK_NODE_IS_SAMPLE from nodes that are not kept in the sample).
+	// The node and its edges are staged, and appended to the tables in bulk by FlushStagedTableRows(); the node's id is the
+	// one it will have once appended.  While a background simplification is pending, new node ids are also offset past the
+	// tables being simplified; see StartBackgroundSimplification().
 	double time = (double) -1 * (tree_seq_generation_ + tree_seq_generation_offset_);	// see Population::AddSubpopulationSplit() regarding tree_seq_generation_offset_
-	uint32_t flags = TSK_NODE_IS_SAMPLE;
-	GenomeMetadataRec metadata_rec;
-	
-	MetadataForGenome(p_new_genome, &metadata_rec);
+	tsk_id_t offspringTSKID = (tsk_id_t)(tables_.nodes.num_rows + staged_node_time_.size()) + buffer_node_offset_;
 	
-	const char *metadata = (char *)&metadata_rec;
-	size_t metadata_length = sizeof(GenomeMetadataRec)/sizeof(char);
-	tsk_id_t offspringTSKID = tsk_node_table_add_row(&tables_.nodes, flags, time, (tsk_id_t)p_new_genome->subpop_->subpopulation_id_,
-                                        TSK_NULL, metadata, (tsk_size_t)metadata_length);
+	staged_node_time_.emplace_back(time);
+	staged_node_population_.emplace_back((tsk_id_t)p_new_genome->subpop_->subpopulation_id_);
+	staged_node_metadata_.emplace_back();
+	MetadataForGenome(p_new_genome, &staged_node_metadata_.back());
 	
 	p_new_genome->tsk_node_id_ = offspringTSKID;
 	
@@ -5038,8 +5794,10 @@ void SLiMSim::RecordNewGenome(std::vector<slim_position_t> *p_breakpoints, Genom
 		right = (*p_breakpoints)[i];
 
 		tsk_id_t parent = (tsk_id_t) (polarity ? genome1TSKID : genome2TSKID);
-		int ret = tsk_edge_table_add_row(&tables_.edges,left,right,parent,offspringTSKID);
-		if (ret < 0) handle_error("add_edge", ret);
+		staged_edge_left_.emplace_back(left);
+		staged_edge_right_.emplace_back(right);
+		staged_edge_parent_.emplace_back(parent);
+		staged_edge_child_.emplace_back(offspringTSKID);
 		
 		polarity = !polarity;
 		left = right;
@@ -5047,8 +5805,10 @@ void SLiMSim::RecordNewGenome(std::vector<slim_position_t> *p_breakpoints, Genom
 	
 	right = (double)chromosome_.last_position_+1;
 	tsk_id_t parent = (tsk_id_t) (polarity ? genome1TSKID : genome2TSKID);
-	int ret = tsk_edge_table_add_row(&tables_.edges,left,right,parent,offspringTSKID);
-	if (ret < 0) handle_error("add_edge", ret);
+	staged_edge_left_.emplace_back(left);
+	staged_edge_right_.emplace_back(right);
+	staged_edge_parent_.emplace_back(parent);
+	staged_edge_child_.emplace_back(offspringTSKID);
 }
 
 void SLiMSim::RecordNewDerivedState(const Genome *p_genome, slim_position_t p_position, const std::vector<Mutation *> &p_derived_mutations)
@@ -5080,27 +5840,21 @@ void SLiMSim::RecordNewDerivedState(const Genome *p_genome, slim_position_t p_po
 	if (p_genome->IsNull())
 		EIDOS_TERMINATION << "ERROR (SLiMSim::RecordNewDerivedState): new derived states cannot be recorded for null genomes." << EidosTerminate();
 	
-    tsk_id_t genomeTSKID = p_genome->tsk_node_id_;
-
-    // Identify any previous mutations at this site in this genome, and add a new site.
-	// This site may already exist, but we add it anyway, and deal with that in deduplicate_sites().
-    double tsk_position = (double) p_position;
-
-    tsk_id_t site_id = tsk_site_table_add_row(&tables_.sites, tsk_position, NULL, 0, NULL, 0);
-	
-    // form derived state
+	// The derived state is staged, and expanded into site and mutation rows by FlushStagedTableRows(); see there.
+	// Bulk operations, such as adding a mutation to many genomes at once, record the same derived state many times in a
+	// row, so a state identical to the previous one is kept only once until the flush.
 	static std::vector<slim_mutationid_t> derived_mutation_ids;
 	static std::vector<MutationMetadataRec> mutation_metadata;
 	MutationMetadataRec metadata_rec;
 	
 	derived_mutation_ids.clear();
-    mutation_metadata.clear();
+	mutation_metadata.clear();
 	for (Mutation *mutation : p_derived_mutations)
 	{
 		derived_mutation_ids.push_back(mutation->mutation_id_);
 		MetadataForMutation(mutation, &metadata_rec);
-        mutation_metadata.push_back(metadata_rec);
-    }
+		mutation_metadata.push_back(metadata_rec);
+	}
 	
 	// find and incorporate any fixed mutations at this position, which exist in all new derived states but are not included by SLiM
 	// BCH 5/14/2019: Note that this means that derived states will be recorded that look "stacked" even when those mutations would
@@ -5120,16 +5874,63 @@ void SLiMSim::RecordNewDerivedState(const Genome *p_genome, slim_position_t p_po
 		mutation_metadata.push_back(metadata_rec);
 	}
 	
-	// add the mutation table row with the final derived state and metadata
-    char *derived_muts_bytes = (char *)(derived_mutation_ids.data());
-    size_t derived_state_length = derived_mutation_ids.size() * sizeof(slim_mutationid_t);
-    char *mutation_metadata_bytes = (char *)(mutation_metadata.data());
-    size_t mutation_metadata_length = mutation_metadata.size() * sizeof(MutationMetadataRec);
+	// reuse the most recently staged state if this one is identical to it, including metadata; otherwise stage a new state
+	size_t state_length = derived_mutation_ids.size();
+	uint32_t state_count = (staged_state_start_.empty() ? 0 : (uint32_t)(staged_state_start_.size() - 1));
+	uint32_t state = state_count - 1;
+	
+	if ((state_count == 0) ||
+		(staged_state_start_[state + 1] - staged_state_start_[state] != state_length) ||
+		(memcmp(staged_state_mutation_ids_.data() + staged_state_start_[state], derived_mutation_ids.data(), state_length * sizeof(slim_mutationid_t)) != 0) ||
+		(memcmp(staged_state_metadata_.data() + staged_state_start_[state], mutation_metadata.data(), state_length * sizeof(MutationMetadataRec)) != 0))
+	{
+		if (state_count == 0)
+			staged_state_start_.push_back(0);
+		
+		state = state_count;
+		staged_state_mutation_ids_.insert(staged_state_mutation_ids_.end(), derived_mutation_ids.begin(), derived_mutation_ids.end());
+		staged_state_metadata_.insert(staged_state_metadata_.end(), mutation_metadata.begin(), mutation_metadata.end());
+		staged_state_start_.push_back(staged_state_mutation_ids_.size());
+	}
+	
+	staged_mutation_site_position_.emplace_back(p_position);
+	staged_mutation_node_.emplace_back(p_genome->tsk_node_id_);
+	staged_mutation_state_.emplace_back(state);
+}
 
-    int ret = tsk_mutation_table_add_row(&tables_.mutations, site_id, genomeTSKID, TSK_NULL, 
-                    derived_muts_bytes, (tsk_size_t)derived_state_length,
-                    mutation_metadata_bytes, (tsk_size_t)mutation_metadata_length);
-	if (ret < 0) handle_error("add_mutation", ret);
+void SLiMSim::AdjustSimplificationInterval(uint64_t p_old_table_size, uint64_t p_new_table_size)
+{
+	double ratio = p_old_table_size / (double)p_new_table_size;
+	
+	//std::cout << "auto-simplified in generation " << generation_ << "; old size " << p_old_table_size << ", new size " << p_new_table_size;
+	//std::cout << "; ratio " << ratio << ", target " << simplification_ratio_ << std::endl;
+	//std::cout << "old interval " << simplify_interval_ << ", new interval ";
+	
+	// Adjust our automatic simplification interval based upon the observed change in storage space used.
+	// Not sure if this is exactly what we want to do; this will hunt around a lot without settling on a value,
+	// but that seems harmless.  The scaling factor of 1.2 is chosen somewhat arbitrarily; we want it to be
+	// large enough that we will arrive at the optimum interval before too terribly long, but small enough
+	// that we have some granularity, so that once we reach the optimum we don't fluctuate too much.
+	if (ratio < simplification_ratio_)
+	{
+		// We simplified too soon; wait a little longer next time
+		simplify_interval_ *= 1.2;
+		
+		// Impose a maximum interval of 1000, so we don't get caught flat-footed if model demography changes
+		if (simplify_interval_ > 1000.0)
+			simplify_interval_ = 1000.0;
+	}
+	else if (ratio > simplification_ratio_)
+	{
+		// We simplified too late; wait a little less long next time
+		simplify_interval_ /= 1.2;
+		
+		// Impose a minimum interval of 1.0, just to head off weird underflow issues
+		if (simplify_interval_ < 1.0)
+			simplify_interval_ = 1.0;
+	}
+	
+	//std::cout << simplify_interval_ << std::endl;
 }
 
 void SLiMSim::CheckAutoSimplification(void)
@@ -5145,14 +5946,57 @@ void SLiMSim::CheckAutoSimplification(void)
 	// the pre:post ratio of the tree recording table sizes to the desired pre:post ratio, simplification_ratio_,
 	// as set up in initializeTreeSeq().  Note that a simplification_ratio_ value of INF means "never simplify
 	// automatically"; we check for that up front.
+	
+	// A simplification started in the background last time is finished first, since the interval may depend on it;
+	// that also flushes the nodes and edges staged during this generation into the tables.
+	// In multithreaded builds, auto-simplification then runs in the background during the next generation, unless
+	// coalescence checks are on; those need the extant genomes as they are at the time of simplification.
+	FinishBackgroundSimplification();
+	
 	++simplify_elapsed_;
 	
-	if (simplification_interval_ != -1)
+#ifdef _OPENMP
+	bool in_background = !running_coalescence_checks_;
+#endif
+	
+	if (simplification_memory_ > 0)
+	{
+		// With a memory budget, we project the table memory in use at the end of the next generation, assuming that the
+		// tables grow by as much as they did over this generation, and simplify now if that projection exceeds the budget.
+		// This measures the rows in use, not the memory allocated; tskit does not release memory when tables shrink, so the
+		// allocation stays near its peak, which this keeps within the budget (apart from allocation granularity).
+		size_t table_memory = MemoryUsageForTables(tables_, true);
+		size_t growth = (table_memory > simplify_last_table_memory_) ? (table_memory - simplify_last_table_memory_) : 0;
+		
+		simplify_last_table_memory_ = table_memory;
+		
+		if (table_memory + growth > simplification_memory_)
+		{
+#ifdef _OPENMP
+			if (in_background)
+			{
+				StartBackgroundSimplification();
+				return;
+			}
+#endif
+			
+			SimplifyTreeSequence();
+		}
+	}
+	else if (simplification_interval_ != -1)
 	{
 		// BCH 4/5/2019: Adding support for a chosen simplification interval rather than a ratio.  A value of -1
 		// means the simplification ratio is being used, as implemented below; any other value is a target interval.
 		if ((simplify_elapsed_ >= 1) && (simplify_elapsed_ >= simplification_interval_))
 		{
+#ifdef _OPENMP
+			if (in_background)
+			{
+				StartBackgroundSimplification();
+				return;
+			}
+#endif
+			
 			SimplifyTreeSequence();
 		}
 	}
@@ -5160,51 +6004,22 @@ void SLiMSim::CheckAutoSimplification(void)
 	{
 		if (simplify_elapsed_ >= simplify_interval_)
 		{
-			// We could, in principle, calculate actual memory used based on number of rows * sizeof(column), etc.,
-			// but that seems like overkill; adding together the number of rows in all the tables should be a
-			// reasonable proxy, and this whole thing is just a heuristic that needs to be tailored anyway.
-			uint64_t old_table_size = (uint64_t)tables_.nodes.num_rows;
-            old_table_size += (uint64_t)tables_.edges.num_rows;
-            old_table_size += (uint64_t)tables_.sites.num_rows;
-            old_table_size += (uint64_t)tables_.mutations.num_rows;
-			
-			SimplifyTreeSequence();
+			uint64_t old_table_size = TableSizeForSimplification(tables_);
 			
-			uint64_t new_table_size = (uint64_t)tables_.nodes.num_rows;
-            new_table_size += (uint64_t)tables_.edges.num_rows;
-            new_table_size += (uint64_t)tables_.sites.num_rows;
-            new_table_size += (uint64_t)tables_.mutations.num_rows;
-			double ratio = old_table_size / (double)new_table_size;
-			
-			//std::cout << "auto-simplified in generation " << generation_ << "; old size " << old_table_size << ", new size " << new_table_size;
-			//std::cout << "; ratio " << ratio << ", target " << simplification_ratio_ << std::endl;
-			//std::cout << "old interval " << simplify_interval_ << ", new interval ";
-			
-			// Adjust our automatic simplification interval based upon the observed change in storage space used.
-			// Not sure if this is exactly what we want to do; this will hunt around a lot without settling on a value,
-			// but that seems harmless.  The scaling factor of 1.2 is chosen somewhat arbitrarily; we want it to be
-			// large enough that we will arrive at the optimum interval before too terribly long, but small enough
-			// that we have some granularity, so that once we reach the optimum we don't fluctuate too much.
-			if (ratio < simplification_ratio_)
+#ifdef _OPENMP
+			if (in_background)
 			{
-				// We simplified too soon; wait a little longer next time
-				simplify_interval_ *= 1.2;
-				
-				// Impose a maximum interval of 1000, so we don't get caught flat-footed if model demography changes
-				if (simplify_interval_ > 1000.0)
-					simplify_interval_ = 1000.0;
-			}
-			else if (ratio > simplification_ratio_)
-			{
-				// We simplified too late; wait a little less long next time
-				simplify_interval_ /= 1.2;
-				
-				// Impose a minimum interval of 1.0, just to head off weird underflow issues
-				if (simplify_interval_ < 1.0)
-					simplify_interval_ = 1.0;
+				// the interval is adjusted when the simplification finishes, which is before it is next consulted
+				StartBackgroundSimplification();
+				simplify_old_table_size_ = old_table_size;
+				simplify_adjusts_interval_ = simplify_thread_.joinable();
+				return;
 			}
+#endif
+			
+			SimplifyTreeSequence();
 			
-			//std::cout << simplify_interval_ << std::endl;
+			AdjustSimplificationInterval(old_table_size, TableSizeForSimplification(tables_));
 		}
 	}
 }
@@ -5228,6 +6043,8 @@ void SLiMSim::TreeSequenceDataFromAscii(std::string NodeFileName,
 	int ret = tsk_table_collection_init(&tables_, 0);
 	if (ret != 0) handle_error("TreeSequenceDataFromAscii()", ret);
 	
+	sorted_edge_count_ = 0;
+	
 	ret = table_collection_load_text(&tables_,
 									 MspTxtNodeTable,
 									 MspTxtEdgeTable,
@@ -5891,6 +6708,10 @@ void SLiMSim::AddIndividualsToTable(Individual * const *p_individual, size_t p_n
 	if (p_tables == nullptr)
 		p_tables = &tables_;
 	
+	// the individuals' genomes, and the remembered genomes, may be in the tables being simplified in the background
+	if (p_tables == &tables_)
+		FinishBackgroundSimplification();
+	
 	// construct the map of currently remembered individuals first; these are not really just those
 	// that are "remembered", but all individuals that are currently in the tables
 	// BCH 16 Nov. 2019: Making this into an unordered_map for faster lookup; this can end up
@@ -6513,7 +7334,7 @@ void SLiMSim::ReadProvenanceTable(tsk_table_collection_t *p_tables, slim_generat
 #endif
 }
 
-void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binary, bool p_simplify, bool p_include_model)
+void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binary, bool p_simplify, bool p_include_model, bool p_in_place, bool p_compress)
 {
 #if DEBUG
 	if (!recording_tree_)
@@ -6528,6 +7349,9 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 	// Standardize the path, resolving a leading ~ and maybe other things
 	std::string path = Eidos_ResolvedPath(Eidos_StripTrailingSlash(p_recording_tree_path));
 	
+	// A pending background simplification needs to be folded in first
+	FinishBackgroundSimplification();
+	
 	// Add a population (i.e., subpopulation) table to the table collection; subpopulation information
 	// comes from the time of output.  This needs to happen before simplify/sort.
 	WritePopulationTable(&tables_);
@@ -6542,29 +7366,36 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 	else
 	{
         // this is done by SimplifyTreeSequence() but we need to do in any case
-		ret = tsk_table_collection_sort(&tables_, /* edge_start */ 0, /* flags */ 0);
-        if (ret < 0) handle_error("tsk_table_collection_sort", ret);
+		SortTreeSequenceTables();
 		
         // Remove redundant sites we added
         ret = tsk_table_collection_deduplicate_sites(&tables_, 0);
         if (ret < 0) handle_error("tsk_table_collection_deduplicate_sites", ret);
     }
 	
-	// Copy the table collection so that modifications we do for writing don't affect the original tables
-	tsk_table_collection_t output_tables;
-	ret = tsk_table_collection_copy(&tables_, &output_tables, 0);
-	if (ret < 0) handle_error("tsk_table_collection_copy", ret);
+	// Copy the table collection so that modifications we do for writing don't affect the original tables.  When writing in
+	// place we modify tables_ itself instead, which avoids holding a second copy of the tables in memory; the tables are
+	// then unusable for further recording, so recording ends after the write (see below).
+	tsk_table_collection_t output_tables_copy;
+	tsk_table_collection_t *output_tables = &tables_;
+	
+	if (!p_in_place)
+	{
+		ret = tsk_table_collection_copy(&tables_, &output_tables_copy, 0);
+		if (ret < 0) handle_error("tsk_table_collection_copy", ret);
+		output_tables = &output_tables_copy;
+	}
 	
 	// Add in the mutation.parent information; valid tree sequences need parents, but we don't keep them while running
-	ret = tsk_table_collection_build_index(&output_tables, 0);
+	ret = tsk_table_collection_build_index(output_tables, 0);
 	if (ret < 0) handle_error("tsk_table_collection_build_index", ret);
-	ret = tsk_table_collection_compute_mutation_parents(&output_tables, 0);
+	ret = tsk_table_collection_compute_mutation_parents(output_tables, 0);
 	if (ret < 0) handle_error("tsk_table_collection_compute_mutation_parents", ret);
 	
 	// Add information about the current generation to the individual table; 
 	// this modifies "remembered" individuals, since information comes from the
 	// time of output, not creation
-	AddCurrentGenerationToIndividuals(&output_tables);
+	AddCurrentGenerationToIndividuals(output_tables);
 
 	// We need the individual table's order, for alive individuals, to match that of
 	// SLiM so that when we read back in it doesn't cause a reordering as a side effect
@@ -6577,59 +7408,64 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 		for (Individual *individual : subpop->parent_individuals_)
 		{
 			tsk_id_t node_id = individual->genome1_->tsk_node_id_;
-			tsk_id_t ind_id = output_tables.nodes.individual[node_id];
+			tsk_id_t ind_id = output_tables->nodes.individual[node_id];
 			
 			individual_map.push_back(ind_id);
 		}
 	}
 
 	// all other individuals in the table will be retained, at the end
-	ReorderIndividualTable(&output_tables, individual_map, true);
+	ReorderIndividualTable(output_tables, individual_map, true);
 	
 	// Unmark "first generation" nodes as samples (but, retaining their information!)
-	UnmarkFirstGenerationSamples(&output_tables);
+	UnmarkFirstGenerationSamples(output_tables);
 	
 	// Rebase the times in the nodes to be in tskit-land; see _InstantiateSLiMObjectsFromTables() for the inverse operation
 	// BCH 4/4/2019: switched to using tree_seq_generation_ to avoid a parent/child timestamp conflict
 	// This makes sense; as far as tree-seq recording is concerned, tree_seq_generation_ is the generation counter
 	slim_generation_t time_adjustment = tree_seq_generation_;
 	
-	for (size_t node_index = 0; node_index < output_tables.nodes.num_rows; ++node_index)
-		output_tables.nodes.time[node_index] += time_adjustment;
+	for (size_t node_index = 0; node_index < output_tables->nodes.num_rows; ++node_index)
+		output_tables->nodes.time[node_index] += time_adjustment;
 	
 	// Add a row to the Provenance table to record current state; text format does not allow newlines in the entry,
 	// so we don't prettyprint the JSON when going to text, as a quick fix that avoids quoting the newlines etc.
-    WriteProvenanceTable(&output_tables, /* p_use_newlines */ p_binary, p_include_model);
+    WriteProvenanceTable(output_tables, /* p_use_newlines */ p_binary, p_include_model);
 	
 	// Write out the copied tables
     if (p_binary)
 	{
 		// derived state data must be in ASCII (or unicode) on disk, according to tskit policy
-		DerivedStatesToAscii(&output_tables);
+		DerivedStatesToAscii(output_tables);
+		
+		// The store borrows the table columns rather than copying them, so they are written out directly from the tables
+		// when the store is closed; the tables must therefore not change until then.  With p_compress, kastore encodes
+		// the columns as they are written; _InitializePopulationFromTskitBinaryFile() reads such files back transparently.
+		kastore_t store;
+		
+		ret = kastore_open(&store, path.c_str(), "w", p_compress ? KAS_COMPRESS : 0);
+		if (ret < 0) handle_error("kastore_open", tsk_set_kas_error(ret));
 		
-		tsk_table_collection_dump(&output_tables, path.c_str(), 0);
+		ret = tsk_table_collection_dump_store(output_tables, &store, 0);
+		if (ret < 0) handle_error("tsk_table_collection_dump_store", ret);
 		
-		// In nucleotide-based models, write out the ancestral sequence, re-opening the kastore to append
+		// In nucleotide-based models, write out the ancestral sequence into the same store
 		if (nucleotide_based_)
 		{
 			std::size_t buflen = chromosome_.AncestralSequence()->size();
 			char *buffer;	// kastore needs to provide us with a memory location to which to write the data
-			kastore_t store;
 			
 			buffer = (char *)malloc(buflen);
 			chromosome_.AncestralSequence()->WriteNucleotidesToBuffer(buffer);
 			
-			ret = kastore_open(&store, path.c_str(), "a", 0);
-			if (ret < 0) handle_error("kastore_open", ret);
-				
-			kastore_oputs_int8(&store, "reference_sequence/data", (int8_t *)buffer, buflen, 0);
-			if (ret < 0) handle_error("kastore_oputs_int8", ret);
-			
-			ret = kastore_close(&store);
-			if (ret < 0) handle_error("kastore_close", ret);
+			ret = kastore_oputs_int8(&store, "reference_sequence/data", (int8_t *)buffer, buflen, 0);
+			if (ret < 0) handle_error("kastore_oputs_int8", tsk_set_kas_error(ret));
 			
 			// kastore owns buffer now, so we do not free it
 		}
+		
+		ret = kastore_close(&store);
+		if (ret < 0) handle_error("kastore_close", tsk_set_kas_error(ret));
     }
 	else
 	{
@@ -6639,7 +7475,7 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 		if (success)
 		{
             // first translate the bytes we've put into mutation derived state into printable ascii
-            TreeSequenceDataToAscii(&output_tables);
+            TreeSequenceDataToAscii(output_tables);
 			
 			std::string NodeFileName = path + "/NodeTable.txt";
 			std::string EdgeFileName = path + "/EdgeTable.txt";
@@ -6657,13 +7493,13 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 			FILE *MspTxtPopulationTable = fopen(PopulationFileName.c_str(), "w");
 			FILE *MspTxtProvenanceTable = fopen(ProvenanceFileName.c_str(), "w");
 			
-			tsk_node_table_dump_text(&output_tables.nodes, MspTxtNodeTable);
-			tsk_edge_table_dump_text(&output_tables.edges, MspTxtEdgeTable);
-			tsk_site_table_dump_text(&output_tables.sites, MspTxtSiteTable);
-			tsk_mutation_table_dump_text(&output_tables.mutations, MspTxtMutationTable);
-			tsk_individual_table_dump_text(&output_tables.individuals, MspTxtIndividualTable);
-			tsk_population_table_dump_text(&output_tables.populations, MspTxtPopulationTable);
-			tsk_provenance_table_dump_text(&output_tables.provenances, MspTxtProvenanceTable);
+			tsk_node_table_dump_text(&output_tables->nodes, MspTxtNodeTable);
+			tsk_edge_table_dump_text(&output_tables->edges, MspTxtEdgeTable);
+			tsk_site_table_dump_text(&output_tables->sites, MspTxtSiteTable);
+			tsk_mutation_table_dump_text(&output_tables->mutations, MspTxtMutationTable);
+			tsk_individual_table_dump_text(&output_tables->individuals, MspTxtIndividualTable);
+			tsk_population_table_dump_text(&output_tables->populations, MspTxtPopulationTable);
+			tsk_provenance_table_dump_text(&output_tables->provenances, MspTxtProvenanceTable);
 			
 			fclose(MspTxtNodeTable);
 			fclose(MspTxtEdgeTable);
@@ -6693,8 +7529,20 @@ void SLiMSim::WriteTreeSequence(std::string &p_recording_tree_path, bool p_binar
 		}
     }
 	
-	// Done with our tables copy
-	tsk_table_collection_free(&output_tables);
+	if (p_in_place)
+	{
+		// tables_ has been rebased, reordered, and converted for output, so it cannot be recorded into any further; tree-sequence
+		// recording therefore ends here, and the simulation ends at the end of this generation
+		FreeTreeSequence();
+		recording_tree_ = false;
+		recording_mutations_ = false;
+		sim_declared_finished_ = true;
+	}
+	else
+	{
+		// Done with our tables copy
+		tsk_table_collection_free(output_tables);
+	}
 }	
 
 
@@ -6707,8 +7555,12 @@ void SLiMSim::FreeTreeSequence(void)
 	
 	// Free any tree-sequence recording stuff that has been allocated; called when SLiMSim is getting deallocated,
 	// and also when we're wiping the slate clean with something like readFromPopulationFile().
+	DiscardBackgroundSimplification();
 	tsk_table_collection_free(&tables_);
 	
+	ClearStagedTableRows();
+	sorted_edge_count_ = 0;
+	
 	remembered_genomes_.clear();
 }
 
@@ -6818,6 +7670,7 @@ void SLiMSim::DumpMutationTable(void)
 #endif
 	
 	// Dump for debugging; should not be called in production code!
+	FinishBackgroundSimplification();
 	
 	tsk_mutation_table_t &mutations = tables_.mutations;
 	
@@ -6860,6 +7713,8 @@ void SLiMSim::CrosscheckTreeSeqIntegrity(void)
 		EIDOS_TERMINATION << "ERROR (SLiMSim::CrosscheckTreeSeqIntegrity): (internal error) tree sequence recording method called with recording off." << EidosTerminate();
 #endif
 	
+	FinishBackgroundSimplification();
+	
 	// first crosscheck the substitutions multimap against SLiM's substitutions vector
 	{
 		std::vector<Substitution *> vector_subs = population_.substitutions_;
@@ -7622,7 +8477,7 @@ void SLiMSim::__TabulateMutationsFromTables(std::unordered_map<slim_mutationid_t
 	}
 }
 
-void SLiMSim::__TallyMutationReferencesWithTreeSequence(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutMap, std::unordered_map<tsk_id_t, Genome *> p_nodeToGenomeMap, tsk_treeseq_t *p_ts)
+void SLiMSim::__TallyMutationReferencesWithTreeSequence(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutMap, const std::unordered_map<tsk_id_t, Genome *> &p_nodeToGenomeMap, tsk_treeseq_t *p_ts)
 {
 	// allocate and set up the vargen object we'll use to walk through variants
 	tsk_vargen_t *vg;
@@ -7775,8 +8630,7 @@ void SLiMSim::__CreateMutationsFromTabulation(std::unordered_map<slim_mutationid
 			population_.mutation_registry_.emplace_back(new_mut_index);
 			
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-			if (population_.keeping_muttype_registries_)
-				EIDOS_TERMINATION << "ERROR (SLiMSim::__CreateMutationsFromTabulation): (internal error) separate muttype registries set up during pop load." << EidosTerminate();
+			mutation_type_ptr->AddToMuttypeRegistry(new_mut_index);
 #endif
 		}
 		
@@ -7789,7 +8643,30 @@ void SLiMSim::__CreateMutationsFromTabulation(std::unordered_map<slim_mutationid
 	}
 }
 
-void SLiMSim::__AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mutationid_t, MutationIndex> &p_mutIndexMap, std::unordered_map<tsk_id_t, Genome *> p_nodeToGenomeMap, tsk_treeseq_t *p_ts)
+// One allele of a variant being loaded, resolved to MutationIndex values once for all the genomes that carry it; see
+// __AddMutationsFromTreeSequenceToGenomes().  Errors are recorded rather than raised, so they can be raised only if some
+// genome actually carries the allele, as before, and so that they are never raised inside a parallel region.
+typedef struct ts_allele_info {
+	size_t mut_indices_start;			// the index of the allele's first MutationIndex in the batch's mut_indices vector
+	size_t mut_indices_count;			// the number of MutationIndex values for the allele (fixed mutations are omitted)
+	size_t mut_id_count;				// the number of mutation ids in the allele, including fixed mutations
+	int error;							// 0 for no error, or one of the kAlleleError values below
+	slim_mutationid_t error_mut_id;		// the missing mutation id, for kAlleleErrorMissingMutation
+} ts_allele_info;
+
+enum {
+	kAlleleErrorBadLength = 1,
+	kAlleleErrorNullGenome,
+	kAlleleErrorMissingMutation
+};
+
+#ifdef _OPENMP
+// Genomes are filled by multiple threads only when there are at least this many samples; below this, filling one batch
+// of variants is too little work to be worth starting threads for
+static const size_t SLIM_LOAD_PARALLEL_MIN_SAMPLES = 2000;
+#endif
+
+void SLiMSim::__AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mutationid_t, MutationIndex> &p_mutIndexMap, const std::unordered_map<tsk_id_t, Genome *> &p_nodeToGenomeMap, tsk_treeseq_t *p_ts)
 {
 	// This code is based on SLiMSim::CrosscheckTreeSeqIntegrity(), but it can be much simpler.
 	// We also don't need to sort/deduplicate/simplify; the tables read in should be simplified already.
@@ -7825,6 +8702,122 @@ void SLiMSim::__AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mu
 		}
 	}
 	
+	// Walking the variants with vargen is inherently sequential, but it is a small part of the work; most of
+	// the time goes to putting the mutations into the genomes.  So we gather the variants into batches, each covering an
+	// interval of the chromosome within a single mutation run, resolve each allele to its MutationIndex values once per
+	// batch, and then fill the genomes from the batch.  Each genome modifies only one of its runs per batch, and no two
+	// genomes share a run after WillModifyRun(), so with OpenMP the genomes can be filled by separate threads; only
+	// WillModifyRun() itself, which uses shared pools and reference counts, needs to be serialized.  The batch size is
+	// capped to bound the memory used for copies of the genotypes.
+	const size_t max_batch_variants = std::max((size_t)1, (size_t)(16 * 1024 * 1024) / (sample_count * sizeof(uint16_t) + 1));
+	std::vector<uint16_t> batch_genotypes;				// genotypes for each variant in the batch, sample_count per variant
+	std::vector<size_t> batch_allele_starts;			// the index in batch_alleles of the first allele for each variant
+	std::vector<ts_allele_info> batch_alleles;			// the alleles for all the variants in the batch
+	std::vector<MutationIndex> batch_mut_indices;		// MutationIndex values for all the alleles in the batch
+	std::vector<MutationRun *> batch_mutruns(sample_count, nullptr);	// the run being filled in each genome, once it is modified
+	slim_mutrun_index_t batch_run_index = -1;
+	slim_position_t mutrun_length = chromosome_.mutrun_length_;
+	int error = 0;
+	slim_mutationid_t error_mut_id = -1;
+	size_t error_mut_id_count = 0;
+	
+	auto fill_genomes_from_batch = [&](void)
+	{
+		size_t batch_count = batch_allele_starts.size();
+		
+		if (batch_count == 0)
+			return;
+		
+		// genomes are processed in blocks, and within a block variant by variant, so that the genotypes are read in order
+		const size_t block_size = 1024;
+		size_t block_count = (sample_count + block_size - 1) / block_size;
+		
+		std::fill(batch_mutruns.begin(), batch_mutruns.end(), nullptr);
+		
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(sample_count >= SLIM_LOAD_PARALLEL_MIN_SAMPLES)
+#endif
+		for (size_t block_index = 0; block_index < block_count; ++block_index)
+		{
+			size_t block_start = block_index * block_size;
+			size_t block_end = std::min(block_start + block_size, sample_count);
+			
+			for (size_t batch_index = 0; batch_index < batch_count; ++batch_index)
+			{
+				const uint16_t *genotypes = batch_genotypes.data() + batch_index * sample_count;
+				const ts_allele_info *alleles = batch_alleles.data() + batch_allele_starts[batch_index];
+				
+				for (size_t sample_index = block_start; sample_index < block_end; sample_index++)
+				{
+					const ts_allele_info &allele = alleles[genotypes[sample_index]];
+					
+					if ((allele.mut_id_count == 0) && (allele.error == 0))
+						continue;
+					
+					Genome *genome = indexToGenomeMap[sample_index];
+					
+					if (!genome)
+						continue;
+					
+					int allele_error = allele.error;
+					
+					if ((allele_error == 0) && genome->IsNull())
+						allele_error = kAlleleErrorNullGenome;
+					
+					if (allele_error)
+					{
+#ifdef _OPENMP
+#pragma omp critical (AddMutationsFromTreeSequenceToGenomes_error)
+#endif
+						{
+							if (!error)
+							{
+								error = allele_error;
+								error_mut_id = allele.error_mut_id;
+								error_mut_id_count = allele.mut_id_count;
+							}
+						}
+						continue;
+					}
+					
+					if (allele.mut_indices_count == 0)
+						continue;
+					
+					MutationRun *mutrun = batch_mutruns[sample_index];
+					
+					if (!mutrun)
+					{
+#ifdef _OPENMP
+#pragma omp critical (AddMutationsFromTreeSequenceToGenomes_run)
+#endif
+						{
+							genome->WillModifyRun(batch_run_index);
+						}
+						
+						mutrun = genome->mutruns_[batch_run_index].get();
+						batch_mutruns[sample_index] = mutrun;
+					}
+					
+					const MutationIndex *mut_indices = batch_mut_indices.data() + allele.mut_indices_start;
+					
+					for (size_t mutid_index = 0; mutid_index < allele.mut_indices_count; ++mutid_index)
+						mutrun->emplace_back(mut_indices[mutid_index]);
+				}
+			}
+		}
+		
+		if (error == kAlleleErrorBadLength)
+			EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): (internal error) variant allele had length that was not a multiple of sizeof(slim_mutationid_t)." << EidosTerminate();
+		else if (error == kAlleleErrorNullGenome)
+			EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): (internal error) null genome has non-zero treeseq allele length " << error_mut_id_count << "." << EidosTerminate();
+		else if (error == kAlleleErrorMissingMutation)
+			EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): mutation id " << error_mut_id << " was referenced but does not exist." << EidosTerminate();
+		
+		batch_allele_starts.clear();
+		batch_alleles.clear();
+		batch_mut_indices.clear();
+	};
+	
 	// add mutations to genomes by looping through variants
 	do
 	{
@@ -7835,59 +8828,71 @@ void SLiMSim::__AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mu
 		
 		if (ret == 1)
 		{
-			// We have a new variant; set it into SLiM.  A variant represents a site at which a tracked mutation exists.
+			// We have a new variant; add it to the batch.  A variant represents a site at which a tracked mutation exists.
 			// The tsk_variant_t will tell us all the allelic states involved at that site, what the alleles are, and which genomes
 			// in the sample are using them.  We will then set all the genomes that the variant claims to involve to have
 			// the allele the variant attributes to them.  The variants are returned in sorted order by position, so we can
 			// always add new mutations to the ends of genomes.
 			slim_position_t variant_pos_int = (slim_position_t)variant->site->position;
+			slim_mutrun_index_t run_index = (slim_mutrun_index_t)(variant_pos_int / mutrun_length);
+			
+			if ((run_index != batch_run_index) || (batch_allele_starts.size() == max_batch_variants))
+			{
+				fill_genomes_from_batch();
+				batch_run_index = run_index;
+			}
 			
-			for (size_t sample_index = 0; sample_index < sample_count; sample_index++)
+			size_t batch_index = batch_allele_starts.size();
+			
+			batch_allele_starts.push_back(batch_alleles.size());
+			batch_genotypes.resize((batch_index + 1) * sample_count);
+			std::memcpy(batch_genotypes.data() + batch_index * sample_count, variant->genotypes.u16, sample_count * sizeof(uint16_t));
+			
+			for (tsk_size_t allele_index = 0; allele_index < variant->num_alleles; ++allele_index)
 			{
-				Genome *genome = indexToGenomeMap[sample_index];
+				tsk_size_t allele_length = variant->allele_lengths[allele_index];
+				ts_allele_info allele = {batch_mut_indices.size(), 0, allele_length / sizeof(slim_mutationid_t), 0, -1};
 				
-				if (genome)
+				if (allele_length % sizeof(slim_mutationid_t) != 0)
 				{
-					uint16_t genome_variant = variant->genotypes.u16[sample_index];
-					tsk_size_t genome_allele_length = variant->allele_lengths[genome_variant];
+					allele.error = kAlleleErrorBadLength;
+				}
+				else
+				{
+					const slim_mutationid_t *allele_mut_ids = (const slim_mutationid_t *)variant->alleles[allele_index];
 					
-					if (genome_allele_length % sizeof(slim_mutationid_t) != 0)
-						EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): (internal error) variant allele had length that was not a multiple of sizeof(slim_mutationid_t)." << EidosTerminate();
-					genome_allele_length /= sizeof(slim_mutationid_t);
+					allele_length /= sizeof(slim_mutationid_t);
 					
-					if (genome_allele_length > 0)
+					for (tsk_size_t mutid_index = 0; mutid_index < allele_length; ++mutid_index)
 					{
-						if (genome->IsNull())
-							EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): (internal error) null genome has non-zero treeseq allele length " << genome_allele_length << "." << EidosTerminate();
-						
-						slim_mutationid_t *genome_allele = (slim_mutationid_t *)variant->alleles[genome_variant];
-						slim_mutrun_index_t run_index = (slim_mutrun_index_t)(variant_pos_int / genome->mutrun_length_);
-						
-						genome->WillModifyRun(run_index);
+						slim_mutationid_t mut_id = allele_mut_ids[mutid_index];
+						auto mut_index_iter = p_mutIndexMap.find(mut_id);
 						
-						MutationRun *mutrun = genome->mutruns_[run_index].get();
-						
-						for (tsk_size_t mutid_index = 0; mutid_index < genome_allele_length; ++mutid_index)
+						if (mut_index_iter == p_mutIndexMap.end())
 						{
-							slim_mutationid_t mut_id = genome_allele[mutid_index];
-							auto mut_index_iter = p_mutIndexMap.find(mut_id);
-							
-							if (mut_index_iter == p_mutIndexMap.end())
-								EIDOS_TERMINATION << "ERROR (SLiMSim::__AddMutationsFromTreeSequenceToGenomes): mutation id " << mut_id << " was referenced but does not exist." << EidosTerminate();
-							
-							// Add the mutation to the genome unless it is fixed (mut_index == -1)
-							MutationIndex mut_index = mut_index_iter->second;
-							
-							if (mut_index != -1)
-								mutrun->emplace_back(mut_index);
+							allele.error = kAlleleErrorMissingMutation;
+							allele.error_mut_id = mut_id;
+							break;
 						}
+						
+						// Add the mutation to the genome unless it is fixed (mut_index == -1)
+						MutationIndex mut_index = mut_index_iter->second;
+						
+						if (mut_index != -1)
+							batch_mut_indices.push_back(mut_index);
 					}
+					
+					allele.mut_indices_count = batch_mut_indices.size() - allele.mut_indices_start;
 				}
+				
+				batch_alleles.push_back(allele);
 			}
 		}
 	}
 	while (ret != 0);
 	
+	fill_genomes_from_batch();
+	
 	// free
 	ret = tsk_vargen_free(vg);
 	if (ret != 0) handle_error("__AddMutationsFromTreeSequenceToGenomes tsk_vargen_free()", ret);
@@ -8013,7 +9018,7 @@ slim_generation_t SLiMSim::_InstantiateSLiMObjectsFromTables(EidosInterpreter *p
 	
 	// Re-tally mutation references so we have accurate frequency counts for our new mutations
 	population_.UniqueMutationRuns();
-	population_.TallyMutationReferences(nullptr, true);
+	population_.TallyMutationReferences(true);
 	
 	// Do a crosscheck to ensure data integrity
 	// BCH 10/16/2019: this crosscheck can take a significant amount of time; for a single load that is not a big deal,
@@ -8101,9 +9106,12 @@ slim_generation_t SLiMSim::_InitializePopulationFromTskitBinaryFile(const char *
 #else
 	// WORKAROUND
 	// read the file from disk into a private table collection that is immutable
+	// The file is memory-mapped rather than read into a buffer, so the immutable tables are just views onto the
+	// page cache.  The copy into tables_ below is then the only copy made.  The mapping is released as soon as the
+	// reference sequence has been read, before DerivedStatesFromAscii() allocates its own scratch space.
 	tsk_table_collection_t immutable_tables;
 	
-	int ret = tsk_table_collection_load(&immutable_tables, p_file, 0);
+	int ret = tsk_table_collection_load(&immutable_tables, p_file, TSK_LOAD_MMAP);
 	if (ret != 0) handle_error("tsk_table_collection_load", ret);
 	
 	// BCH 4/25/2019: if indexes are present on immutable_tables we want to drop them; they are synced up
@@ -8115,11 +9123,6 @@ slim_generation_t SLiMSim::_InitializePopulationFromTskitBinaryFile(const char *
 	// copy the immutable table collection to make a mutable collection
 	ret = tsk_table_collection_copy(&immutable_tables, &tables_, 0);
 	if (ret < 0) handle_error("tsk_table_collection_copy", ret);
-
-	RecordTablePosition();
-	
-	// convert ASCII derived-state data, which is the required format on disk, back to our in-memory binary format
-	DerivedStatesFromAscii(&tables_);
 	
 	// in nucleotide-based models, read the ancestral sequence from the open kastore of immutable_tables
 	if (nucleotide_based_)
@@ -8145,122 +9148,130 @@ slim_generation_t SLiMSim::_InitializePopulationFromTskitBinaryFile(const char *
 	tsk_table_collection_free(&immutable_tables);
 #endif
 	
+	sorted_edge_count_ = 0;
+	
+	RecordTablePosition();
+	
+	// convert ASCII derived-state data, which is the required format on disk, back to our in-memory binary format
+	DerivedStatesFromAscii(&tables_);
+	
 	// make the corresponding SLiM objects
 	return _InstantiateSLiMObjectsFromTables(p_interpreter);
 }
 
-size_t SLiMSim::MemoryUsageForTables(tsk_table_collection_t &p_tables)
+size_t SLiMSim::MemoryUsageForTables(tsk_table_collection_t &p_tables, bool p_in_use)
 {
+	// This counts the memory allocated for the tables; if p_in_use is true, it counts only the memory used by their rows
 	tsk_table_collection_t &t = p_tables;
 	size_t usage = 0;
 	
 	usage += sizeof(tsk_individual_table_t);
 	
 	if (t.individuals.flags)
-		usage += t.individuals.max_rows * sizeof(uint32_t);
+		usage += (p_in_use ? t.individuals.num_rows : t.individuals.max_rows) * sizeof(uint32_t);
 	if (t.individuals.location_offset)
-		usage += t.individuals.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.individuals.num_rows : t.individuals.max_rows) * sizeof(tsk_size_t);
 	if (t.individuals.metadata_offset)
-		usage += t.individuals.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.individuals.num_rows : t.individuals.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.individuals.location)
-		usage += t.individuals.max_location_length * sizeof(double);
+		usage += (p_in_use ? t.individuals.location_length : t.individuals.max_location_length) * sizeof(double);
 	if (t.individuals.metadata)
-		usage += t.individuals.max_metadata_length * sizeof(char);
+		usage += (p_in_use ? t.individuals.metadata_length : t.individuals.max_metadata_length) * sizeof(char);
 	
 	usage += sizeof(tsk_node_table_t);
 	
 	if (t.nodes.flags)
-		usage += t.nodes.max_rows * sizeof(uint32_t);
+		usage += (p_in_use ? t.nodes.num_rows : t.nodes.max_rows) * sizeof(uint32_t);
 	if (t.nodes.time)
-		usage += t.nodes.max_rows * sizeof(double);
+		usage += (p_in_use ? t.nodes.num_rows : t.nodes.max_rows) * sizeof(double);
 	if (t.nodes.population)
-		usage += t.nodes.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.nodes.num_rows : t.nodes.max_rows) * sizeof(tsk_id_t);
 	if (t.nodes.individual)
-		usage += t.nodes.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.nodes.num_rows : t.nodes.max_rows) * sizeof(tsk_id_t);
 	if (t.nodes.metadata_offset)
-		usage += t.nodes.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.nodes.num_rows : t.nodes.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.nodes.metadata)
-		usage += t.nodes.max_metadata_length * sizeof(char);
+		usage += (p_in_use ? t.nodes.metadata_length : t.nodes.max_metadata_length) * sizeof(char);
 	
 	usage += sizeof(tsk_edge_table_t);
 	
 	if (t.edges.left)
-		usage += t.edges.max_rows * sizeof(double);
+		usage += (p_in_use ? t.edges.num_rows : t.edges.max_rows) * sizeof(double);
 	if (t.edges.right)
-		usage += t.edges.max_rows * sizeof(double);
+		usage += (p_in_use ? t.edges.num_rows : t.edges.max_rows) * sizeof(double);
 	if (t.edges.parent)
-		usage += t.edges.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.edges.num_rows : t.edges.max_rows) * sizeof(tsk_id_t);
 	if (t.edges.child)
-		usage += t.edges.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.edges.num_rows : t.edges.max_rows) * sizeof(tsk_id_t);
 	
 	usage += sizeof(tsk_migration_table_t);
 	
 	if (t.migrations.source)
-		usage += t.migrations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(tsk_id_t);
 	if (t.migrations.dest)
-		usage += t.migrations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(tsk_id_t);
 	if (t.migrations.node)
-		usage += t.migrations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(tsk_id_t);
 	if (t.migrations.left)
-		usage += t.migrations.max_rows * sizeof(double);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(double);
 	if (t.migrations.right)
-		usage += t.migrations.max_rows * sizeof(double);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(double);
 	if (t.migrations.time)
-		usage += t.migrations.max_rows * sizeof(double);
+		usage += (p_in_use ? t.migrations.num_rows : t.migrations.max_rows) * sizeof(double);
 	
 	usage += sizeof(tsk_site_table_t);
 	
 	if (t.sites.position)
-		usage += t.sites.max_rows * sizeof(double);
+		usage += (p_in_use ? t.sites.num_rows : t.sites.max_rows) * sizeof(double);
 	if (t.sites.ancestral_state_offset)
-		usage += t.sites.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.sites.num_rows : t.sites.max_rows) * sizeof(tsk_size_t);
 	if (t.sites.metadata_offset)
-		usage += t.sites.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.sites.num_rows : t.sites.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.sites.ancestral_state)
-		usage += t.sites.max_ancestral_state_length * sizeof(char);
+		usage += (p_in_use ? t.sites.ancestral_state_length : t.sites.max_ancestral_state_length) * sizeof(char);
 	if (t.sites.metadata)
-		usage += t.sites.max_metadata_length * sizeof(char);
+		usage += (p_in_use ? t.sites.metadata_length : t.sites.max_metadata_length) * sizeof(char);
 	
 	usage += sizeof(tsk_mutation_table_t);
 	
 	if (t.mutations.node)
-		usage += t.mutations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.mutations.num_rows : t.mutations.max_rows) * sizeof(tsk_id_t);
 	if (t.mutations.site)
-		usage += t.mutations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.mutations.num_rows : t.mutations.max_rows) * sizeof(tsk_id_t);
 	if (t.mutations.parent)
-		usage += t.mutations.max_rows * sizeof(tsk_id_t);
+		usage += (p_in_use ? t.mutations.num_rows : t.mutations.max_rows) * sizeof(tsk_id_t);
 	if (t.mutations.derived_state_offset)
-		usage += t.mutations.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.mutations.num_rows : t.mutations.max_rows) * sizeof(tsk_size_t);
 	if (t.mutations.metadata_offset)
-		usage += t.mutations.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.mutations.num_rows : t.mutations.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.mutations.derived_state)
-		usage += t.mutations.max_derived_state_length * sizeof(char);
+		usage += (p_in_use ? t.mutations.derived_state_length : t.mutations.max_derived_state_length) * sizeof(char);
 	if (t.mutations.metadata)
-		usage += t.mutations.max_metadata_length * sizeof(char);
+		usage += (p_in_use ? t.mutations.metadata_length : t.mutations.max_metadata_length) * sizeof(char);
 	
 	usage += sizeof(tsk_population_table_t);
 	
 	if (t.populations.metadata_offset)
-		usage += t.populations.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.populations.num_rows : t.populations.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.populations.metadata)
-		usage += t.populations.max_metadata_length * sizeof(char);
+		usage += (p_in_use ? t.populations.metadata_length : t.populations.max_metadata_length) * sizeof(char);
 	
 	usage += sizeof(tsk_provenance_table_t);
 	
 	if (t.provenances.timestamp_offset)
-		usage += t.provenances.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.provenances.num_rows : t.provenances.max_rows) * sizeof(tsk_size_t);
 	if (t.provenances.record_offset)
-		usage += t.provenances.max_rows * sizeof(tsk_size_t);
+		usage += (p_in_use ? t.provenances.num_rows : t.provenances.max_rows) * sizeof(tsk_size_t);
 	
 	if (t.provenances.timestamp)
-		usage += t.provenances.max_timestamp_length * sizeof(char);
+		usage += (p_in_use ? t.provenances.timestamp_length : t.provenances.max_timestamp_length) * sizeof(char);
 	if (t.provenances.record)
-		usage += t.provenances.max_record_length * sizeof(char);
+		usage += (p_in_use ? t.provenances.record_length : t.provenances.max_record_length) * sizeof(char);
 	
 	usage += remembered_genomes_.size() * sizeof(tsk_id_t);
 	
@@ -8377,38 +9388,28 @@ EidosValue_SP SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides(con
 				if (!file_stream.is_open())
 					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): the file at path " << sequence_string << " could not be opened or does not exist." << EidosTerminate();
 				
-				bool started_sequence = false;
-				std::string line, fasta_sequence;
-				
-				while (getline(file_stream, line))
-				{
-					// skippable lines are blank or start with a '>' or ';'
-					// we skip over them if they're at the start of the file; once we start a sequence, they terminate the sequence
-					bool skippable = ((line.length() == 0) || (line[0] == '>') || (line[0] == ';'));
-					
-					if (!started_sequence && skippable)
-						continue;
-					if (skippable)
-						break;
-					
-					// otherwise, append the nucleotides from this line, removing a \r if one is present at the end of the line
-					if (line.back() == '\r')
-						line.pop_back();
-					
-					fasta_sequence.append(line);
-					started_sequence = true;
-				}
+				// The file size is an upper bound on the sequence length, and lets the packed buffer be allocated up front;
+				// the sequence is then packed directly as it is read, without building up a std::string copy of it
+				file_stream.seekg(0, std::ios_base::end);
 				
-				if (file_stream.bad())
-					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): a filesystem error occurred while reading the file at path " << sequence_string << "." << EidosTerminate();
+				std::streamoff file_size = file_stream.tellg();
 				
-				if (fasta_sequence.length() == 0)
-					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): no FASTA sequence found in " << sequence_string << "." << EidosTerminate();
+				file_stream.seekg(0, std::ios_base::beg);
 				
 				try {
-					chromosome_.ancestral_seq_buffer_ = new NucleotideArray(fasta_sequence.length(), fasta_sequence.c_str());
-				} catch (...) {
+					chromosome_.ancestral_seq_buffer_ = new NucleotideArray(file_stream, (file_size > 0) ? (std::size_t)file_size : 0);
+				} catch (std::out_of_range &) {
 					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): FASTA sequence data must contain only the nucleotides ACGT." << EidosTerminate();
+				} catch (...) {
+					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): a filesystem error occurred while reading the file at path " << sequence_string << "." << EidosTerminate();
+				}
+				
+				if (chromosome_.ancestral_seq_buffer_->size() == 0)
+				{
+					delete chromosome_.ancestral_seq_buffer_;
+					chromosome_.ancestral_seq_buffer_ = nullptr;
+					
+					EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeAncestralNucleotides): no FASTA sequence found in " << sequence_string << "." << EidosTerminate();
 				}
 			}
 		}
@@ -9530,7 +10531,7 @@ EidosValue_SP SLiMSim::ExecuteContextFunction_initializeSLiMOptions(const std::s
 }
 
 // TREE SEQUENCE RECORDING
-//	*********************	(void)initializeTreeSeq([logical$ recordMutations = T], [Nif$ simplificationRatio = NULL], [Ni$ simplificationInterval = NULL], [logical$ checkCoalescence = F], [logical$ runCrosschecks = F])
+//	*********************	(void)initializeTreeSeq([logical$ recordMutations = T], [Nif$ simplificationRatio = NULL], [Ni$ simplificationInterval = NULL], [logical$ checkCoalescence = F], [logical$ runCrosschecks = F], [Nif$ simplificationMemory = NULL])
 //
 EidosValue_SP SLiMSim::ExecuteContextFunction_initializeTreeSeq(const std::string &p_function_name, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter)
 {
@@ -9540,6 +10541,7 @@ EidosValue_SP SLiMSim::ExecuteContextFunction_initializeTreeSeq(const std::strin
 	EidosValue *arg_simplificationInterval_value = p_arguments[2].get();
 	EidosValue *arg_checkCoalescence_value = p_arguments[3].get();
 	EidosValue *arg_runCrosschecks_value = p_arguments[4].get();
+	EidosValue *arg_simplificationMemory_value = p_arguments[5].get();
 	std::ostream &output_stream = p_interpreter.ExecutionOutputStream();
 	
 	if (num_treeseq_declarations_ > 0)
@@ -9554,7 +10556,21 @@ EidosValue_SP SLiMSim::ExecuteContextFunction_initializeTreeSeq(const std::strin
 	running_treeseq_crosschecks_ = arg_runCrosschecks_value->LogicalAtIndex(0, nullptr);
 	treeseq_crosschecks_interval_ = 1;		// this interval is presently not exposed in the Eidos API
 	
-	if ((arg_simplificationRatio_value->Type() == EidosValueType::kValueNULL) && (arg_simplificationInterval_value->Type() == EidosValueType::kValueNULL))
+	if (arg_simplificationMemory_value->Type() != EidosValueType::kValueNULL)
+	{
+		// A memory budget is used instead of a ratio or interval; see CheckAutoSimplification()
+		if ((arg_simplificationRatio_value->Type() != EidosValueType::kValueNULL) || (arg_simplificationInterval_value->Type() != EidosValueType::kValueNULL))
+			EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeTreeSeq): initializeTreeSeq() does not allow simplificationMemory to be combined with simplificationRatio or simplificationInterval." << EidosTerminate();
+		
+		simplification_memory_ = arg_simplificationMemory_value->FloatAtIndex(0, nullptr);
+		simplification_ratio_ = INFINITY;
+		simplification_interval_ = -1;
+		simplify_interval_ = 20;
+		
+		if (std::isnan(simplification_memory_) || (simplification_memory_ <= 0))
+			EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteContextFunction_initializeTreeSeq): initializeTreeSeq() requires simplificationMemory to be > 0." << EidosTerminate();
+	}
+	else if ((arg_simplificationRatio_value->Type() == EidosValueType::kValueNULL) && (arg_simplificationInterval_value->Type() == EidosValueType::kValueNULL))
 	{
 		// Both ratio and interval are NULL; use the default behavior of a ratio of 10
 		simplification_ratio_ = 10.0;
@@ -9642,6 +10658,13 @@ EidosValue_SP SLiMSim::ExecuteContextFunction_initializeTreeSeq(const std::strin
 			if (previous_params) output_stream << ", ";
 			output_stream << "runCrosschecks = " << (running_treeseq_crosschecks_ ? "T" : "F");
 			previous_params = true;
+		}
+		
+		if (simplification_memory_ > 0)
+		{
+			if (previous_params) output_stream << ", ";
+			output_stream << "simplificationMemory = " << simplification_memory_;
+			previous_params = true;
 			(void)previous_params;	// dead store above is deliberate
 		}
 		
@@ -9730,7 +10753,7 @@ const std::vector<EidosFunctionSignature_CSP> *SLiMSim::ZeroGenerationFunctionSi
 		sim_0_signatures_.emplace_back((EidosFunctionSignature *)(new EidosFunctionSignature(gStr_initializeSLiMOptions, nullptr, kEidosValueMaskVOID, "SLiM"))
 									   ->AddLogical_OS("keepPedigrees", gStaticEidosValue_LogicalF)->AddString_OS("dimensionality", gStaticEidosValue_StringEmpty)->AddString_OS("periodicity", gStaticEidosValue_StringEmpty)->AddInt_OS("mutationRuns", gStaticEidosValue_Integer0)->AddLogical_OS("preventIncidentalSelfing", gStaticEidosValue_LogicalF)->AddLogical_OS("nucleotideBased", gStaticEidosValue_LogicalF));
 		sim_0_signatures_.emplace_back((EidosFunctionSignature *)(new EidosFunctionSignature(gStr_initializeTreeSeq, nullptr, kEidosValueMaskVOID, "SLiM"))
-									   ->AddLogical_OS("recordMutations", gStaticEidosValue_LogicalT)->AddNumeric_OSN("simplificationRatio", gStaticEidosValueNULL)->AddInt_OSN("simplificationInterval", gStaticEidosValueNULL)->AddLogical_OS("checkCoalescence", gStaticEidosValue_LogicalF)->AddLogical_OS("runCrosschecks", gStaticEidosValue_LogicalF));
+									   ->AddLogical_OS("recordMutations", gStaticEidosValue_LogicalT)->AddNumeric_OSN("simplificationRatio", gStaticEidosValueNULL)->AddInt_OSN("simplificationInterval", gStaticEidosValueNULL)->AddLogical_OS("checkCoalescence", gStaticEidosValue_LogicalF)->AddLogical_OS("runCrosschecks", gStaticEidosValue_LogicalF)->AddNumeric_OSN("simplificationMemory", gStaticEidosValueNULL));
 		sim_0_signatures_.emplace_back((EidosFunctionSignature *)(new EidosFunctionSignature(gStr_initializeSLiMModelType, nullptr, kEidosValueMaskVOID, "SLiM"))
 									   ->AddString_S("modelType"));
 	}
@@ -10244,6 +11267,9 @@ EidosValue_SP SLiMSim::ExecuteInstanceMethod(EidosGlobalStringID p_method_id, co
 		case gID_simulationFinished:			return ExecuteMethod_simulationFinished(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_treeSeqCoalesced:				return ExecuteMethod_treeSeqCoalesced(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_treeSeqSimplify:				return ExecuteMethod_treeSeqSimplify(p_method_id, p_arguments, p_argument_count, p_interpreter);
+		case gID_treeSeqDiversity:
+		case gID_treeSeqDivergence:
+		case gID_treeSeqSFS:					return ExecuteMethod_treeSeqStatistic(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_treeSeqRememberIndividuals:	return ExecuteMethod_treeSeqRememberIndividuals(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		case gID_treeSeqOutput:					return ExecuteMethod_treeSeqOutput(p_method_id, p_arguments, p_argument_count, p_interpreter);
 		default:								return SLiMEidosDictionary::ExecuteInstanceMethod(p_method_id, p_arguments, p_argument_count, p_interpreter);
@@ -10402,18 +11428,19 @@ EidosValue_SP SLiMSim::ExecuteMethod_mutationFreqsCounts(EidosGlobalStringID p_m
 	EidosValue *mutations_value = p_arguments[1].get();
 	
 	slim_refcount_t total_genome_count = 0;
+	const slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
 	
-	// tally across the requested subpops
+	// tally across the requested subpops; tallies for a subset of subpops are cached separately from the whole-population tally
 	if (subpops_value->Type() == EidosValueType::kValueNULL)
 	{
 		// tally across the whole population
-		total_genome_count = population_.TallyMutationReferences(nullptr, false);
+		total_genome_count = population_.TallyMutationReferences(false);
 	}
 	else
 	{
 		// requested subpops, so get them
 		int requested_subpop_count = subpops_value->Count();
-		static std::vector<Subpopulation*> subpops_to_tally;	// using and clearing a static prevents allocation thrash; should be safe from re-entry since TallyMutationReferences() can't re-enter here
+		static std::vector<Subpopulation*> subpops_to_tally;	// using and clearing a static prevents allocation thrash; should be safe from re-entry since TallySubpopMutationReferences() can't re-enter here
 		
 		if (requested_subpop_count)
 		{
@@ -10421,12 +11448,11 @@ EidosValue_SP SLiMSim::ExecuteMethod_mutationFreqsCounts(EidosGlobalStringID p_m
 				subpops_to_tally.emplace_back((Subpopulation *)(subpops_value->ObjectElementAtIndex(requested_subpop_index, nullptr)));
 		}
 		
-		total_genome_count = population_.TallyMutationReferences(&subpops_to_tally, false);
+		total_genome_count = population_.TallySubpopMutationReferences(subpops_to_tally, &refcount_block_ptr);
 		subpops_to_tally.clear();
 	}
 	
 	// OK, now construct our result vector from the tallies for just the requested mutations
-	slim_refcount_t *refcount_block_ptr = gSLiM_Mutation_Refcounts;
 	double denominator = 1.0 / total_genome_count;
 	EidosValue_SP result_SP;
 	
@@ -10522,32 +11548,8 @@ EidosValue_SP SLiMSim::ExecuteMethod_mutationsOfType(EidosGlobalStringID p_metho
 	Mutation *mut_block_ptr = gSLiM_Mutation_Block;
 	
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	// track calls per generation to SLiMSim::ExecuteMethod_mutationsOfType() and SLiMSim::ExecuteMethod_countOfMutationsOfType()
-	bool start_registry = (mutation_type_ptr->muttype_registry_call_count_++ >= 1);
-	population_.any_muttype_call_count_used_ = true;
-	
-	// start a registry if appropriate, so we can hit the fast case below
-	if (start_registry && (!population_.keeping_muttype_registries_ || !mutation_type_ptr->keeping_muttype_registry_))
-	{
-		MutationRun &mutation_registry = population_.mutation_registry_;
-		int mutation_count = mutation_registry.size();
-		MutationRun &muttype_registry = mutation_type_ptr->muttype_registry_;
-		
-		for (int mut_index = 0; mut_index < mutation_count; ++mut_index)
-		{
-			MutationIndex mut = mutation_registry[mut_index];
-			
-			if ((mut_block_ptr + mut)->mutation_type_ptr_ == mutation_type_ptr)
-				muttype_registry.emplace_back(mut);
-		}
-		
-		population_.keeping_muttype_registries_ = true;
-		mutation_type_ptr->keeping_muttype_registry_ = true;
-	}
-	
-	if (population_.keeping_muttype_registries_ && mutation_type_ptr->keeping_muttype_registry_)
 	{
-		// We're already keeping a separate registry for this mutation type (see mutation_type.h), so we can answer this directly
+		// Each mutation type keeps its own registry (see mutation_type.h), so we can answer this directly
 		MutationRun &mutation_registry = mutation_type_ptr->muttype_registry_;
 		int mutation_count = mutation_registry.size();
 		
@@ -10566,10 +11568,9 @@ EidosValue_SP SLiMSim::ExecuteMethod_mutationsOfType(EidosGlobalStringID p_metho
 			return result_SP;
 		}
 	}
-	else
-#endif
+#else
 	{
-		// No registry in the muttype; count the number of mutations of the given type, so we can reserve the right vector size
+		// No registries in muttypes; count the number of mutations of the given type, so we can reserve the right vector size
 		// To avoid having to scan the registry twice for the simplest case of a single mutation, we cache the first mutation found
 		MutationRun &mutation_registry = population_.mutation_registry_;
 		int mutation_count = mutation_registry.size();
@@ -10613,6 +11614,7 @@ EidosValue_SP SLiMSim::ExecuteMethod_mutationsOfType(EidosGlobalStringID p_metho
 			return result_SP;
 		}
 	}
+#endif
 }
 			
 //	*********************	- (integer$)countOfMutationsOfType(io<MutationType>$ mutType)
@@ -10623,44 +11625,19 @@ EidosValue_SP SLiMSim::ExecuteMethod_countOfMutationsOfType(EidosGlobalStringID
 	EidosValue *mutType_value = p_arguments[0].get();
 	
 	MutationType *mutation_type_ptr = SLiM_ExtractMutationTypeFromEidosValue_io(mutType_value, 0, *this, "countOfMutationsOfType()");
-	Mutation *mut_block_ptr = gSLiM_Mutation_Block;
 	
 #ifdef SLIM_KEEP_MUTTYPE_REGISTRIES
-	// track calls per generation to SLiMSim::ExecuteMethod_mutationsOfType() and SLiMSim::ExecuteMethod_countOfMutationsOfType()
-	bool start_registry = (mutation_type_ptr->muttype_registry_call_count_++ >= 1);
-	population_.any_muttype_call_count_used_ = true;
-	
-	// start a registry if appropriate, so we can hit the fast case below
-	if (start_registry && (!population_.keeping_muttype_registries_ || !mutation_type_ptr->keeping_muttype_registry_))
-	{
-		MutationRun &mutation_registry = population_.mutation_registry_;
-		int mutation_count = mutation_registry.size();
-		MutationRun &muttype_registry = mutation_type_ptr->muttype_registry_;
-		
-		for (int mut_index = 0; mut_index < mutation_count; ++mut_index)
-		{
-			MutationIndex mut = mutation_registry[mut_index];
-			
-			if ((mut_block_ptr + mut)->mutation_type_ptr_ == mutation_type_ptr)
-				muttype_registry.emplace_back(mut);
-		}
-		
-		population_.keeping_muttype_registries_ = true;
-		mutation_type_ptr->keeping_muttype_registry_ = true;
-	}
-	
-	if (population_.keeping_muttype_registries_ && mutation_type_ptr->keeping_muttype_registry_)
 	{
-		// We're already keeping a separate registry for this mutation type (see mutation_type.h), so we can answer this directly
+		// Each mutation type keeps its own registry (see mutation_type.h), so we can answer this directly
 		MutationRun &mutation_registry = mutation_type_ptr->muttype_registry_;
 		int mutation_count = mutation_registry.size();
 		
 		return EidosValue_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_Int_singleton(mutation_count));
 	}
-	else
-#endif
+#else
 	{
 		// Count the number of mutations of the given type
+		Mutation *mut_block_ptr = gSLiM_Mutation_Block;
 		MutationRun &mutation_registry = population_.mutation_registry_;
 		int mutation_count = mutation_registry.size();
 		int match_count = 0, mut_index;
@@ -10671,6 +11648,7 @@ EidosValue_SP SLiMSim::ExecuteMethod_countOfMutationsOfType(EidosGlobalStringID
 		
 		return EidosValue_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_Int_singleton(match_count));
 	}
+#endif
 }
 			
 //	*********************	– (void)outputFixedMutations([Ns$ filePath = NULL], [logical$ append=F])
@@ -11083,6 +12061,15 @@ EidosValue_SP SLiMSim::ExecuteMethod_outputUsage(EidosGlobalStringID p_method_id
 		
 		out << "      Tree-sequence tables: ";
 		PrintBytes(out, usage.slimsimTreeSeqTables);
+		
+		if (simplification_count_)
+		{
+			out << "      Tree-sequence simplifications: " << simplification_count_ << " (" << simplification_seconds_ << " seconds)" << std::endl;
+			out << "         Tables before last (generation " << last_simplification_.generation_ << "): ";
+			PrintBytes(out, last_simplification_.memory_before_);
+			out << "         Tables after last: ";
+			PrintBytes(out, last_simplification_.memory_after_);
+		}
 	}
 	
 	// Subpopulation
@@ -11705,6 +12692,139 @@ EidosValue_SP SLiMSim::ExecuteMethod_treeSeqSimplify(EidosGlobalStringID p_metho
 	return gStaticEidosValueVOID;
 }
 
+// TREE SEQUENCE RECORDING
+//	*********************	- (float$)treeSeqDiversity([Nio<Subpopulation> subpops = NULL], [string$ mode = "site"])
+//	*********************	- (float$)treeSeqDivergence(io<Subpopulation>$ subpop1, io<Subpopulation>$ subpop2, [string$ mode = "site"])
+//	*********************	- (float)treeSeqSFS([Nio<Subpopulation> subpops = NULL], [string$ mode = "site"], [logical$ folded = F])
+//
+EidosValue_SP SLiMSim::ExecuteMethod_treeSeqStatistic(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter)
+{
+#pragma unused (p_method_id, p_arguments, p_argument_count, p_interpreter)
+	const char *method_name = ((p_method_id == gID_treeSeqDiversity) ? "treeSeqDiversity()" : ((p_method_id == gID_treeSeqDivergence) ? "treeSeqDivergence()" : "treeSeqSFS()"));
+	
+	if (!recording_tree_)
+		EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqStatistic): " << method_name << " may only be called when tree recording is enabled." << EidosTerminate();
+	
+	// the statistics are computed on the simplified tables, so we have the same restrictions as treeSeqSimplify()
+	SLiMGenerationStage gen_stage = GenerationStage();
+	
+	if ((gen_stage != SLiMGenerationStage::kWFStage1ExecuteEarlyScripts) && (gen_stage != SLiMGenerationStage::kWFStage5ExecuteLateScripts) &&
+		(gen_stage != SLiMGenerationStage::kNonWFStage2ExecuteEarlyScripts) && (gen_stage != SLiMGenerationStage::kNonWFStage6ExecuteLateScripts))
+		EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqStatistic): " << method_name << " may only be called from an early() or late() event." << EidosTerminate();
+	if ((executing_block_type_ != SLiMEidosBlockType::SLiMEidosEventEarly) && (executing_block_type_ != SLiMEidosBlockType::SLiMEidosEventLate))
+		EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqStatistic): " << method_name << " may not be called from inside a callback." << EidosTerminate();
+	
+	// gather the subpopulations for each sample set; diversity and the SFS use one set, divergence uses two
+	std::vector<std::vector<Subpopulation *>> set_subpops;
+	
+	if (p_method_id == gID_treeSeqDivergence)
+	{
+		set_subpops.emplace_back(1, SLiM_ExtractSubpopulationFromEidosValue_io(p_arguments[0].get(), 0, *this, method_name));
+		set_subpops.emplace_back(1, SLiM_ExtractSubpopulationFromEidosValue_io(p_arguments[1].get(), 0, *this, method_name));
+	}
+	else
+	{
+		EidosValue *subpops_value = p_arguments[0].get();
+		
+		set_subpops.resize(1);
+		
+		if (subpops_value->Type() == EidosValueType::kValueNULL)
+		{
+			for (auto subpop_pair : population_.subpops_)
+				set_subpops[0].emplace_back(subpop_pair.second);
+		}
+		else
+		{
+			int subpops_count = subpops_value->Count();
+			
+			for (int subpop_index = 0; subpop_index < subpops_count; ++subpop_index)
+			{
+				Subpopulation *subpop = SLiM_ExtractSubpopulationFromEidosValue_io(subpops_value, subpop_index, *this, method_name);
+				
+				if (std::find(set_subpops[0].begin(), set_subpops[0].end(), subpop) == set_subpops[0].end())
+					set_subpops[0].emplace_back(subpop);
+			}
+		}
+	}
+	
+	EidosValue_String *mode_value = (EidosValue_String *)p_arguments[(p_method_id == gID_treeSeqDivergence) ? 2 : 1].get();
+	std::string mode = mode_value->StringAtIndex(0, nullptr);
+	bool branch_mode;
+	
+	if (mode == "site")
+		branch_mode = false;
+	else if (mode == "branch")
+		branch_mode = true;
+	else
+		EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqStatistic): " << method_name << " requires mode to be 'site' or 'branch'." << EidosTerminate();
+	
+	// simplify, which renumbers the extant genomes to be the samples, and then collect their node ids; null genomes are excluded
+	SimplifyTreeSequence();
+	
+	std::vector<std::vector<tsk_id_t>> sample_sets(set_subpops.size());
+	
+	for (size_t set_index = 0; set_index < set_subpops.size(); ++set_index)
+	{
+		for (Subpopulation *subpop : set_subpops[set_index])
+			for (Genome *genome : subpop->parent_genomes_)
+				if (!genome->IsNull())
+					sample_sets[set_index].push_back(genome->tsk_node_id_);
+		
+		if (sample_sets[set_index].size() < ((p_method_id == gID_treeSeqDiversity) ? 2 : 1))
+			EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqStatistic): " << method_name << " requires " << ((p_method_id == gID_treeSeqDiversity) ? "at least two non-null genomes" : "at least one non-null genome") << " in each sample set." << EidosTerminate();
+	}
+	
+	// the edge indexes are needed only while we walk the trees, so we drop them again afterwards
+	int ret = tsk_table_collection_build_index(&tables_, 0);
+	if (ret < 0) handle_error("tsk_table_collection_build_index", ret);
+	
+	std::vector<double> result;
+	
+	if (p_method_id == gID_treeSeqDiversity)
+	{
+		double n = (double)sample_sets[0].size();
+		double denominator = n * (n - 1);
+		
+		TreeSeqGeneralStatistic(tables_, sample_sets, branch_mode, false, 1, [denominator, n](const double *x, double weight, double *out) {
+			out[0] += weight * x[0] * (n - x[0]) / denominator;
+		}, result);
+	}
+	else if (p_method_id == gID_treeSeqDivergence)
+	{
+		double n1 = (double)sample_sets[0].size(), n2 = (double)sample_sets[1].size();
+		double denominator = n1 * n2;
+		
+		TreeSeqGeneralStatistic(tables_, sample_sets, branch_mode, false, 1, [denominator, n2](const double *x, double weight, double *out) {
+			out[0] += weight * x[0] * (n2 - x[1]) / denominator;
+		}, result);
+	}
+	else
+	{
+		bool folded = p_arguments[2]->LogicalAtIndex(0, nullptr);
+		size_t n = sample_sets[0].size();
+		
+		TreeSeqGeneralStatistic(tables_, sample_sets, branch_mode, true, (folded ? n / 2 : n) + 1, [folded, n](const double *x, double weight, double *out) {
+			size_t count = (size_t)x[0];
+			
+			out[(folded && (count > n - count)) ? n - count : count] += weight;
+		}, result);
+	}
+	
+	tsk_table_collection_drop_index(&tables_, 0);
+	
+	if (p_method_id == gID_treeSeqSFS)
+	{
+		EidosValue_Float_vector *float_result = (new (gEidosValuePool->AllocateChunk()) EidosValue_Float_vector())->resize_no_initialize(result.size());
+		
+		for (size_t result_index = 0; result_index < result.size(); ++result_index)
+			float_result->set_float_no_check(result[result_index], result_index);
+		
+		return EidosValue_SP(float_result);
+	}
+	
+	return EidosValue_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_Float_singleton(result[0]));
+}
+
 // TREE SEQUENCE RECORDING
 //	*********************	- (void)treeSeqRememberIndividuals(object<Individual> individuals)
 //
@@ -11740,7 +12860,7 @@ EidosValue_SP SLiMSim::ExecuteMethod_treeSeqRememberIndividuals(EidosGlobalStrin
 }
 
 // TREE SEQUENCE RECORDING
-//	*********************	- (void)treeSeqOutput(string$ path, [logical$ simplify = T], [logical$ includeModel = T], [logical$ _binary = T]) (note the _binary flag is undocumented)
+//	*********************	- (void)treeSeqOutput(string$ path, [logical$ simplify = T], [logical$ includeModel = T], [logical$ inPlace = F], [logical$ compress = F], [logical$ _binary = T]) (note the _binary flag is undocumented)
 //
 EidosValue_SP SLiMSim::ExecuteMethod_treeSeqOutput(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter)
 {
@@ -11748,7 +12868,9 @@ EidosValue_SP SLiMSim::ExecuteMethod_treeSeqOutput(EidosGlobalStringID p_method_
 	EidosValue *path_value = p_arguments[0].get();
 	EidosValue *simplify_value = p_arguments[1].get();
 	EidosValue *includeModel_value = p_arguments[2].get();
-	EidosValue *binary_value = p_arguments[3].get();
+	EidosValue *inPlace_value = p_arguments[3].get();
+	EidosValue *compress_value = p_arguments[4].get();
+	EidosValue *binary_value = p_arguments[5].get();
 	
 	if (!recording_tree_)
 		EIDOS_TERMINATION << "ERROR (SLiMSim::ExecuteMethod_treeSeqOutput): treeSeqOutput() may only be called when tree recording is enabled." << EidosTerminate();
@@ -11765,8 +12887,10 @@ EidosValue_SP SLiMSim::ExecuteMethod_treeSeqOutput(EidosGlobalStringID p_method_
 	bool binary = binary_value->LogicalAtIndex(0, nullptr);
 	bool simplify = simplify_value->LogicalAtIndex(0, nullptr);
 	bool includeModel = includeModel_value->LogicalAtIndex(0, nullptr);
+	bool inPlace = inPlace_value->LogicalAtIndex(0, nullptr);
+	bool compress = compress_value->LogicalAtIndex(0, nullptr);
 	
-	WriteTreeSequence(path_string, binary, simplify, includeModel);
+	WriteTreeSequence(path_string, binary, simplify, includeModel, inPlace, compress);
 	
 	return gStaticEidosValueVOID;
 }
@@ -11867,8 +12991,11 @@ const std::vector<EidosMethodSignature_CSP> *SLiMSim_Class::Methods(void) const
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_simulationFinished, kEidosValueMaskVOID)));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqCoalesced, kEidosValueMaskLogical | kEidosValueMaskSingleton)));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqSimplify, kEidosValueMaskVOID)));
+		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqDiversity, kEidosValueMaskFloat | kEidosValueMaskSingleton))->AddIntObject_ON("subpops", gSLiM_Subpopulation_Class, gStaticEidosValueNULL)->AddString_OS("mode", EidosValue_String_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_String_singleton("site"))));
+		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqDivergence, kEidosValueMaskFloat | kEidosValueMaskSingleton))->AddIntObject_S("subpop1", gSLiM_Subpopulation_Class)->AddIntObject_S("subpop2", gSLiM_Subpopulation_Class)->AddString_OS("mode", EidosValue_String_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_String_singleton("site"))));
+		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqSFS, kEidosValueMaskFloat))->AddIntObject_ON("subpops", gSLiM_Subpopulation_Class, gStaticEidosValueNULL)->AddString_OS("mode", EidosValue_String_SP(new (gEidosValuePool->AllocateChunk()) EidosValue_String_singleton("site")))->AddLogical_OS("folded", gStaticEidosValue_LogicalF));
 		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqRememberIndividuals, kEidosValueMaskVOID))->AddObject("individuals", gSLiM_Individual_Class));
-		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqOutput, kEidosValueMaskVOID))->AddString_S("path")->AddLogical_OS("simplify", gStaticEidosValue_LogicalT)->AddLogical_OS("includeModel", gStaticEidosValue_LogicalT)->AddLogical_OS("_binary", gStaticEidosValue_LogicalT));
+		methods->emplace_back((EidosInstanceMethodSignature *)(new EidosInstanceMethodSignature(gStr_treeSeqOutput, kEidosValueMaskVOID))->AddString_S("path")->AddLogical_OS("simplify", gStaticEidosValue_LogicalT)->AddLogical_OS("includeModel", gStaticEidosValue_LogicalT)->AddLogical_OS("inPlace", gStaticEidosValue_LogicalF)->AddLogical_OS("compress", gStaticEidosValue_LogicalF)->AddLogical_OS("_binary", gStaticEidosValue_LogicalT));
 							  
 		std::sort(methods->begin(), methods->end(), CompareEidosCallSignatures);
 	}
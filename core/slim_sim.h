@@ -32,6 +32,10 @@
 #include <vector>
 #include <iostream>
 
+#ifdef _OPENMP
+#include <thread>
+#endif
+
 #include "slim_globals.h"
 #include "mutation.h"
 #include "mutation_type.h"
@@ -182,6 +186,14 @@ static_assert(sizeof(SubpopulationMigrationMetadataRec) == 12, "SubpopulationMig
 #endif
 
 
+// A record of one tree-sequence simplification, kept so that outputUsage() can report the cost of the most recent simplification
+typedef struct {
+	slim_generation_t generation_;			// the generation in which the simplification was started
+	size_t memory_before_;					// the table memory in use before simplification, in bytes
+	size_t memory_after_;					// the table memory in use after simplification, in bytes
+	double seconds_;						// the elapsed time taken by sorting and simplifying
+} SimplificationRecord;
+
 // Memory usage assessment as done by SLiMSim::TabulateMemoryUsage() is placed into this struct
 typedef struct
 {
@@ -428,6 +440,43 @@ private:
 	
 	tsk_table_collection_t tables_;
 	tsk_bookmark_t table_position_;
+	tsk_size_t sorted_edge_count_ = 0;			// edges [0, sorted_edge_count_) are known to be in sorted order, as left by the last simplify or sort
+	tsk_id_t buffer_node_offset_ = 0;			// added to the ids of new nodes while a background simplification is pending; 0 otherwise
+	
+	// new nodes and edges are staged here by RecordNewGenome(), and appended to tables_ in bulk by FlushStagedTableRows()
+	std::vector<double> staged_node_time_;
+	std::vector<tsk_id_t> staged_node_population_;
+	std::vector<GenomeMetadataRec> staged_node_metadata_;
+	std::vector<double> staged_edge_left_;
+	std::vector<double> staged_edge_right_;
+	std::vector<tsk_id_t> staged_edge_parent_;
+	std::vector<tsk_id_t> staged_edge_child_;
+	size_t staged_node_position_ = 0;			// the staged row counts at table_position_, for RetractNewIndividual()
+	size_t staged_edge_position_ = 0;
+	
+	// new derived states are staged here by RecordNewDerivedState(), each as a position, a node, and an index into the derived
+	// states (mutation ids plus metadata) staged since the last flush, where consecutive identical states are kept once;
+	// FlushStagedTableRows() expands them into the site and mutation tables
+	std::vector<slim_position_t> staged_mutation_site_position_;
+	std::vector<tsk_id_t> staged_mutation_node_;
+	std::vector<uint32_t> staged_mutation_state_;
+	std::vector<size_t> staged_state_start_;					// the start of each staged state in the two vectors below, plus an end
+	std::vector<slim_mutationid_t> staged_state_mutation_ids_;
+	std::vector<MutationMetadataRec> staged_state_metadata_;
+	size_t staged_mutation_position_ = 0;
+	size_t staged_state_position_ = 0;			// the staged state count at table_position_, for RetractNewIndividual()
+	
+#ifdef _OPENMP
+	// auto-simplification in a background thread; while it runs, tables_ holds only what has been recorded since it began
+	std::thread simplify_thread_;				// joinable while a background simplification is pending
+	tsk_table_collection_t simplify_tables_;	// the tables being simplified, owned by simplify_thread_ until it is joined
+	std::vector<tsk_id_t> simplify_samples_;	// the samples for that simplification
+	int simplify_ret_ = 0;						// the tskit return code from the background thread, and the call that produced it
+	const char *simplify_error_ = nullptr;
+	bool simplify_adjusts_interval_ = false;	// true if the ratio-based simplification interval should be adjusted when the thread is joined
+	uint64_t simplify_old_table_size_ = 0;		// the table size before simplification, for that adjustment
+	double simplify_seconds_ = 0;				// the elapsed time taken by the background thread
+#endif
 	
     std::vector<tsk_id_t> remembered_genomes_;
 	//Individual *current_new_individual_;
@@ -442,6 +491,11 @@ private:
 	int64_t simplification_interval_;			// the generation interval between simplifications; -1 if not used (in which case the ratio is used)
 	int64_t simplify_elapsed_ = 0;				// the number of generations elapsed since a simplification was done (automatic or otherwise)
 	double simplify_interval_;					// the current number of generations between automatic simplifications when using simplification_ratio_
+	double simplification_memory_ = 0;			// if > 0, the memory budget for the tables in bytes, used instead of a ratio or interval
+	size_t simplify_last_table_memory_ = 0;		// the table memory in use at the last check or simplification, to project growth against the budget
+	SimplificationRecord last_simplification_;	// the most recent simplification, for outputUsage(); earlier ones are only totaled below
+	int64_t simplification_count_ = 0;			// the number of simplifications done
+	double simplification_seconds_ = 0;			// the total elapsed time taken by those simplifications
 	
 	slim_generation_t tree_seq_generation_ = 0;	// the generation for the tree sequence code, incremented after offspring generation
 												// this is needed since addSubpop() in an early() event makes one gen, and then the offspring
@@ -598,6 +652,8 @@ public:
 	static void DerivedStatesToAscii(tsk_table_collection_t *p_tables);
 	
 	void RecordTablePosition(void);
+	void FlushStagedTableRows(void);
+	void ClearStagedTableRows(void);
 	void AllocateTreeSequenceTables(void);
 	void SetCurrentNewIndividual(Individual *p_individual);
 	void RecordNewGenome(std::vector<slim_position_t> *p_breakpoints, Genome *p_new_genome, const Genome *p_initial_parental_genome, const Genome *p_second_parental_genome);
@@ -611,10 +667,19 @@ public:
 	void WritePopulationTable(tsk_table_collection_t *p_tables);
 	void WriteProvenanceTable(tsk_table_collection_t *p_tables, bool p_use_newlines, bool p_include_model);
 	void ReadProvenanceTable(tsk_table_collection_t *p_tables, slim_generation_t *p_generation, SLiMModelType *p_model_type, int *p_file_version);
-	void WriteTreeSequence(std::string &p_recording_tree_path, bool p_binary, bool p_simplify, bool p_include_model);
+	void WriteTreeSequence(std::string &p_recording_tree_path, bool p_binary, bool p_simplify, bool p_include_model, bool p_in_place, bool p_compress);
     void ReorderIndividualTable(tsk_table_collection_t *p_tables, std::vector<int> p_individual_map, bool p_keep_unmapped);
+	void SortTreeSequenceTables(void);
+	void CollectSimplificationSamples(std::vector<tsk_id_t> &p_samples);
 	void SimplifyTreeSequence(void);
+#ifdef _OPENMP
+	void StartBackgroundSimplification(void);
+	void CheckExtantGenomeNodeIds(void);
+#endif
+	void FinishBackgroundSimplification(void);
+	void DiscardBackgroundSimplification(void);
 	void CheckCoalescenceAfterSimplification(void);
+	void AdjustSimplificationInterval(uint64_t p_old_table_size, uint64_t p_new_table_size);
 	void CheckAutoSimplification(void);
     void TreeSequenceDataFromAscii(std::string NodeFileName, 
             std::string EdgeFileName, std::string SiteFileName, std::string MutationFileName, 
@@ -629,13 +694,14 @@ public:
 	void __CreateSubpopulationsFromTabulation(std::unordered_map<slim_objectid_t, ts_subpop_info> &p_subpopInfoMap, EidosInterpreter *p_interpreter, std::unordered_map<tsk_id_t, Genome *> &p_nodeToGenomeMap);
 	void __ConfigureSubpopulationsFromTables(EidosInterpreter *p_interpreter);
 	void __TabulateMutationsFromTables(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutMap, int p_file_version);
-	void __TallyMutationReferencesWithTreeSequence(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutMap, std::unordered_map<tsk_id_t, Genome *> p_nodeToGenomeMap, tsk_treeseq_t *p_ts);
+	void __TallyMutationReferencesWithTreeSequence(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutMap, const std::unordered_map<tsk_id_t, Genome *> &p_nodeToGenomeMap, tsk_treeseq_t *p_ts);
 	void __CreateMutationsFromTabulation(std::unordered_map<slim_mutationid_t, ts_mut_info> &p_mutInfoMap, std::unordered_map<slim_mutationid_t, MutationIndex> &p_mutIndexMap);
-	void __AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mutationid_t, MutationIndex> &p_mutIndexMap, std::unordered_map<tsk_id_t, Genome *> p_nodeToGenomeMap, tsk_treeseq_t *p_ts);
+	void __AddMutationsFromTreeSequenceToGenomes(std::unordered_map<slim_mutationid_t, MutationIndex> &p_mutIndexMap, const std::unordered_map<tsk_id_t, Genome *> &p_nodeToGenomeMap, tsk_treeseq_t *p_ts);
 	slim_generation_t _InstantiateSLiMObjectsFromTables(EidosInterpreter *p_interpreter);								// given tree-seq tables, makes individuals, genomes, and mutations
 	slim_generation_t _InitializePopulationFromTskitTextFile(const char *p_file, EidosInterpreter *p_interpreter);	// initialize the population from an tskit text file
 	slim_generation_t _InitializePopulationFromTskitBinaryFile(const char *p_file, EidosInterpreter *p_interpreter);	// initialize the population from an tskit binary file
-	size_t MemoryUsageForTables(tsk_table_collection_t &p_tables);
+	size_t MemoryUsageForTables(tsk_table_collection_t &p_tables, bool p_in_use = false);
+	void CompleteSimplificationRecord(double p_seconds);
 	
 	//
 	// Eidos support
@@ -704,6 +770,7 @@ public:
 	EidosValue_SP ExecuteMethod_simulationFinished(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_treeSeqCoalesced(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_treeSeqSimplify(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
+	EidosValue_SP ExecuteMethod_treeSeqStatistic(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_treeSeqRememberIndividuals(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 	EidosValue_SP ExecuteMethod_treeSeqOutput(EidosGlobalStringID p_method_id, const EidosValue_SP *const p_arguments, int p_argument_count, EidosInterpreter &p_interpreter);
 };
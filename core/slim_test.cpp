@@ -272,7 +272,7 @@ static void _RunContinuousSpaceTests(void);
 static void _RunNonWFTests(void);
 static void _RunTreeSeqTests(std::string temp_path);
 static void _RunNucleotideFunctionTests(void);
-static void _RunNucleotideMethodTests(void);
+static void _RunNucleotideMethodTests(std::string temp_path);
 static void _RunSLiMTimingTests(void);
 
 
@@ -344,7 +344,7 @@ int RunSLiMTests(void)
 	_RunNonWFTests();
 	_RunTreeSeqTests(temp_path);
 	_RunNucleotideFunctionTests();
-	_RunNucleotideMethodTests();
+	_RunNucleotideMethodTests(temp_path);
 	_RunSLiMTimingTests();
 	
 	_RunInteractionTypeTests();		// many tests, time-consuming, so do this last
@@ -827,6 +827,11 @@ void _RunSLiMSimTests(std::string temp_path)
 	SLiMAssertScriptSuccess(gen1_setup_p1p2p3 + "1 { sim.mutationCounts(object()); }", __LINE__);												// legal to specify an empty object vector
 	SLiMAssertScriptRaise(gen1_setup_p1p2p3 + "1 { sim.mutationCounts(1); }", 1, 301, "cannot be type integer", __LINE__);						// this is one API where integer identifiers can't be used
 	
+	// Test that cached mutation counts for subsets of subpops stay correct across interleaved queries, new mutations, and migration
+	std::string gen1_setup_tally_p1p2("initialize() { initializeSLiMOptions(mutationRuns=4); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } 1 { sim.addSubpop('p1', 30); sim.addSubpop('p2', 20); p1.setMigrationRates(p2, 0.1); } function (i)counts(o<Subpopulation> s) { g = s.genomes; return sapply(sim.mutations, 'sum(g.containsMutations(applyValue));'); } ");
+	SLiMAssertScriptStop(gen1_setup_tally_p1p2 + "20 late() { c1 = sim.mutationCounts(p1); c2 = sim.mutationCounts(p2); c = sim.mutationCounts(NULL); ok = identical(sim.mutationCounts(p1), c1) & identical(c1, counts(p1)) & identical(c2, counts(p2)) & identical(c1 + c2, c); "
+						 "p1.genomes[0:9].addNewDrawnMutation(m1, 500); if (ok & identical(sim.mutationCounts(p1), counts(p1)) & identical(sim.mutationCounts(p2), counts(p2))) stop(); }", __LINE__);
+	
 	// Test sim - (object<Mutation>)mutationsOfType(io<MutationType>$ mutType)
 	SLiMAssertScriptSuccess(gen1_setup_p1 + "10 { sim.mutationsOfType(m1); } ", __LINE__);
 	SLiMAssertScriptSuccess(gen1_setup_p1 + "10 { sim.mutationsOfType(1); } ", __LINE__);
@@ -835,6 +840,11 @@ void _RunSLiMSimTests(std::string temp_path)
 	SLiMAssertScriptSuccess(gen1_setup_p1 + "10 { sim.countOfMutationsOfType(m1); } ", __LINE__);
 	SLiMAssertScriptSuccess(gen1_setup_p1 + "10 { sim.countOfMutationsOfType(1); } ", __LINE__);
 	
+	// Test that the per-muttype registries track mutations through gain, loss, setMutationType(), and reloading
+	std::string gen1_setup_muttype_registries("initialize() { initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); initializeMutationType('m2', 0.5, 'f', 0.01); initializeMutationType('m3', 0.5, 'f', 0.0); m3.convertToSubstitution = F; initializeGenomicElementType('g1', c(m1, m2, m3), c(1.0, 1.0, 1.0)); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } 1 { sim.addSubpop('p1', 50); } function (l$)registriesOK(void) { for (t in sim.mutationTypes) { m = sim.mutations; b = sort(m[m.mutationType == t].id); if (!identical(sort(sim.mutationsOfType(t).id), b) | (sim.countOfMutationsOfType(t) != size(b))) return F; } return T; } ");
+	if (Eidos_SlashTmpExists())
+		SLiMAssertScriptStop(gen1_setup_muttype_registries + "2:100 late() { if (sim.generation % 20 == 0) { m = sim.mutationsOfType(m1); if (size(m)) m[0].setMutationType(m3); } if (!registriesOK()) sim.simulationFinished(); } 100 late() { sim.outputFull('" + temp_path + "/slimTest_muttypeRegistries.txt'); sim.readFromPopulationFile('" + temp_path + "/slimTest_muttypeRegistries.txt'); if (registriesOK() & (size(sim.mutations) > 0)) stop(); }", __LINE__);
+	
 	// Test sim - (void)outputFixedMutations(void)
 	SLiMAssertScriptSuccess(gen1_setup_p1p2p3 + "1 late() { sim.outputFixedMutations(); }", __LINE__);
 	SLiMAssertScriptSuccess(gen1_setup_p1p2p3 + "1 late() { sim.outputFixedMutations(NULL); }", __LINE__);
@@ -1591,6 +1601,11 @@ void _RunChromosomeTests(void)
 	SLiMAssertScriptStop(gen1_setup + "1 { sim.chromosome.setGeneConversion(0.2, 1234.5, 0.75); if (sim.chromosome.geneConversionMeanLength == 1234.5) stop(); }", __LINE__);
 	SLiMAssertScriptStop(gen1_setup + "1 { sim.chromosome.setGeneConversion(0.2, 1234.5, 0.75); if (sim.chromosome.geneConversionSimpleConversionFraction == 0.75) stop(); }", __LINE__);
 	SLiMAssertScriptStop(gen1_setup + "1 { sim.chromosome.setGeneConversion(0.2, 1234.5, 0.75); if (sim.chromosome.geneConversionGCBias == 0.0) stop(); }", __LINE__);
+	
+	// heteroduplex mismatch repair with many complex gene conversion tracts; every tract must leave the offspring consistent
+	std::string gen1_setup_hetero("initialize() { initializeTreeSeq(); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-5); initializeGeneConversion(0.5, 200, 0.0); } 1 { sim.addSubpop('p1', 50); } ");
+	SLiMAssertScriptStop(gen1_setup_hetero + "20 { ok = T; for (g in p1.genomes) { pos = g.mutations.position; ok = ok & identical(pos, sort(pos)); } if (ok) stop(); }", __LINE__);
+	SLiMAssertScriptStop(gen1_setup_hetero + "20 { if (sum(sim.mutationCounts(p1)) == sum(p1.genomes.countOfMutationsOfType(m1))) stop(); }", __LINE__);
 }
 
 #pragma mark Mutation tests
@@ -1768,6 +1783,14 @@ void _RunGenomeTests(std::string temp_path)
 	SLiMAssertScriptStop(gen1_setup_p1 + "10 { p1.genomes[0].containsMutations(object()); stop(); }", __LINE__);
 	SLiMAssertScriptStop(gen1_setup_p1 + "10 { p1.genomes[0].containsMutations(sim.mutations); stop(); }", __LINE__);
 	
+	// containsMutations() and countOfMutationsOfType() across many genomes work run by run; check them against single-genome queries
+	std::string gen1_setup_runs_p1("initialize() { initializeSLiMOptions(mutationRuns=8); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeMutationType('m2', 0.5, 'f', 0.0); initializeGenomicElementType('g1', c(m1, m2), c(1.0, 1.0)); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } 1 { sim.addSubpop('p1', 50); } ");
+	SLiMAssertScriptStop(gen1_setup_runs_p1 + "20 { g = p1.genomes; m = sim.mutations; r = NULL; for (x in g) r = c(r, x.containsMutations(m)); if ((size(m) > 10) & identical(g.containsMutations(m), r)) stop(); }", __LINE__);
+	SLiMAssertScriptStop(gen1_setup_runs_p1 + "20 { g = p1.genomes; g[0:4].removeMutations(); m = sim.mutations; m = c(m, m[0]); r = NULL; for (x in g) r = c(r, x.containsMutations(m)); if (identical(g.containsMutations(m), r)) stop(); }", __LINE__);
+	SLiMAssertScriptStop(gen1_setup_runs_p1 + "20 { g = p1.genomes; c1 = sapply(g, 'size(applyValue.mutationsOfType(m1));'); c2 = sapply(g, 'size(applyValue.mutationsOfType(m2));'); if (identical(g.countOfMutationsOfType(m1), c1) & identical(g.countOfMutationsOfType(2), c2) & (sum(c1) > 0)) stop(); }", __LINE__);
+	SLiMAssertScriptRaise(gen1_setup_sex_p1 + "10 { p1.genomes.containsMutations(sim.mutations); stop(); }", 1, 279, "cannot be called on a null genome", __LINE__);
+	SLiMAssertScriptRaise(gen1_setup_sex_p1 + "10 { p1.genomes.countOfMutationsOfType(m1); stop(); }", 1, 279, "cannot be called on a null genome", __LINE__);
+	
 	// Test Genome - (integer$)countOfMutationsOfType(io<MutationType>$ mutType)
 	SLiMAssertScriptStop(gen1_setup_p1 + "10 { p1.genomes[0].countOfMutationsOfType(m1); stop(); }", __LINE__);
 	SLiMAssertScriptStop(gen1_setup_p1 + "10 { p1.genomes[0].countOfMutationsOfType(1); stop(); }", __LINE__);
@@ -2241,6 +2264,13 @@ void _RunSubpopulationTests(void)
 	SLiMAssertScriptRaise(gen1_setup_sex_p1 + "1 { p1.setCloningRate(c(0.0, -0.001)); stop(); }", 1, 270, "within [0,1]", __LINE__);
 	SLiMAssertScriptRaise(gen1_setup_sex_p1 + "1 { p1.setCloningRate(c(0.0, 1.001)); stop(); }", 1, 270, "within [0,1]", __LINE__);
 	
+	// clonal offspring share their parent's array of mutation runs until the end of offspring generation; check that modifications
+	// made to such offspring in modifyChild() do not leak into the parent, and that tallies come out right
+	std::string gen1_setup_clonal_runs("initialize() { initializeSLiMOptions(mutationRuns=16); initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); } 1 { sim.addSubpop('p1', 50); } ");
+	std::string clonal_runs_check("30 late() { g = p1.genomes; f = sapply(sim.mutations, 'sum(g.containsMutations(applyValue));') / size(g); if (all(abs(sim.mutationFrequencies(p1) - f) < 1e-12) & all(sim.mutationCounts(p1) > 0)) stop(); }");
+	SLiMAssertScriptStop(gen1_setup_clonal_runs + "1 { p1.setCloningRate(1.0); } modifyChild() { if (runif(1) < 0.2) childGenome1.addNewDrawnMutation(m1, rdunif(1, 0, 99999)); return T; } " + clonal_runs_check, __LINE__);
+	SLiMAssertScriptStop(gen1_setup_clonal_runs + "1 { p1.setCloningRate(0.5); } modifyChild() { if (runif(1) < 0.2) childGenome2.removeMutations(); return (runif(1) < 0.9); } " + clonal_runs_check, __LINE__);
+	
 	// Test Subpopulation - (void)setMigrationRates(io<Subpopulation> sourceSubpops, numeric rates)
 	SLiMAssertScriptStop(gen1_setup_p1p2p3 + "1 { p1.setMigrationRates(2, 0.1); } 10 { stop(); }", __LINE__);
 	SLiMAssertScriptStop(gen1_setup_p1p2p3 + "1 { p1.setMigrationRates(3, 0.1); } 10 { stop(); }", __LINE__);
@@ -2933,6 +2963,15 @@ void _RunInteractionTypeTests(void)
 	SLiMAssertScriptRaise(gen1_setup_i1x + "1 { c(i1,i1).tag; }", 1, 430, "before being set", __LINE__);
 	SLiMAssertScriptStop(gen1_setup_i1x + "1 { i1.tag = 17; } 2 { if (i1.tag == 17) stop(); }", __LINE__);
 	
+	// Test that the grid-based pair search agrees with brute-force distances, including across a periodic boundary
+	SLiMAssertScriptStop("initialize() { initializeSLiMOptions(dimensionality='xy', periodicity='x'); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); initializeInteractionType('i1', 'xy', maxDistance=0.1); } 1 { sim.addSubpop('p1', 300); p1.individuals.x = runif(300); p1.individuals.y = runif(300); i1.evaluate(); inds = p1.individuals; t = i1.totalOfNeighborStrengths(inds); b = sapply(inds, 'sum(i1.distance(applyValue, inds) <= 0.1) - 1;'); if (identical(t, asFloat(b)) & sum(b) > 0) stop(); }", __LINE__);
+	
+	// Test that nearestNeighbors() with a large count agrees with brute-force distances
+	SLiMAssertScriptStop("initialize() { initializeSLiMOptions(dimensionality='xy'); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); initializeInteractionType('i1', 'xy', maxDistance=0.5); } 1 { sim.addSubpop('p1', 500); inds = p1.individuals; inds.x = runif(500); inds.y = runif(500); i1.evaluate(); ok = T; for (ind in inds[0:19]) { nn = i1.nearestNeighbors(ind, 150); d = i1.distance(ind, inds); d[ind.index] = INF; b = inds[order(d)[0:149]]; b = b[i1.distance(ind, b) <= 0.5]; ok = ok & identical(sort(nn.index), sort(b.index)); } if (ok) stop(); }", __LINE__);
+	
+	// Test that incremental rebuilding of the sparse array, after a few individuals move between evaluations, agrees with brute-force distances
+	SLiMAssertScriptStop("initialize() { initializeSLiMOptions(dimensionality='xy', periodicity='x'); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); initializeInteractionType('i1', 'xy', maxDistance=0.1); } 1 { sim.addSubpop('p1', 300); inds = p1.individuals; inds.x = runif(300); inds.y = runif(300); ok = T; for (rep in 1:4) { i1.evaluate(); t = i1.totalOfNeighborStrengths(inds); b = sapply(inds, 'sum(i1.distance(applyValue, inds) <= 0.1) - 1;'); ok = ok & identical(t, asFloat(b)); mv = inds[0:9]; mv.x = runif(10); mv.y = runif(10); } if (ok) stop(); }", __LINE__);
+	
 	// Run tests in a variety of combinations
 	_RunInteractionTypeTests_Nonspatial(false, false, false, "**");
 	_RunInteractionTypeTests_Nonspatial(true, false, false, "**");
@@ -3980,6 +4019,14 @@ void _RunTreeSeqTests(std::string temp_path)
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(recordMutations=T, simplificationRatio=INF, checkCoalescence=T, runCrosschecks=T); } " + gen1_setup_p1 + "100 { stop(); }", __LINE__);
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(recordMutations=F, simplificationRatio=0.0, checkCoalescence=T, runCrosschecks=T); } " + gen1_setup_p1 + "100 { stop(); }", __LINE__);
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(recordMutations=T, simplificationRatio=0.0, checkCoalescence=T, runCrosschecks=T); } " + gen1_setup_p1 + "100 { stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(runCrosschecks=T, simplificationMemory=2e4); } " + gen1_setup_p1 + "50 { sim.outputUsage(); } 100 { stop(); }", __LINE__);
+	if (Eidos_SlashTmpExists())
+	{
+		// unsimplified, these tables would have 2020 nodes and about as many edges by now; at 24+ bytes per row that is far over the budget
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(runCrosschecks=T, simplificationMemory=2e4); } " + gen1_setup_p1 + "100 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_memory.trees', simplify=F, _binary=F); n = size(readFile('" + temp_path + "/SLiM_treeSeq_memory.trees/NodeTable.txt')) - 1; e = size(readFile('" + temp_path + "/SLiM_treeSeq_memory.trees/EdgeTable.txt')) - 1; if ((n < 2000) & (n * 24 + e * 24 <= 2e4)) stop(); }", __LINE__);
+	}
+	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(simplificationRatio=10.0, simplificationMemory=1e6); } " + gen1_setup_p1 + "100 { stop(); }", 1, 15, "does not allow simplificationMemory", __LINE__);
+	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(simplificationMemory=0); } " + gen1_setup_p1 + "100 { stop(); }", 1, 15, "requires simplificationMemory to be > 0", __LINE__);
 	
 	// treeSeqCoalesced()
 	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "1: { sim.treeSeqCoalesced(); } 100 { stop(); }", 1, 290, "coalescence checking is enabled", __LINE__);
@@ -3988,6 +4035,38 @@ void _RunTreeSeqTests(std::string temp_path)
 	// treeSeqSimplify()
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "50 { sim.treeSeqSimplify(); } 100 { stop(); }", __LINE__);
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "1: { sim.treeSeqSimplify(); } 100 { stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeSLiMModelType('nonWF'); initializeTreeSeq(runCrosschecks=T); initializeMutationRate(1e-7); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); } reproduction() { subpop.addCrossed(individual, subpop.sampleIndividuals(1)); } 1 { sim.addSubpop('p1', 50); } early() { p1.fitnessScaling = 50 / p1.individualCount; } late() { if (sim.generation % 7 == 0) sim.treeSeqRememberIndividuals(p1.sampleIndividuals(2)); if (sim.generation % 3 == 0) sim.treeSeqSimplify(); } 100 { stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(simplificationInterval=2, runCrosschecks=T); initializeMutationRate(1e-7); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); } 1 { sim.addSubpop('p1', 50); } early() { if (sim.generation % 5 == 0) p1.genomes[0:3].addNewMutation(m1, 0.0, sim.generation); } fitness(m1) { if (runif(1) < 0.001) sim.treeSeqRememberIndividuals(individual); return relFitness; } 100 { stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(simplificationInterval=10); } " + gen1_setup_p1 + "5 late() { sim.treeSeqRememberIndividuals(p1.individuals[0:4]); } 11 early() { sim.addSubpop('p2', 10); } 31 early() { sim.addSubpopSplit('p3', 10, p1); } 60 late() { sim.treeSeqSimplify(); stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(runCrosschecks=T); initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } 1 { sim.addSubpop('p1', 50); } modifyChild() { if (runif(1) < 0.01) sim.outputUsage(); return (runif(1) < 0.7); } 30 { stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeSLiMModelType('nonWF'); initializeTreeSeq(simplificationInterval=2); initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } reproduction() { subpop.addCrossed(individual, subpop.sampleIndividuals(1)); } 1 { sim.addSubpop('p1', 50); } early() { p1.fitnessScaling = 50 / p1.individualCount; } modifyChild() { if (runif(1) < 0.05) sim.outputUsage(); return (runif(1) < 0.7); } recombination() { if (runif(1) < 0.01) sim.outputUsage(); return F; } 40 late() { sim.treeSeqSimplify(); stop(); }", __LINE__);
+	
+	// in multithreaded builds these simplify in the background every other generation; the genomes must keep the right node ids
+	// across new subpopulations, rejected children, and nonWF offspring, so site-mode diversity must match the genomes
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(simplificationInterval=2); initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); m1.convertToSubstitution = F; initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } function (integer$)diffs(o<Genome>$ x, o<Genome>$ y) { return size(unique(setSymmetricDifference(x.mutations, y.mutations).position)); } 1 { sim.addSubpop('p1', 20); } 25:26 early() { sim.addSubpop(sim.generation - 23, 10); sim.subpopulations[sim.generation - 24].setMigrationRates(p1, 0.1); } modifyChild() { return (runif(1) < 0.8); } 60 late() { g = sim.subpopulations.genomes; n = size(g); d = 0; for (i in 0:(n-2)) for (j in (i+1):(n-1)) d = d + diffs(g[i], g[j]); d = d / (n * (n - 1) / 2) / 100000; t = sim.treeSeqDiversity(); if ((d > 0) & (abs(t - d) < 1e-9 * d)) stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeSLiMModelType('nonWF'); initializeTreeSeq(simplificationInterval=2); initializeMutationRate(1e-6); initializeMutationType('m1', 0.5, 'f', 0.0); m1.convertToSubstitution = F; initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-7); } function (integer$)diffs(o<Genome>$ x, o<Genome>$ y) { return size(unique(setSymmetricDifference(x.mutations, y.mutations).position)); } reproduction() { subpop.addCrossed(individual, subpop.sampleIndividuals(1)); } 1 { sim.addSubpop('p1', 20); } 25:26 early() { sim.addSubpop(sim.generation - 23, 10); } early() { for (s in sim.subpopulations) s.fitnessScaling = 20 / s.individualCount; } modifyChild() { return (runif(1) < 0.8); } 60 late() { g = sim.subpopulations.genomes; n = size(g); d = 0; for (i in 0:(n-2)) for (j in (i+1):(n-1)) d = d + diffs(g[i], g[j]); d = d / (n * (n - 1) / 2) / 100000; t = sim.treeSeqDiversity(); if ((d > 0) & (abs(t - d) < 1e-9 * d)) stop(); }", __LINE__);
+	
+	// treeSeqDiversity(), treeSeqDivergence(), treeSeqSFS()
+	SLiMAssertScriptRaise(gen1_setup_p1 + "10 late() { sim.treeSeqDiversity(); }", 1, 259, "tree recording is enabled", __LINE__);
+	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "10 late() { sim.treeSeqDiversity(mode='foo'); }", 1, 297, "requires mode to be", __LINE__);
+	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "10 modifyChild() { sim.treeSeqSFS(); return T; }", 1, 304, "early() or late() event", __LINE__);
+	SLiMAssertScriptRaise("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "10 late() { sim.treeSeqDivergence(p1, 2); }", 1, 297, "not defined", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(runCrosschecks=T); } " + gen1_setup_highmut_p1 + "1 late() { sim.addSubpop('p2', 10); p1.setMigrationRates(p2, 0.1); } 10:50 late() { if (sim.generation % 10 == 0) sim.treeSeqDiversity(); } "
+						 "50 late() { ok = T; for (m in c('site', 'branch')) { s = sim.treeSeqSFS(c(p1, p2), mode=m); f = sim.treeSeqSFS(c(p1, p2), mode=m, folded=T); ok = ok & (sim.treeSeqDiversity(mode=m) > 0) & (sim.treeSeqDiversity(p1, mode=m) > 0) & (sim.treeSeqDivergence(p1, 2, mode=m) > 0); "
+						 "ok = ok & (size(s) == 41) & (size(f) == 21) & all(s >= 0) & all(f >= 0) & (abs(sum(s) - sum(f)) < 1e-9 * sum(s)); } if (ok) stop(); }", __LINE__);
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_sex_p1 + "20 late() { if ((sim.treeSeqDiversity(mode='branch') > 0) & (size(sim.treeSeqSFS(p1)) == 16)) stop(); }", __LINE__);
+	
+	// four genomes with mutations added by hand fully determine the site frequency spectrum: three singletons, one doubleton, and one tripleton
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); initializeMutationRate(0); initializeMutationType('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(0); } 1 { sim.addSubpop('p1', 2); } "
+						 "1 late() { g = p1.genomes; g[0].addNewDrawnMutation(m1, 100); g[0:1].addNewDrawnMutation(m1, 200); g[0:2].addNewDrawnMutation(m1, 300); g[3].addNewDrawnMutation(m1, c(400, 500)); "
+						 "s = sim.treeSeqSFS() * 100000; f = sim.treeSeqSFS(folded=T) * 100000; if ((size(s) == 5) & all(abs(s - c(0, 3, 1, 1, 0)) < 1e-9) & (size(f) == 3) & all(abs(f - c(0, 4, 1)) < 1e-9)) stop(); }", __LINE__);
+	
+	// with convertToSubstitution=F every mutation is still in the genomes, so site-mode diversity and divergence must match pairwise counts of differing positions
+	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); initializeMutationRate(1e-5); initializeMutationType('m1', 0.5, 'f', 0.0); m1.convertToSubstitution = F; initializeGenomicElementType('g1', m1, 1.0); initializeGenomicElement(g1, 0, 99999); initializeRecombinationRate(1e-8); } "
+						 "1 { sim.addSubpop('p1', 10); sim.addSubpop('p2', 10); p1.setMigrationRates(p2, 0.1); } function (integer$)diffs(o<Genome>$ x, o<Genome>$ y) { return size(unique(setSymmetricDifference(x.mutations, y.mutations).position)); } "
+						 "100 late() { g = sim.subpopulations.genomes; n = size(g); d = 0; for (i in 0:(n-2)) for (j in (i+1):(n-1)) d = d + diffs(g[i], g[j]); d = d / (n * (n - 1) / 2) / 100000; "
+						 "e = 0; for (a in p1.genomes) for (b in p2.genomes) e = e + diffs(a, b); e = e / (p1.individualCount * p2.individualCount * 4) / 100000; "
+						 "t = sim.treeSeqDiversity(); u = sim.treeSeqDivergence(p1, p2); if ((d > 0) & (abs(t - d) < 1e-9 * d) & (abs(u - e) < 1e-9 * e)) stop(); }", __LINE__);
 	
 	// treeSeqRememberIndividuals()
 	SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "50 { sim.treeSeqRememberIndividuals(p1.individuals); } 100 { sim.treeSeqSimplify(); stop(); }", __LINE__);
@@ -4005,6 +4084,26 @@ void _RunTreeSeqTests(std::string temp_path)
 		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "100 { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_2.trees', simplify=T, includeModel=F, _binary=F); stop(); }", __LINE__);
 		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "100 { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_3.trees', simplify=F, includeModel=F, _binary=T); stop(); }", __LINE__);
 		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "100 { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_4.trees', simplify=T, includeModel=F, _binary=T); stop(); }", __LINE__);
+		
+		// in-place output should match a normal write of the same state, and ends the simulation after the generation
+		SLiMAssertScriptSuccess("initialize() { initializeTreeSeq(); } " + gen1_setup_highmut_p1 + "50 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_5a.trees'); sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_5.trees', inPlace=T); } 51 { stop(); }", __LINE__);
+		SLiMAssertScriptSuccess("initialize() { initializeTreeSeq(); } " + gen1_setup_highmut_p1 + "50 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_6a.trees', simplify=F, _binary=F); sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_6.trees', simplify=F, inPlace=T, _binary=F); } 51 { stop(); }", __LINE__);
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup + "1 { sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_5a.trees'); m = p1.genomes.mutations.id; c = sapply(p1.genomes, 'size(applyValue.mutations);'); sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_5.trees'); defineConstant('SAME', (size(m) > 0) & identical(p1.genomes.mutations.id, m) & identical(sapply(p1.genomes, 'size(applyValue.mutations);'), c)); } 55 { sim.treeSeqSimplify(); if (SAME) stop(); }", __LINE__);
+		SLiMAssertScriptStop(gen1_setup + "1 { same = T; for (t in c('Node', 'Edge', 'Individual', 'Population', 'Site', 'Mutation')) same = same & identical(readFile('" + temp_path + "/SLiM_treeSeq_6a.trees/' + t + 'Table.txt'), readFile('" + temp_path + "/SLiM_treeSeq_6.trees/' + t + 'Table.txt')); if (same) stop(); }", __LINE__);
+		SLiMAssertScriptRaise("initialize() { initializeTreeSeq(); } " + gen1_setup_p1 + "50 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_9.trees', inPlace=T);\nsim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_7.trees'); }", 2, 4, "may only be called when tree recording is enabled", __LINE__);
+		
+		// compressed output should reload to the same state as uncompressed output, including the nucleotide reference sequence
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup_highmut_p1 + "100 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_8a.trees'); sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_8.trees', compress=T); stop(); }", __LINE__);
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup + "1 { sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_8a.trees'); m = p1.genomes.mutations.id; c = sapply(p1.genomes, 'size(applyValue.mutations);'); sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_8.trees'); defineConstant('SAME', (size(m) > 0) & identical(p1.genomes.mutations.id, m) & identical(sapply(p1.genomes, 'size(applyValue.mutations);'), c)); } 105 { sim.treeSeqSimplify(); if (SAME) stop(); }", __LINE__);
+		
+		std::string nuc_treeseq_setup("initialize() { initializeSLiMOptions(nucleotideBased=T); initializeTreeSeq(); initializeAncestralNucleotides(randomNucleotides(1e3)); initializeMutationTypeNuc('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-4)); initializeGenomicElement(g1, 0, 999); initializeRecombinationRate(1e-8); } ");
+		
+		SLiMAssertScriptStop(nuc_treeseq_setup + "1 { sim.addSubpop('p1', 10); } 20 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_nuc.trees'); sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_nuc_compressed.trees', compress=T); stop(); }", __LINE__);
+		SLiMAssertScriptStop(nuc_treeseq_setup + "1 { a0 = sim.chromosome.ancestralNucleotides(); sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_nuc.trees'); a = sim.chromosome.ancestralNucleotides(); m = p1.genomes.mutations.id; g = p1.genomes.nucleotides(); sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_nuc_compressed.trees'); if ((a != a0) & (size(m) > 0) & (sim.chromosome.ancestralNucleotides() == a) & identical(p1.genomes.mutations.id, m) & identical(p1.genomes.nucleotides(), g)) stop(); }", __LINE__);
+		
+		// 1000 diploids give 2000 sample genomes, enough for the genomes to be filled in parallel when reloading in multithreaded builds
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup + "1 { sim.addSubpop('p1', 1000); } 20 late() { sim.treeSeqOutput('" + temp_path + "/SLiM_treeSeq_large.trees'); writeFile('" + temp_path + "/SLiM_treeSeq_large_counts.txt', asString(sapply(p1.genomes, 'size(applyValue.mutations);'))); writeFile('" + temp_path + "/SLiM_treeSeq_large_ids.txt', asString(p1.genomes.mutations.id)); stop(); }", __LINE__);
+		SLiMAssertScriptStop("initialize() { initializeTreeSeq(); } " + gen1_setup + "1 { sim.readFromPopulationFile('" + temp_path + "/SLiM_treeSeq_large.trees'); c = asInteger(readFile('" + temp_path + "/SLiM_treeSeq_large_counts.txt')); if ((size(p1.genomes) == 2000) & (sum(c) > 0) & identical(sapply(p1.genomes, 'size(applyValue.mutations);'), c) & identical(p1.genomes.mutations.id, asInteger(readFile('" + temp_path + "/SLiM_treeSeq_large_ids.txt')))) stop(); }", __LINE__);
 	}
 }
 
@@ -4249,7 +4348,7 @@ void _RunNucleotideFunctionTests(void)
 	SLiMAssertScriptRaise(gen1_setup_p1 + "1 { codonsToNucleotides(0, format='foo'); }", 1, 247, "requires a format of", __LINE__);
 }
 
-void _RunNucleotideMethodTests(void)
+void _RunNucleotideMethodTests(std::string temp_path)
 {
 	// Test that various nucleotide-based APIs behave as they ought to when used in a non-nucleotide model
 	SLiMAssertScriptRaise("initialize() { initializeAncestralNucleotides('ACGT'); } ", 1, 15, "only be called in nucleotide-based models", __LINE__);
@@ -4423,11 +4522,38 @@ void _RunNucleotideMethodTests(void)
 	SLiMAssertScriptStop(ances_setup_integer + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=25, end=69, format='integer'), AS[25:69])) stop(); }", __LINE__);
 	SLiMAssertScriptStop(ances_setup_integer + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=10, end=39, format='codon'), nucleotidesToCodons(AS[10:39]))) stop(); }", __LINE__);
 	
+	// longer sequences, spanning many packed chunks with unaligned ends
+	std::string ances_setup_long = "initialize() { initializeSLiMOptions(nucleotideBased=T); defineConstant('AS', randomNucleotides(1e3, format='integer')); initializeAncestralNucleotides(AS); initializeMutationTypeNuc(1, 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-7)); initializeGenomicElement(g1, 0, 1e3-1); initializeRecombinationRate(1e-8); } ";
+	
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(sim.chromosome.ancestralNucleotides(format='integer'), AS)) stop(); }", __LINE__);
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=37, end=900, format='integer'), AS[37:900])) stop(); }", __LINE__);
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=37, end=900, format='char'), c('A','C','G','T')[AS[37:900]])) stop(); }", __LINE__);
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=37, end=900, format='string'), paste0(c('A','C','G','T')[AS[37:900]]))) stop(); }", __LINE__);
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(sim.chromosome.ancestralNucleotides(start=37, end=900, format='codon'), nucleotidesToCodons(AS[37:900]))) stop(); }", __LINE__);
+	SLiMAssertScriptStop(ances_setup_long + "1 { if (identical(nucleotideCounts(sim.chromosome.ancestralNucleotides(format='string')), nucleotideCounts(AS))) stop(); }", __LINE__);
+	
 	SLiMAssertScriptRaise(ances_setup_integer + "1 { sim.chromosome.ancestralNucleotides(start=-1, end=50, format='integer'); }", 1, 364, "within the chromosome's extent", __LINE__);
 	SLiMAssertScriptRaise(ances_setup_integer + "1 { sim.chromosome.ancestralNucleotides(start=50, end=100, format='integer'); }", 1, 364, "within the chromosome's extent", __LINE__);
 	SLiMAssertScriptRaise(ances_setup_integer + "1 { sim.chromosome.ancestralNucleotides(start=75, end=25, format='integer'); }", 1, 364, "start must be <= end", __LINE__);
 	SLiMAssertScriptRaise(ances_setup_integer + "1 { sim.chromosome.ancestralNucleotides(format='foo'); }", 1, 364, "format must be either", __LINE__);
 	
+	// initializeAncestralNucleotides() from a FASTA file
+	if (Eidos_SlashTmpExists())
+	{
+		std::string fasta_path = temp_path + "/slimAncestralTest.fa";
+		std::string fasta_setup_start = "initialize() { initializeSLiMOptions(nucleotideBased=T); ";
+		std::string fasta_setup_end = " L = initializeAncestralNucleotides('" + fasta_path + "'); initializeMutationTypeNuc(1, 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-7)); initializeGenomicElement(g1, 0, L-1); initializeRecombinationRate(1e-8); } ";
+		
+		SLiMAssertScriptStop(fasta_setup_start + "writeFile('" + fasta_path + "', c(';comment', '', '>seq1', 'ACGTA', 'CCGT', '>seq2', 'TTTT'));" + fasta_setup_end + "1 { if (sim.chromosome.ancestralNucleotides() == 'ACGTACCGT') stop(); }", __LINE__);
+		SLiMAssertScriptStop(fasta_setup_start + "defineConstant('S', randomNucleotides(1000)); writeFile('" + fasta_path + "', c('>seq1', substr(S, 0, 69), substr(S, 70, 139), substr(S, 140, 999)));" + fasta_setup_end + "1 { if (sim.chromosome.ancestralNucleotides() == S) stop(); }", __LINE__);
+		
+		std::string fasta_bad_nuc = fasta_setup_start + "writeFile('" + fasta_path + "', c('>seq1', 'ACNG'));" + fasta_setup_end;
+		std::string fasta_no_seq = fasta_setup_start + "writeFile('" + fasta_path + "', c('>seq1', '>seq2'));" + fasta_setup_end;
+		
+		SLiMAssertScriptRaise(fasta_bad_nuc, 1, (int)fasta_bad_nuc.find("initializeAncestralNucleotides"), "must contain only the nucleotides ACGT", __LINE__);
+		SLiMAssertScriptRaise(fasta_no_seq, 1, (int)fasta_no_seq.find("initializeAncestralNucleotides"), "no FASTA sequence found", __LINE__);
+	}
+	
 	// setHotspotMap()
 	std::string nuc_w_hotspot = nuc_model_init + "initialize() { initializeHotspotMap(c(1.0, 1.2), c(10, 1e2-1)); } ";
 	
@@ -4490,6 +4616,13 @@ void _RunNucleotideMethodTests(void)
 	SLiMAssertScriptStop(nuc_model_init + "1 { g1.setMutationMatrix(mmJukesCantor(0.25)); stop(); } ", __LINE__);
 	SLiMAssertScriptStop(nuc_model_init + "1 { g1.setMutationMatrix(mm16To256(mmJukesCantor(0.25))); stop(); } ", __LINE__);
 	
+	// per-genomic-element-type maximum mutation rates; an element whose type has a zero mutation matrix should never mutate
+	std::string nuc_two_getypes("initialize() { initializeSLiMOptions(nucleotideBased=T); initializeAncestralNucleotides(randomNucleotides(2e2)); initializeMutationTypeNuc('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-2)); initializeGenomicElementType('g2', m1, 1.0, mmJukesCantor(0.0)); initializeGenomicElement(g1, 0, 99); initializeGenomicElement(g2, 100, 199); initializeRecombinationRate(1e-8); } 1 { sim.addSubpop('p1', 10); } ");
+	
+	SLiMAssertScriptStop(nuc_two_getypes + "10 { p = c(sim.mutations.position, sim.substitutions.position); if ((size(p) > 0) & !any(p >= 100)) stop(); }", __LINE__);
+	SLiMAssertScriptStop(nuc_two_getypes + "5 { sim.chromosome.genomicElements[0].setGenomicElementType(g2); } 15 { o = c(sim.mutations.originGeneration, sim.substitutions.originGeneration); if ((size(o) > 0) & !any(o >= 5)) stop(); }", __LINE__);
+	SLiMAssertScriptStop(nuc_two_getypes + "5 { sim.chromosome.genomicElements[1].setGenomicElementType(g1); } 15 { if (any(c(sim.mutations.position, sim.substitutions.position) >= 100)) stop(); }", __LINE__);
+	
 	// nucleotide & nucleotideValue
 	std::string nuc_highmut("initialize() { initializeSLiMOptions(nucleotideBased=T); initializeAncestralNucleotides(randomNucleotides(1e2)); initializeMutationTypeNuc('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-2)); initializeGenomicElement(g1, 0, 1e2-1); initializeRecombinationRate(1e-8); } 1 { sim.addSubpop('p1', 10); } ");
 	std::string nuc_fixmut("initialize() { initializeSLiMOptions(nucleotideBased=T); initializeAncestralNucleotides(randomNucleotides(1e2)); initializeMutationTypeNuc('m1', 0.5, 'f', 0.0); initializeGenomicElementType('g1', m1, 1.0, mmJukesCantor(1e-2)); initializeGenomicElement(g1, 0, 1e2-1); initializeRecombinationRate(1e-8); } 1 { sim.addSubpop('p1', 10); } 10 { sim.mutations[0].setSelectionCoeff(500.0); sim.recalculateFitness(); } ");
@@ -23,6 +23,7 @@
 #include <ostream>
 #include <cmath>
 #include <string.h>
+#include <algorithm>
 
 #pragma mark -
 #pragma mark SparseArray
@@ -36,10 +37,11 @@ SparseArray::SparseArray(unsigned int p_nrows, unsigned int p_ncols)
 	nrows_ = p_nrows;
 	ncols_ = p_ncols;
 	nrows_set_ = 0;
+	nrows_capacity_ = p_nrows;
 	nnz_ = 0;
 	nnz_capacity_ = 1024;
 	
-	row_offsets_ = (uint32_t *)malloc((nrows_ + 1) * sizeof(uint32_t));
+	row_offsets_ = (uint32_t *)malloc((nrows_capacity_ + 1) * sizeof(uint32_t));
 	columns_ = (uint32_t *)malloc(nnz_capacity_ * sizeof(uint32_t));
 	distances_ = (sa_distance_t *)malloc(nnz_capacity_ * sizeof(sa_distance_t));
 	strengths_ = (sa_strength_t *)malloc(nnz_capacity_ * sizeof(sa_strength_t));
@@ -53,6 +55,7 @@ SparseArray::~SparseArray(void)
 	nrows_ = 0;
 	ncols_ = 0;
 	nrows_set_ = 0;
+	nrows_capacity_ = 0;
 	nnz_ = 0;
 	nnz_capacity_ = 0;
 	finished_ = false;
@@ -89,7 +92,13 @@ void SparseArray::Reset(unsigned int p_nrows, unsigned int p_ncols)
 	nrows_set_ = 0;
 	nnz_ = 0;
 	
-	row_offsets_ = (uint32_t *)realloc(row_offsets_, (nrows_ + 1) * sizeof(uint32_t));
+	// the row offsets buffer only ever grows, like the buffers for entries, so that re-evaluating a population of
+	// fluctuating size does not reallocate it each time
+	if (nrows_ > nrows_capacity_)
+	{
+		nrows_capacity_ = nrows_;
+		row_offsets_ = (uint32_t *)realloc(row_offsets_, (nrows_capacity_ + 1) * sizeof(uint32_t));
+	}
 	
 	row_offsets_[nrows_set_] = 0;
 	finished_ = false;
@@ -99,9 +108,26 @@ void SparseArray::_ResizeToFitNNZ(void)
 {
 	if (nnz_ > nnz_capacity_)	// guaranteed if we're called by ResizeToFitNNZ(), but might as well be safe...
 	{
+		// grow in 64 bits, since doubling a capacity of 2^31 or more would overflow; the capacity tops out at UINT32_MAX
+		uint64_t new_capacity = nnz_capacity_;
+		
 		do
-			nnz_capacity_ <<= 1;
-		while (nnz_ > nnz_capacity_);
+			new_capacity <<= 1;
+		while (nnz_ > new_capacity);
+		
+		nnz_capacity_ = (uint32_t)std::min(new_capacity, (uint64_t)UINT32_MAX);
+		
+		columns_ = (uint32_t *)realloc(columns_, nnz_capacity_ * sizeof(uint32_t));
+		distances_ = (sa_distance_t *)realloc(distances_, nnz_capacity_ * sizeof(sa_distance_t));
+		strengths_ = (sa_strength_t *)realloc(strengths_, nnz_capacity_ * sizeof(sa_strength_t));
+	}
+}
+
+void SparseArray::ReserveNNZ(uint32_t p_nnz_capacity)
+{
+	if (p_nnz_capacity > nnz_capacity_)
+	{
+		nnz_capacity_ = p_nnz_capacity;
 		
 		columns_ = (uint32_t *)realloc(columns_, nnz_capacity_ * sizeof(uint32_t));
 		distances_ = (sa_distance_t *)realloc(distances_, nnz_capacity_ * sizeof(sa_distance_t));
@@ -120,6 +146,8 @@ void SparseArray::AddRowDistances(uint32_t p_row, const uint32_t *p_columns, con
 		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowDistances): adding row out of order." << EidosTerminate(nullptr);
 	if ((p_row_nnz != 0) && (!p_columns || !p_distances))
 		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowDistances): null pointer supplied for non-empty row." << EidosTerminate(nullptr);
+	if (p_row_nnz > UINT32_MAX - nnz_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowDistances): too many entries for sparse array." << EidosTerminate(nullptr);
 	
 	// make room for the new entries
 	nnz_ += p_row_nnz;
@@ -144,6 +172,8 @@ void SparseArray::AddRowInteractions(uint32_t p_row, const uint32_t *p_columns,
 		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowInteractions): adding row out of order." << EidosTerminate(nullptr);
 	if ((p_row_nnz != 0) && (!p_columns || !p_distances || !p_strengths))
 		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowInteractions): null pointer supplied for non-empty row." << EidosTerminate(nullptr);
+	if (p_row_nnz > UINT32_MAX - nnz_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowInteractions): too many entries for sparse array." << EidosTerminate(nullptr);
 	
 	// make room for the new entries
 	nnz_ += p_row_nnz;
@@ -179,6 +209,9 @@ void SparseArray::AddEntryInteraction(uint32_t p_row, uint32_t p_column, sa_dist
 	if (p_column >= ncols_)
 		EIDOS_TERMINATION << "ERROR (SparseArray::AddEntryInteraction): adding column beyond the end of the sparse array." << EidosTerminate(nullptr);
 	
+	if (nnz_ == UINT32_MAX)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddEntryInteraction): too many entries for sparse array." << EidosTerminate(nullptr);
+	
 	// make room for the new entries
 	nnz_++;
 	ResizeToFitNNZ();
@@ -196,6 +229,39 @@ void SparseArray::AddEntryInteraction(uint32_t p_row, uint32_t p_column, sa_dist
 	strengths_[offset] = p_strength;
 }
 
+void SparseArray::AddRowsFromArray(const SparseArray &p_source, uint32_t p_source_first_row, uint32_t p_row_count, uint32_t p_first_row)
+{
+	// ensure that we are building sequentially, and that the rows exist and fit
+	if (finished_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowsFromArray): adding rows to sparse array that is finished." << EidosTerminate(nullptr);
+	if (p_first_row < nrows_set_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowsFromArray): adding rows out of order." << EidosTerminate(nullptr);
+	if ((p_first_row + p_row_count > nrows_) || (p_source_first_row + p_row_count > p_source.nrows_set_) || (p_source.ncols_ != ncols_))
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowsFromArray): source rows do not fit in the sparse array." << EidosTerminate(nullptr);
+	
+	// make room for the new entries
+	uint32_t offset = row_offsets_[nrows_set_];
+	uint32_t source_offset = p_source.row_offsets_[p_source_first_row];
+	uint32_t copy_nnz = p_source.row_offsets_[p_source_first_row + p_row_count] - source_offset;
+	
+	if (copy_nnz > UINT32_MAX - nnz_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AddRowsFromArray): too many entries for sparse array." << EidosTerminate(nullptr);
+	
+	nnz_ += copy_nnz;
+	ResizeToFitNNZ();
+	
+	// add intervening empty rows, then the source rows with their offsets shifted
+	while (p_first_row > nrows_set_)
+		row_offsets_[++nrows_set_] = offset;
+	
+	for (uint32_t source_row = p_source_first_row + 1; source_row <= p_source_first_row + p_row_count; ++source_row)
+		row_offsets_[++nrows_set_] = offset + (p_source.row_offsets_[source_row] - source_offset);
+	
+	memcpy(columns_ + offset, p_source.columns_ + source_offset, copy_nnz * sizeof(uint32_t));
+	memcpy(distances_ + offset, p_source.distances_ + source_offset, copy_nnz * sizeof(sa_distance_t));
+	memcpy(strengths_ + offset, p_source.strengths_ + source_offset, copy_nnz * sizeof(sa_strength_t));
+}
+
 void SparseArray::Finished(void)
 {
 	if (finished_)
@@ -371,11 +437,26 @@ void SparseArray::InteractionsForRow(uint32_t p_row, uint32_t *p_row_nnz, uint32
 		*p_row_strengths = strengths_ + offset;
 }
 
+void SparseArray::AllInteractions(uint32_t *p_nnz, sa_distance_t **p_distances, sa_strength_t **p_strengths)
+{
+#if DEBUG
+	// should be done building the array
+	if (!finished_)
+		EIDOS_TERMINATION << "ERROR (SparseArray::AllInteractions): sparse array is not finished being built." << EidosTerminate(nullptr);
+#endif
+	
+	*p_nnz = nnz_;
+	if (p_distances)
+		*p_distances = distances_;
+	if (p_strengths)
+		*p_strengths = strengths_;
+}
+
 size_t SparseArray::MemoryUsage(void)
 {
 	size_t usage = 0;
 	
-	usage += sizeof(uint32_t) * (nrows_ + 1);
+	usage += sizeof(uint32_t) * (nrows_capacity_ + 1);
 	usage += (sizeof(uint32_t) + sizeof(sa_distance_t) + sizeof(sa_strength_t)) * (nnz_capacity_);
 	
 	return usage;
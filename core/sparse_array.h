@@ -57,6 +57,7 @@ private:
 	
 	uint32_t nrows_, ncols_;		// the number of rows and columns; determined at construction time
 	uint32_t nrows_set_;			// the number of rows that have been configured (at least partially, during building)
+	uint32_t nrows_capacity_;		// the number of rows allocated for in row_offsets_ at present (plus the extra end entry)
 	uint32_t nnz_;					// the number of non-zero entries in the sparse array (also at row_offsets[nrows_set])
 	uint32_t nnz_capacity_;			// the number of non-zero entries allocated for at present
 	
@@ -74,6 +75,7 @@ public:
 	
 	void Reset(void);											// reset to a dimensionless state, keeping buffers
 	void Reset(unsigned int p_nrows, unsigned int p_ncols);		// reset to new dimensions, keeping buffers
+	void ReserveNNZ(uint32_t p_nnz_capacity);					// ensure buffers for at least this many entries, to avoid regrowth
 	
 	// Building a sparse array; has to be done in row order, and then has to be Finished().  SparseArray supports building
 	// a row at a time, or one entry at a time, but one or the other method must be chosen and used throughout the build.
@@ -108,6 +110,9 @@ public:
 			EIDOS_TERMINATION << "ERROR (SparseArray::AddEntryDistance): (internal error) adding column beyond the end of the sparse array." << EidosTerminate(nullptr);
 #endif
 		
+		if (nnz_ == UINT32_MAX)
+			EIDOS_TERMINATION << "ERROR (SparseArray::AddEntryDistance): too many entries for sparse array." << EidosTerminate(nullptr);
+		
 		// make room for the new entries
 		nnz_++;
 		ResizeToFitNNZ();
@@ -125,6 +130,12 @@ public:
 	}
 	void AddEntryInteraction(uint32_t p_row, const uint32_t p_column, sa_distance_t p_distance, sa_strength_t p_strength);
 	
+	// Appends p_row_count rows of p_source, a separate sparse array with the same column count, starting at its row
+	// p_source_first_row, as rows starting at p_first_row of this sparse array.  This allows disjoint blocks of rows to be
+	// built independently (on different threads, perhaps) and then merged in order, and allows unchanged rows to be copied
+	// from an older sparse array.  Distances and strengths are both copied, whether or not they have been set.
+	void AddRowsFromArray(const SparseArray &p_source, uint32_t p_source_first_row, uint32_t p_row_count, uint32_t p_first_row);
+	
 	void Finished(void);
 	inline __attribute__((always_inline)) bool IsFinished() const { return finished_; };
 	
@@ -133,6 +144,7 @@ public:
 	inline __attribute__((always_inline)) uint32_t ColumnCount() const { return ncols_; };
 	
 	inline __attribute__((always_inline)) uint32_t AddedRowCount() const { return nrows_set_; };	// the number of rows that have been (at least partially) added
+	inline __attribute__((always_inline)) uint32_t NonZeroCount() const { return nnz_; };			// the number of entries added so far
 	
 	// Accessing the sparse array	
 	sa_distance_t Distance(uint32_t p_row, uint32_t p_column) const;
@@ -148,6 +160,10 @@ public:
 	// Non-const access, for filling in strength values after the fact (among other uses)
 	void InteractionsForRow(uint32_t p_row, uint32_t *p_row_nnz, uint32_t **p_row_columns, sa_distance_t **p_row_distances, sa_strength_t **p_row_strengths);
 	
+	// Non-const access to every entry at once; since rows are stored contiguously in row order, all of the distances and
+	// strengths form two flat buffers of NNZ entries, which allows strengths to be filled in with a single tight loop
+	void AllInteractions(uint32_t *p_nnz, sa_distance_t **p_distances, sa_strength_t **p_strengths);
+	
 	friend std::ostream &operator<<(std::ostream &p_outstream, const SparseArray &p_array);
 };
 
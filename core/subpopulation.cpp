@@ -605,6 +605,10 @@ void Subpopulation::GenerateParentsToFit(slim_age_t p_initial_age, double p_sex_
 	cached_parent_genomes_value_.reset();
 	cached_parent_individuals_value_.reset();
 	
+	// this subpopulation is not yet in the population, so a background simplification could not renumber our new genomes
+	if (recording_tree_sequence)
+		sim.FinishBackgroundSimplification();
+	
 	if (parent_individuals_.size() || parent_genomes_.size())
 		EIDOS_TERMINATION << "ERROR (Subpopulation::GenerateParentsToFit): (internal error) individuals or genomes already present in GenerateParentsToFit()." << EidosTerminate();
 	if ((parent_subpop_size_ == 0) && !p_allow_zero_size)
@@ -862,6 +866,9 @@ void Subpopulation::CheckIndividualIntegrity(void)
 #endif	// SLIM_WF_ONLY
 		{
 			// When the parental generation is valid, all parental genomes should have non-null mutrun pointers
+			if (genome1->RunArrayIsShared() || genome2->RunArrayIsShared())
+				EIDOS_TERMINATION << "ERROR (Subpopulation::CheckIndividualIntegrity): (internal error) a parental genome shares its array of mutation runs." << EidosTerminate();
+			
 			for (int mutrun_index = 0; mutrun_index < genome1->mutrun_count_; ++mutrun_index)
 				if (genome1->mutruns_[mutrun_index].get() == nullptr)
 					EIDOS_TERMINATION << "ERROR (Subpopulation::CheckIndividualIntegrity): (internal error) a parental genome has a null mutrun pointer." << EidosTerminate();
@@ -4911,6 +4918,10 @@ EidosValue_SP Subpopulation::ExecuteMethod_takeMigrants(EidosGlobalStringID p_me
 		(individual->subpopulation_).individual_pool_->DisposeChunk(const_cast<Individual *>(individual));
 	}
 	
+	// Cached mutation counts/frequencies for subsets of subpops are no longer accurate; the whole-population tally would still be
+	// fine, but we don't bother distinguishing, since migration with takeMigrants() is generally not done repeatedly in a generation
+	population_.InvalidateMutationReferencesCache();
+	
 	return gStaticEidosValueVOID;
 }
 
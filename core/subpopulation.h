@@ -314,7 +314,7 @@ public:
 				{
 					// the number of mutruns has changed; need to reallocate
 					if (back->mutruns_ != back->run_buffer_)
-						delete[] back->mutruns_;
+						Genome::FreeRunArray(back->mutruns_);
 					
 					back->mutrun_count_ = p_mutrun_count;
 					back->mutrun_length_ = p_mutrun_length;
@@ -322,7 +322,7 @@ public:
 					if (p_mutrun_count <= SLIM_GENOME_MUTRUN_BUFSIZE)
 						back->mutruns_ = back->run_buffer_;
 					else
-						back->mutruns_ = new MutationRun_SP[p_mutrun_count];
+						back->mutruns_ = Genome::NewRunArray(p_mutrun_count);
 				}
 				return back;
 			}
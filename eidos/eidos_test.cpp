@@ -1958,7 +1958,7 @@ void _RunOperatorPlusTests2(void)
 	EidosAssertScriptRaise("identical(array(1:6,c(1,2,3)) + array(1:6,c(3,2,1)), array(2:7, c(1,2,3)));", 30, "non-conformable");
 }
 
-#pragma mark operator −
+#pragma mark operator -
 void _RunOperatorMinusTests(void)
 {
 	// operator -
@@ -1,4 +1,4 @@
-#ifdef __unix__
+#if defined(__unix__) || defined(__APPLE__)
 #define _POSIX_C_SOURCE 1
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -87,6 +87,279 @@ type_size(int type)
     return type_size_map[type];
 }
 
+/* Compression.
+ *
+ * In a compressed store, each array is written as a one-byte encoding followed
+ * by the encoded data, and its size in the file is recorded in the reserved
+ * bytes of its descriptor. Integer arrays may be delta-encoded, with the
+ * differences zigzag-mapped and written as LEB128 varints; float64 arrays whose
+ * values are all integers may be converted to int64 and encoded the same way.
+ * Each array takes the smallest of its possible encodings, which is the raw
+ * bytes when nothing else helps. A compressed store is written with file
+ * version KAS_FILE_VERSION_MAJOR_COMPRESSED, so that readers without
+ * compression support reject it rather than misreading it. */
+
+#define KAS_HEADER_COMPRESSED       1
+
+#define KAS_ENCODING_RAW            0
+#define KAS_ENCODING_DELTA          1
+#define KAS_ENCODING_INTEGRAL_DELTA 2
+
+#define KAS_WRITE_CHUNK_SIZE        8192
+
+static uint64_t
+kas_get_element(const void *array, int type, size_t j)
+{
+    uint64_t value = 0;
+
+    switch (type) {
+        case KAS_INT8:
+            value = (uint64_t) (int64_t) ((const int8_t *) array)[j];
+            break;
+        case KAS_UINT8:
+            value = (uint64_t) ((const uint8_t *) array)[j];
+            break;
+        case KAS_INT16:
+            value = (uint64_t) (int64_t) ((const int16_t *) array)[j];
+            break;
+        case KAS_UINT16:
+            value = (uint64_t) ((const uint16_t *) array)[j];
+            break;
+        case KAS_INT32:
+            value = (uint64_t) (int64_t) ((const int32_t *) array)[j];
+            break;
+        case KAS_UINT32:
+            value = (uint64_t) ((const uint32_t *) array)[j];
+            break;
+        case KAS_INT64:
+            value = (uint64_t) ((const int64_t *) array)[j];
+            break;
+        case KAS_UINT64:
+            value = ((const uint64_t *) array)[j];
+            break;
+        case KAS_FLOAT64:
+            value = (uint64_t) (int64_t) ((const double *) array)[j];
+            break;
+    }
+    return value;
+}
+
+static void
+kas_set_element(void *array, int type, size_t j, uint64_t value)
+{
+    switch (type) {
+        case KAS_INT8:
+            ((int8_t *) array)[j] = (int8_t) value;
+            break;
+        case KAS_UINT8:
+            ((uint8_t *) array)[j] = (uint8_t) value;
+            break;
+        case KAS_INT16:
+            ((int16_t *) array)[j] = (int16_t) value;
+            break;
+        case KAS_UINT16:
+            ((uint16_t *) array)[j] = (uint16_t) value;
+            break;
+        case KAS_INT32:
+            ((int32_t *) array)[j] = (int32_t) value;
+            break;
+        case KAS_UINT32:
+            ((uint32_t *) array)[j] = (uint32_t) value;
+            break;
+        case KAS_INT64:
+            ((int64_t *) array)[j] = (int64_t) value;
+            break;
+        case KAS_UINT64:
+            ((uint64_t *) array)[j] = value;
+            break;
+        case KAS_FLOAT64:
+            ((double *) array)[j] = (double) (int64_t) value;
+            break;
+    }
+}
+
+/* Returns true if every value converts to int64 and back unchanged; values
+ * beyond 2^53, non-finite values, and negative zero do not. */
+static bool
+kas_float64_is_integral(const double *array, size_t array_len)
+{
+    size_t j;
+    double value;
+    uint64_t bits;
+
+    for (j = 0; j < array_len; j++) {
+        value = array[j];
+        if (!(value >= -9007199254740992.0 && value <= 9007199254740992.0)) {
+            return false;
+        }
+        if (value != (double) (int64_t) value) {
+            return false;
+        }
+        memcpy(&bits, &value, sizeof(bits));
+        if (value == 0 && bits != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t
+kas_zigzag_delta(uint64_t value, uint64_t previous)
+{
+    uint64_t delta = value - previous;
+
+    return (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63);
+}
+
+static size_t
+kas_varint_size(uint64_t value)
+{
+    size_t size = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static size_t
+kas_put_varint(uint8_t *buffer, uint64_t value)
+{
+    size_t size = 0;
+
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t) value;
+    return size;
+}
+
+/* Sets the encoding and encoded size of an item being written. */
+static void
+kas_choose_encoding(kaitem_t *item)
+{
+    size_t j, delta_size;
+    uint64_t value, previous = 0;
+
+    item->encoding = KAS_ENCODING_RAW;
+    item->encoded_size = 1 + item->array_len * type_size(item->type);
+
+    if (item->type == KAS_FLOAT32) {
+        return;
+    }
+    if (item->type == KAS_FLOAT64
+            && !kas_float64_is_integral((const double *) item->array, item->array_len)) {
+        return;
+    }
+    delta_size = 1;
+    for (j = 0; j < item->array_len; j++) {
+        value = kas_get_element(item->array, item->type, j);
+        delta_size += kas_varint_size(kas_zigzag_delta(value, previous));
+        previous = value;
+    }
+    if (delta_size < item->encoded_size) {
+        item->encoding = item->type == KAS_FLOAT64?
+            KAS_ENCODING_INTEGRAL_DELTA: KAS_ENCODING_DELTA;
+        item->encoded_size = delta_size;
+    }
+}
+
+static int KAS_WARN_UNUSED
+kastore_write_encoded_array(kastore_t *self, const kaitem_t *item)
+{
+    int ret = 0;
+    uint8_t buffer[KAS_WRITE_CHUNK_SIZE + 16];
+    size_t j, size = 0;
+    uint64_t value, previous = 0;
+
+    buffer[size++] = (uint8_t) item->encoding;
+    if (item->encoding == KAS_ENCODING_RAW) {
+        if (fwrite(buffer, size, 1, self->file) != 1) {
+            ret = KAS_ERR_IO;
+            goto out;
+        }
+        size = item->array_len * type_size(item->type);
+        if (size > 0 && fwrite(item->array, size, 1, self->file) != 1) {
+            ret = KAS_ERR_IO;
+            goto out;
+        }
+    } else {
+        for (j = 0; j < item->array_len; j++) {
+            value = kas_get_element(item->array, item->type, j);
+            size += kas_put_varint(buffer + size, kas_zigzag_delta(value, previous));
+            previous = value;
+            if (size >= KAS_WRITE_CHUNK_SIZE) {
+                if (fwrite(buffer, size, 1, self->file) != 1) {
+                    ret = KAS_ERR_IO;
+                    goto out;
+                }
+                size = 0;
+            }
+        }
+        if (size > 0 && fwrite(buffer, size, 1, self->file) != 1) {
+            ret = KAS_ERR_IO;
+            goto out;
+        }
+    }
+out:
+    return ret;
+}
+
+/* Decodes an item's array from the file data into a newly allocated array. */
+static int KAS_WARN_UNUSED
+kastore_decode_item(kaitem_t *item, const uint8_t *data)
+{
+    int ret = KAS_ERR_BAD_FILE_FORMAT;
+    size_t size = item->array_len * type_size(item->type);
+    size_t j, offset, shift;
+    uint64_t value, delta, previous = 0;
+    int encoding;
+
+    item->array = malloc(size == 0? 1: size);
+    if (item->array == NULL) {
+        ret = KAS_ERR_NO_MEMORY;
+        goto out;
+    }
+    if (item->encoded_size < 1) {
+        goto out;
+    }
+    encoding = data[0];
+    offset = 1;
+    if (encoding == KAS_ENCODING_RAW) {
+        if (item->encoded_size != 1 + size) {
+            goto out;
+        }
+        memcpy(item->array, data + offset, size);
+    } else if ((encoding == KAS_ENCODING_DELTA
+                && item->type != KAS_FLOAT32 && item->type != KAS_FLOAT64)
+            || (encoding == KAS_ENCODING_INTEGRAL_DELTA && item->type == KAS_FLOAT64)) {
+        for (j = 0; j < item->array_len; j++) {
+            value = 0;
+            shift = 0;
+            do {
+                if (offset >= item->encoded_size || shift > 63) {
+                    goto out;
+                }
+                value |= (uint64_t) (data[offset] & 0x7F) << shift;
+                shift += 7;
+            } while (data[offset++] & 0x80);
+            delta = (value >> 1) ^ (0 - (value & 1));
+            previous += delta;
+            kas_set_element(item->array, item->type, j, previous);
+        }
+        if (offset != item->encoded_size) {
+            goto out;
+        }
+    } else {
+        goto out;
+    }
+    ret = 0;
+out:
+    return ret;
+}
+
 /* Compare item keys lexicographically. */
 static int
 compare_items(const void *a, const void *b) {
@@ -120,10 +393,13 @@ kastore_write_header(kastore_t *self)
 {
     int ret = 0;
     char header[KAS_HEADER_SIZE];
-    uint16_t version_major = KAS_FILE_VERSION_MAJOR;
+    bool compressed = !!(self->flags & KAS_COMPRESS);
+    uint16_t version_major = compressed? KAS_FILE_VERSION_MAJOR_COMPRESSED:
+        KAS_FILE_VERSION_MAJOR;
     uint16_t version_minor = KAS_FILE_VERSION_MINOR;
     uint32_t num_items = (uint32_t) self->num_items;
     uint64_t file_size = (uint64_t) self->file_size;
+    uint32_t header_flags = compressed? KAS_HEADER_COMPRESSED: 0;
 
     memset(header, 0, sizeof(header));
     memcpy(header, KAS_MAGIC, 8);
@@ -131,6 +407,7 @@ kastore_write_header(kastore_t *self)
     memcpy(header + 10, &version_minor, 2);
     memcpy(header + 12, &num_items, 4);
     memcpy(header + 16, &file_size, 8);
+    memcpy(header + 24, &header_flags, 4);
     /* Rest of header is reserved */
     if (fwrite(header, KAS_HEADER_SIZE, 1, self->file) != 1) {
         ret = KAS_ERR_IO;
@@ -148,6 +425,7 @@ kastore_read_header(kastore_t *self)
     uint16_t version_major, version_minor;
     uint32_t num_items;
     uint64_t file_size;
+    uint32_t header_flags;
     size_t count;
 
     count = fread(header, KAS_HEADER_SIZE, 1, self->file);
@@ -163,15 +441,31 @@ kastore_read_header(kastore_t *self)
     memcpy(&version_minor, header + 10, 2);
     memcpy(&num_items, header + 12, 4);
     memcpy(&file_size, header + 16, 8);
+    memcpy(&header_flags, header + 24, 4);
     self->file_version[0] = (int) version_major;
     self->file_version[1] = (int) version_minor;
     if (self->file_version[0] < KAS_FILE_VERSION_MAJOR) {
         ret = KAS_ERR_VERSION_TOO_OLD;
         goto out;
-    } else if (self->file_version[0] > KAS_FILE_VERSION_MAJOR) {
+    } else if (self->file_version[0] > KAS_FILE_VERSION_MAJOR_COMPRESSED) {
         ret = KAS_ERR_VERSION_TOO_NEW;
         goto out;
     }
+    if (header_flags & ~((uint32_t) KAS_HEADER_COMPRESSED)) {
+        ret = KAS_ERR_BAD_FILE_FORMAT;
+        goto out;
+    }
+    /* The compressed flag must agree with the file version */
+    if ((self->file_version[0] == KAS_FILE_VERSION_MAJOR_COMPRESSED)
+            != !!(header_flags & KAS_HEADER_COMPRESSED)) {
+        ret = KAS_ERR_BAD_FILE_FORMAT;
+        goto out;
+    }
+    /* Whether the store is compressed is determined by the file, not the caller */
+    self->flags &= ~KAS_COMPRESS;
+    if (header_flags & KAS_HEADER_COMPRESSED) {
+        self->flags |= KAS_COMPRESS;
+    }
     self->num_items = num_items;
     self->file_size = (size_t) file_size;
     if (self->file_size < KAS_HEADER_SIZE) {
@@ -201,7 +495,8 @@ kastore_pack_items(kastore_t *self)
             offset += KAS_ARRAY_ALIGN - remainder;
         }
         self->items[j].array_start = offset;
-        offset += self->items[j].array_len * type_size(self->items[j].type);
+        offset += (self->flags & KAS_COMPRESS)? self->items[j].encoded_size:
+            self->items[j].array_len * type_size(self->items[j].type);
     }
     self->file_size = offset;
 }
@@ -212,7 +507,7 @@ kastore_write_descriptors(kastore_t *self)
     int ret = 0;
     size_t j;
     uint8_t type;
-    uint64_t key_start, key_len, array_start, array_len;
+    uint64_t key_start, key_len, array_start, array_len, encoded_size;
     char descriptor[KAS_ITEM_DESCRIPTOR_SIZE];
 
     for (j = 0; j < self->num_items; j++) {
@@ -228,6 +523,10 @@ kastore_write_descriptors(kastore_t *self)
         memcpy(descriptor + 16, &key_len, 8);
         memcpy(descriptor + 24, &array_start, 8);
         memcpy(descriptor + 32, &array_len, 8);
+        if (self->flags & KAS_COMPRESS) {
+            encoded_size = (uint64_t) self->items[j].encoded_size;
+            memcpy(descriptor + 40, &encoded_size, 8);
+        }
         /* Rest of descriptor is reserved */
         if (fwrite(descriptor, sizeof(descriptor), 1, self->file) != 1) {
             ret = KAS_ERR_IO;
@@ -244,7 +543,7 @@ kastore_read_descriptors(kastore_t *self)
     int ret = KAS_ERR_BAD_FILE_FORMAT;
     size_t j;
     uint8_t type;
-    uint64_t key_start, key_len, array_start, array_len;
+    uint64_t key_start, key_len, array_start, array_len, encoded_size;
     char *descriptor;
     size_t descriptor_offset, offset, remainder, size, count;
     char *read_buffer = NULL;
@@ -273,6 +572,7 @@ kastore_read_descriptors(kastore_t *self)
         memcpy(&key_len, descriptor + 16, 8);
         memcpy(&array_start, descriptor + 24, 8);
         memcpy(&array_len, descriptor + 32, 8);
+        memcpy(&encoded_size, descriptor + 40, 8);
 
         if (type >= KAS_NUM_TYPES) {
             ret = KAS_ERR_BAD_TYPE;
@@ -284,11 +584,15 @@ kastore_read_descriptors(kastore_t *self)
         }
         self->items[j].key_start = (size_t) key_start;
         self->items[j].key_len = (size_t) key_len;
-        if (array_start + array_len * type_size(type) > self->file_size) {
+        if (!(self->flags & KAS_COMPRESS)) {
+            encoded_size = array_len * type_size(type);
+        }
+        if (array_start + encoded_size > self->file_size) {
             goto out;
         }
         self->items[j].array_start = (size_t) array_start;
         self->items[j].array_len = (size_t) array_len;
+        self->items[j].encoded_size = (size_t) encoded_size;
     }
 
     /* Check the integrity of the key and array packing. Keys must
@@ -311,7 +615,7 @@ kastore_read_descriptors(kastore_t *self)
             ret = KAS_ERR_BAD_FILE_FORMAT;
             goto out;
         }
-        offset += self->items[j].array_len * type_size(self->items[j].type);
+        offset += self->items[j].encoded_size;
     }
     if (offset != self->file_size) {
         ret = KAS_ERR_BAD_FILE_FORMAT;
@@ -349,10 +653,18 @@ kastore_write_data(kastore_t *self)
             ret = KAS_ERR_IO;
             goto out;
         }
-        size = self->items[j].array_len * type_size(self->items[j].type);
-        if (size > 0 && fwrite(self->items[j].array, size, 1, self->file) != 1) {
-            ret = KAS_ERR_IO;
-            goto out;
+        if (self->flags & KAS_COMPRESS) {
+            ret = kastore_write_encoded_array(self, self->items + j);
+            if (ret != 0) {
+                goto out;
+            }
+            size = self->items[j].encoded_size;
+        } else {
+            size = self->items[j].array_len * type_size(self->items[j].type);
+            if (size > 0 && fwrite(self->items[j].array, size, 1, self->file) != 1) {
+                ret = KAS_ERR_IO;
+                goto out;
+            }
         }
         offset = self->items[j].array_start + size;
     }
@@ -367,32 +679,58 @@ kastore_read_file(kastore_t *self)
     int err;
     size_t count, size, j;
     bool read_all = !!(self->flags & KAS_READ_ALL);
+    bool compressed = !!(self->flags & KAS_COMPRESS);
 
     size = self->file_size;
-    if (!read_all) {
+    if (!read_all && !compressed) {
         /* Read in up to the start of first array. This will contain all the keys. */
         size = self->items[0].array_start;
     }
 
-    self->read_buffer = malloc(size);
-    if (self->read_buffer == NULL) {
-        ret = KAS_ERR_NO_MEMORY;
-        goto out;
-    }
-    err = fseek(self->file, 0, SEEK_SET);
-    if (err != 0) {
-        ret = KAS_ERR_IO;
-        goto out;
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+
+    /* Only map a file that is as long as its header says, since touching mapped
+     * pages past the end of a truncated file raises SIGBUS rather than an error;
+     * a short file falls through to fread, which reports it as such. */
+    if ((self->flags & KAS_MMAP) && size > 0
+            && fstat(fileno(self->file), &st) == 0 && (size_t) st.st_size >= size) {
+        void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fileno(self->file), 0);
+        if (mapping != MAP_FAILED) {
+            self->read_buffer = mapping;
+            self->read_buffer_mapped = 1;
+        }
     }
-    count = fread(self->read_buffer, size, 1, self->file);
-    if (count == 0) {
-        ret = kastore_get_read_io_error(self);
-        goto out;
+#endif
+    if (self->read_buffer == NULL) {
+        self->read_buffer = malloc(size);
+        if (self->read_buffer == NULL) {
+            ret = KAS_ERR_NO_MEMORY;
+            goto out;
+        }
+        err = fseek(self->file, 0, SEEK_SET);
+        if (err != 0) {
+            ret = KAS_ERR_IO;
+            goto out;
+        }
+        count = fread(self->read_buffer, size, 1, self->file);
+        if (count == 0) {
+            ret = kastore_get_read_io_error(self);
+            goto out;
+        }
     }
     /* Assign the pointers for the keys and arrays */
     for (j = 0; j < self->num_items; j++) {
         self->items[j].key = self->read_buffer + self->items[j].key_start;
-        if (read_all) {
+        if (compressed) {
+            /* Compressed arrays are all decoded now, into arrays of their own */
+            ret = kastore_decode_item(self->items + j,
+                    (const uint8_t *) self->read_buffer + self->items[j].array_start);
+            if (ret != 0) {
+                goto out;
+            }
+        } else if (read_all) {
             self->items[j].array = self->read_buffer + self->items[j].array_start;
         }
     }
@@ -433,8 +771,14 @@ static int KAS_WARN_UNUSED
 kastore_write_file(kastore_t *self)
 {
     int ret = 0;
+    size_t j;
 
     qsort(self->items, self->num_items, sizeof(kaitem_t), compare_items);
+    if (self->flags & KAS_COMPRESS) {
+        for (j = 0; j < self->num_items; j++) {
+            kas_choose_encoding(self->items + j);
+        }
+    }
     kastore_pack_items(self);
     ret = kastore_write_header(self);
     if (ret != 0) {
@@ -532,6 +876,10 @@ kastore_open(kastore_t *self, const char *filename, const char *mode, int flags)
         goto out;
     }
     self->flags = flags;
+    if (self->mode == KAS_READ && (flags & KAS_MMAP)) {
+        /* A mapped file is always read in full */
+        self->flags |= KAS_READ_ALL;
+    }
     self->filename = filename;
     if (appending) {
         ret = kastore_open(&tmp, self->filename, "r", KAS_READ_ALL);
@@ -583,13 +931,21 @@ kastore_close(kastore_t *self)
             /* We only alloc memory for the keys and arrays in write mode */
             for (j = 0; j < self->num_items; j++) {
                 kas_safe_free(self->items[j].key);
-                kas_safe_free(self->items[j].array);
+                if (! self->items[j].borrowed) {
+                    kas_safe_free(self->items[j].array);
+                }
             }
         }
     } else {
+#if defined(__unix__) || defined(__APPLE__)
+        if (self->read_buffer_mapped) {
+            munmap(self->read_buffer, self->file_size);
+            self->read_buffer = NULL;
+        }
+#endif
         kas_safe_free(self->read_buffer);
-        if (! (self->flags & KAS_READ_ALL)) {
-            /* The arrays have been individually malloced on demand. */
+        if (! (self->flags & KAS_READ_ALL) || (self->flags & KAS_COMPRESS)) {
+            /* The arrays have been individually malloced on demand, or decoded. */
             if (self->items != NULL) {
                 for (j = 0; j < self->num_items; j++) {
                     kas_safe_free(self->items[j].array);
@@ -765,6 +1121,11 @@ kastore_put(kastore_t *self, const char *key, size_t key_len,
         ret = KAS_ERR_BAD_TYPE;
         goto out;
     }
+    if (flags & KAS_BORROWS_ARRAY) {
+        /* The caller keeps ownership of the array, so we refer to it directly */
+        ret = kastore_oput(self, key, key_len, (void *) array, array_len, type, flags);
+        goto out;
+    }
     array_size = type_size(type) * array_len;
     array_copy = malloc(array_size == 0? 1: array_size);
     if (array_copy == NULL) {
@@ -785,7 +1146,7 @@ out:
 
 int KAS_WARN_UNUSED
 kastore_oput(kastore_t *self, const char *key, size_t key_len,
-       void *array, size_t array_len, int type, int KAS_UNUSED(flags))
+       void *array, size_t array_len, int type, int flags)
 {
     int ret = 0;
     kaitem_t *new_item;
@@ -819,6 +1180,7 @@ kastore_oput(kastore_t *self, const char *key, size_t key_len,
     new_item->key_len = key_len;
     new_item->array_len = array_len;
     new_item->array = array;
+    new_item->borrowed = (flags & KAS_BORROWS_ARRAY) != 0;
     new_item->key = malloc(key_len);
     if (new_item->key == NULL) {
         kas_safe_free(new_item->key);
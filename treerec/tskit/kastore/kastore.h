@@ -87,6 +87,11 @@ The requested type does not match the type of the stored values.
 
 /* Flags for open */
 #define KAS_READ_ALL            1
+#define KAS_COMPRESS            (1 << 1)
+#define KAS_MMAP                (1 << 2)
+
+/* Flags for put */
+#define KAS_BORROWS_ARRAY       (1 << 8)
 
 
 /**
@@ -124,6 +129,12 @@ The file version minor number. Incremented when non-breaking backward-compatible
 changes are madeto the file format.
 */
 #define KAS_FILE_VERSION_MINOR  0
+/**
+The file version major number of compressed stores. Compressed stores cannot
+be read by kastore versions without compression support, so they are written
+with a higher major number that those versions reject as too new.
+*/
+#define KAS_FILE_VERSION_MAJOR_COMPRESSED  2
 /** @} */
 
 /**
@@ -161,6 +172,9 @@ typedef struct {
     void *array;
     size_t key_start;
     size_t array_start;
+    int borrowed;
+    int encoding;
+    size_t encoded_size;
 } kaitem_t;
 
 /**
@@ -176,6 +190,7 @@ typedef struct {
     const char *filename;
     size_t file_size;
     char *read_buffer;
+    int read_buffer_mapped;
 } kastore_t;
 
 /**
@@ -216,6 +231,21 @@ KAS_READ_ALL
     open time. This will give slightly better performance as the file can
     be read sequentially in a single pass.
 
+KAS_COMPRESS
+    In write mode, compress the arrays when the file is written: integer
+    arrays, and float64 arrays holding only integral values, are stored as
+    delta-encoded varints when that is smaller. Compressed files are read
+    back transparently (they are always read in full at open time), but
+    cannot be read by kastore versions without this extension. The flag is
+    ignored in read mode.
+
+KAS_MMAP
+    In read mode, map the file into memory rather than reading it into a
+    buffer; this implies ``KAS_READ_ALL``. Arrays then point directly into
+    the (private, copy-on-write) mapping, so no copy of the file is made
+    until the pages are actually touched. If the file cannot be mapped, or
+    on platforms without ``mmap``, the file is read as for ``KAS_READ_ALL``.
+
 @endrst
 
 @param self A pointer to a kastore object.
@@ -364,7 +394,9 @@ strings, it is usually more convenient to use the :ref:`typed variants
 @param array The array.
 @param array_len The number of elements in the array.
 @param type The type of the array.
-@param flags The insertion flags. Currently unused.
+@param flags The insertion flags. If ``KAS_BORROWS_ARRAY`` is specified, the
+    array is not copied; the caller keeps ownership of it, and it must remain
+    valid and unchanged until the store is closed.
 @return Return 0 on success or a negative value on failure.
 */
 int kastore_put(kastore_t *self, const char *key, size_t key_len,
@@ -107,14 +107,14 @@ out:
 
 
 static int
-write_table_cols(kastore_t *store, write_table_col_t *write_cols, size_t num_cols)
+write_table_cols(kastore_t *store, write_table_col_t *write_cols, size_t num_cols, int flags)
 {
     int ret = 0;
     size_t j;
 
     for (j = 0; j < num_cols; j++) {
         ret = kastore_puts(store, write_cols[j].name, write_cols[j].array,
-                write_cols[j].len, write_cols[j].type, 0);
+                write_cols[j].len, write_cols[j].type, flags);
         if (ret != 0) {
             ret = tsk_set_kas_error(ret);
             goto out;
@@ -635,7 +635,8 @@ tsk_individual_table_dump(tsk_individual_table_t *self, kastore_t *store)
         {"individuals/metadata_offset", (void *) self->metadata_offset, self->num_rows + 1,
             KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -1051,7 +1052,8 @@ tsk_node_table_dump(tsk_node_table_t *self, kastore_t *store)
         {"nodes/metadata_offset", (void *) self->metadata_offset, self->num_rows + 1,
             KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -1327,7 +1329,8 @@ tsk_edge_table_dump(tsk_edge_table_t *self, kastore_t *store)
         {"edges/parent", (void *) self->parent, self->num_rows, KAS_INT32},
         {"edges/child", (void *) self->child, self->num_rows, KAS_INT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -1789,7 +1792,8 @@ tsk_site_table_dump(tsk_site_table_t *self, kastore_t *store)
         {"sites/metadata_offset", (void *) self->metadata_offset,
             self->num_rows + 1, KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -2284,7 +2288,8 @@ tsk_mutation_table_dump(tsk_mutation_table_t *self, kastore_t *store)
         {"mutations/metadata_offset", (void *) self->metadata_offset,
             self->num_rows + 1, KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 
@@ -2591,7 +2596,8 @@ tsk_migration_table_dump(tsk_migration_table_t *self, kastore_t *store)
         {"migrations/dest", (void *) self->dest, self->num_rows,  KAS_INT32},
         {"migrations/time", (void *) self->time, self->num_rows,  KAS_FLOAT64},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -2933,7 +2939,8 @@ tsk_population_table_dump(tsk_population_table_t *self, kastore_t *store)
         {"populations/metadata_offset", (void *) self->metadata_offset,
             self->num_rows+ 1, KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -3377,7 +3384,8 @@ tsk_provenance_table_dump(tsk_provenance_table_t *self, kastore_t *store)
         {"provenances/record_offset", (void *) self->record_offset,
             self->num_rows + 1, KAS_UINT32},
     };
-    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    return write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
 }
 
 static int
@@ -5657,7 +5665,8 @@ tsk_table_collection_dump_indexes(tsk_table_collection_t *self, kastore_t *store
     if (tsk_table_collection_has_index(self, 0)) {
         write_cols[0].array = self->indexes.edge_insertion_order;
         write_cols[1].array = self->indexes.edge_removal_order;
-        ret = write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+        ret = write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols),
+            KAS_BORROWS_ARRAY);
     }
     return ret;
 }
@@ -5729,7 +5738,8 @@ tsk_table_collection_load(tsk_table_collection_t *self, const char *filename,
         ret = TSK_ERR_NO_MEMORY;
         goto out;
     }
-    ret = kastore_open(self->store, filename, "r", KAS_READ_ALL);
+    ret = kastore_open(self->store, filename, "r",
+            (options & TSK_LOAD_MMAP)? KAS_MMAP: KAS_READ_ALL);
     if (ret != 0) {
         ret = tsk_set_kas_error(ret);
         goto out;
@@ -5801,7 +5811,8 @@ tsk_table_collection_write_format_data(tsk_table_collection_t *self, kastore_t *
     /* This stupid dance is to workaround the fact that compilers won't allow
      * casts to discard the 'const' qualifier. */
     memcpy(format_name, TSK_FILE_FORMAT_NAME, sizeof(format_name));
-    ret = write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols));
+    /* These arrays are on the stack, so the store takes copies of them */
+    ret = write_table_cols(store, write_cols, sizeof(write_cols) / sizeof(*write_cols), 0);
 out:
     return ret;
 }
@@ -5818,6 +5829,30 @@ tsk_table_collection_dump(tsk_table_collection_t *self, const char *filename,
         ret = tsk_set_kas_error(ret);
         goto out;
     }
+    ret = tsk_table_collection_dump_store(self, &store, options);
+    if (ret != 0) {
+        goto out;
+    }
+    ret = kastore_close(&store);
+    if (ret != 0) {
+        ret = tsk_set_kas_error(ret);
+    }
+out:
+    /* It's safe to close a kastore twice. */
+    if (ret != 0) {
+        kastore_close(&store);
+    }
+    return ret;
+}
+
+/* The table columns are borrowed by the store rather than copied, so the tables must
+ * not be modified or freed until the store has been closed. */
+int TSK_WARN_UNUSED
+tsk_table_collection_dump_store(tsk_table_collection_t *self, kastore_t *store,
+        tsk_flags_t options)
+{
+    int ret = 0;
+
     /* By default we build indexes, if they are needed. Note that this will fail if
      * the tables aren't sorted. */
     if ((!(options & TSK_NO_BUILD_INDEXES))
@@ -5830,55 +5865,44 @@ tsk_table_collection_dump(tsk_table_collection_t *self, const char *filename,
 
     /* All of these functions will set the kas_error internally, so we don't have
      * to modify the return value. */
-    ret = tsk_table_collection_write_format_data(self, &store);
+    ret = tsk_table_collection_write_format_data(self, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_node_table_dump(&self->nodes, &store);
+    ret = tsk_node_table_dump(&self->nodes, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_edge_table_dump(&self->edges, &store);
+    ret = tsk_edge_table_dump(&self->edges, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_site_table_dump(&self->sites, &store);
+    ret = tsk_site_table_dump(&self->sites, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_migration_table_dump(&self->migrations, &store);
+    ret = tsk_migration_table_dump(&self->migrations, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_mutation_table_dump(&self->mutations, &store);
+    ret = tsk_mutation_table_dump(&self->mutations, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_individual_table_dump(&self->individuals, &store);
+    ret = tsk_individual_table_dump(&self->individuals, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_population_table_dump(&self->populations, &store);
+    ret = tsk_population_table_dump(&self->populations, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_provenance_table_dump(&self->provenances, &store);
+    ret = tsk_provenance_table_dump(&self->provenances, store);
     if (ret != 0) {
         goto out;
     }
-    ret = tsk_table_collection_dump_indexes(self, &store);
-    if (ret != 0) {
-        goto out;
-    }
-    ret = kastore_close(&store);
-    if (ret != 0) {
-        ret = tsk_set_kas_error(ret);
-    }
+    ret = tsk_table_collection_dump_indexes(self, store);
 out:
-    /* It's safe to close a kastore twice. */
-    if (ret != 0) {
-        kastore_close(&store);
-    }
     return ret;
 }
 
@@ -604,6 +604,7 @@ typedef struct {
 
 /* Flags for load tables */
 #define TSK_BUILD_INDEXES               (1 << 0)
+#define TSK_LOAD_MMAP                   (1 << 1)
  
 
 /****************************************************************************/
@@ -1953,6 +1954,13 @@ flags:
 TSK_NO_INIT
     Do not initialise this :c:type:`tsk_table_collection_t` before loading.
 
+TSK_LOAD_MMAP
+    Map the file into memory instead of reading it into a buffer (see
+    ``KAS_MMAP``). The table columns point into the mapping, so pages are
+    only read from disk as they are used; this is useful when the tables
+    are immediately copied elsewhere, since it avoids holding a second
+    in-memory copy of the file.
+
 **Examples**
 
 .. code-block:: c
@@ -2027,6 +2035,25 @@ TSK_NO_BUILD_INDEXES
 int tsk_table_collection_dump(tsk_table_collection_t *self, const char *filename, 
     tsk_flags_t options);
 
+/**
+@brief Write a table collection into an open kastore.
+
+@rst
+This writes the same keys as :c:func:`tsk_table_collection_dump`, into a store
+opened for writing by the caller, so that further keys can be added before the
+store is closed. The table columns are not copied: the store refers to them
+directly, so the tables must not be modified or freed until the store has been
+closed. The options are those of :c:func:`tsk_table_collection_dump`.
+@endrst
+
+@param self A pointer to an initialised tsk_table_collection_t object.
+@param store A pointer to a kastore opened in write mode.
+@param options Write options.
+@return Return 0 on success or a negative value on failure.
+*/
+int tsk_table_collection_dump_store(tsk_table_collection_t *self, kastore_t *store,
+    tsk_flags_t options);
+
 /**
 @brief Record the number of rows in each table in the specified tsk_bookmark_t object.
 